@@ -0,0 +1,202 @@
+// ============================================================================
+// GradeAOVArena — recycling frame buffer arena for the native grade
+// Keeps released frame buffers for the next frame instead of returning them
+// to the system, so a frame sequence maps (and page faults) its src, aov,
+// mask and dst buffers once, not once per frame.
+// ============================================================================
+
+// MAJOR NOTES :
+// Blocks are 64 byte aligned (one cache line, what streaming stores and
+// aligned SIMD loads want). Blocks of 2 MB and more are 2 MB aligned and
+// sized, and asked to be transparent huge pages (madvise, Linux), which
+// cuts TLB misses on 8K frames.
+// A released block goes back to the free list of its (rounded) size and
+// is handed out again for the same size. A recycled block keeps its pages,
+// and their NUMA placement, so reuse it with the same tiling.
+// Buffers must be released (destroyed) before their arena.
+// Not thread safe : acquire and release from one thread (the frame loop).
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <map>
+#include <new>
+#include <utility>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <sys/resource.h>
+#endif
+
+namespace GradeAOV
+{
+
+// Page faults of this process so far (minor + major), 0 if unknown
+inline uint64_t processPageFaults()
+{
+#if defined(__linux__)
+  rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) == 0)
+    return uint64_t(usage.ru_minflt) + uint64_t(usage.ru_majflt);
+#endif
+  return 0;
+}
+
+class FrameArena
+{
+public:
+  static constexpr size_t kLineSize = 64;
+  static constexpr size_t kHugePage = size_t(2) << 20;
+
+  // recycle false : release frees at once (the no-arena baseline)
+  explicit FrameArena(bool recycle = true, bool hugePages = true)
+    : _recycle(recycle), _hugePages(hugePages)
+  {
+  }
+
+  ~FrameArena() { trim(); }
+
+  FrameArena(const FrameArena&) = delete;
+  FrameArena& operator=(const FrameArena&) = delete;
+
+  // -----------------------------
+  // BUFFER
+  // Owns a block until destroyed, then gives it back to the arena.
+  // -----------------------------
+  class Buffer
+  {
+  public:
+    Buffer() = default;
+    Buffer(Buffer&& other) noexcept { *this = std::move(other); }
+
+    Buffer& operator=(Buffer&& other) noexcept
+    {
+      if (this != &other)
+      {
+        reset();
+        std::swap(_arena, other._arena);
+        std::swap(_data, other._data);
+        std::swap(_bytes, other._bytes);
+      }
+      return *this;
+    }
+
+    ~Buffer() { reset(); }
+
+    float* data() const { return static_cast<float*>(_data); }
+    size_t bytes() const { return _bytes; }
+    explicit operator bool() const { return _data != nullptr; }
+
+    void reset()
+    {
+      if (_arena && _data)
+        _arena->release(_data, _bytes);
+      _arena = nullptr;
+      _data  = nullptr;
+      _bytes = 0;
+    }
+
+  private:
+    friend class FrameArena;
+
+    FrameArena* _arena = nullptr;
+    void* _data = nullptr;
+    size_t _bytes = 0;
+  };
+
+  // -----------------------------
+  // ACQUIRE
+  // At least bytes bytes, contents undefined. Throws std::bad_alloc.
+  // -----------------------------
+  Buffer acquire(size_t bytes)
+  {
+    const size_t size = roundedSize(bytes);
+
+    Buffer b;
+    b._arena = this;
+    b._bytes = size;
+
+    auto it = _free.find(size);
+    if (it != _free.end())
+    {
+      b._data = it->second;
+      _free.erase(it);
+      _cachedBytes -= size;
+      _reuses++;
+      return b;
+    }
+
+    b._data = std::aligned_alloc(size >= kHugePage ? kHugePage : kLineSize, size);
+    if (!b._data)
+      throw std::bad_alloc();
+
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+    // Advisory : THP may be off (then this fails harmlessly)
+    if (_hugePages && size >= kHugePage)
+      madvise(b._data, size, MADV_HUGEPAGE);
+#endif
+
+    _allocations++;
+    _allocatedBytes += size;
+    return b;
+  }
+
+  // Free every cached block
+  void trim()
+  {
+    for (auto& block : _free)
+    {
+      std::free(block.second);
+      _allocatedBytes -= block.first;
+    }
+    _free.clear();
+    _cachedBytes = 0;
+  }
+
+  // -----------------------------
+  // COUNTERS
+  // Cumulative, take differences around a frame.
+  // -----------------------------
+  uint64_t allocations() const { return _allocations; }
+  uint64_t reuses() const { return _reuses; }
+  size_t allocatedBytes() const { return _allocatedBytes; }
+  size_t cachedBytes() const { return _cachedBytes; }
+
+private:
+  // 64 byte multiple, 2 MB multiple for huge blocks
+  static size_t roundedSize(size_t bytes)
+  {
+    const size_t align = bytes >= kHugePage ? kHugePage : kLineSize;
+    return (std::max<size_t>(bytes, 1) + align - 1) & ~(align - 1);
+  }
+
+  void release(void* data, size_t size)
+  {
+    if (_recycle)
+    {
+      _free.emplace(size, data);
+      _cachedBytes += size;
+    }
+    else
+    {
+      std::free(data);
+      _allocatedBytes -= size;
+    }
+  }
+
+  bool _recycle;
+  bool _hugePages;
+
+  // Cached blocks by size
+  std::multimap<size_t, void*> _free;
+
+  uint64_t _allocations = 0;
+  uint64_t _reuses = 0;
+  size_t _allocatedBytes = 0;
+  size_t _cachedBytes = 0;
+};
+
+} // namespace GradeAOV
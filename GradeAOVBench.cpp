@@ -0,0 +1,1065 @@
+// ============================================================================
+// GradeAOVBench — memory bandwidth microbenchmark of the native grade
+// Runs the RGBA row kernel with and without streaming stores / prefetch and
+// compares the achieved bandwidth with STREAM-like kernels on the same
+// buffers, threads and tiling.
+// ============================================================================
+
+// USAGE :
+//   GradeAOVBench [-w width] [-h height] [-t threads] [-r repeats] [--numa]
+//                 [-f frames] [--no-arena] [--no-huge]
+//                 [--tune] [--profile path] [--trace path] [--perf]
+//                 [--json results.json] [--seed n] [--roofline]
+//                 [--heatmap cost.png] [--denormals]
+//   GradeAOVBench --compare baseline.json results.json [--threshold percent]
+//
+//   -w / -h    : image size (default 7680 x 4320, 8K UHD)
+//   -t threads : worker threads, 0 = one per hardware thread (default)
+//   -r repeats : timed passes per kernel, the best one is kept (default 5)
+//   --numa     : pin threads per memory node, place each band's pages on
+//                the node grading it, and report the bandwidth per node
+//   -f frames  : frame sequence run at the end, buffers acquired and
+//                released every frame (default 4, 0 = skip)
+//   --no-arena : free buffers at once instead of recycling them
+//   --no-huge  : do not ask for transparent huge pages
+//   --tune     : only search the fastest threads / tile shape / kernel
+//                variant for this machine and save it as its profile
+//                (see GradeAOVProfile.h), the engine loads it at startup
+//   --profile  : profile file to write (default : this host's profile)
+//   --trace    : Chrome trace JSON of the frame sequence (tiles, stalls)
+//   --heatmap  : grade the frame sequence in 64 x 64 tiles and write the
+//                time per pixel of each tile of the last frame as a PNG
+//                (GradeAOVHeatmap.h)
+//   --perf     : hardware counters per kernel (IPC, instructions, LLC and
+//                branch misses per pixel, GradeAOVPerf.h), plus a
+//                forward_gamma() branch test
+//   --json     : write every repetition of every kernel with the machine
+//                and build metadata (GradeAOVResults.h), --compare needs
+//                -r 2 or more to judge a kernel
+//   --compare  : compare two results files, exit 1 when a kernel's
+//                throughput dropped significantly by more than --threshold
+//                (default 5%)
+//   --seed     : seed of the synthetic frames (default 1, GradeAOVSynth.h)
+//   --denormals: grade frames with denormal AOV residue with and without
+//                flush-to-zero, and report the speed-up and the graded
+//                AOV difference for gamma 0.9, gamma 2 and unpremult
+//                (GradeAOVDenormals.h)
+//   --roofline : only measure peak FLOP/s and bandwidth, and place every
+//                grade variant (gamma, unpremult, mask on / off) on the
+//                roofline (GradeAOVRoofline.h)
+//
+// MAJOR NOTES :
+// Every kernel reads src, aov and mask and writes dst, all interleaved RGBA
+// float (16 bytes per pixel each). Bandwidth is counted like STREAM does :
+// the bytes the kernel asks for, not the read-for-ownership of dst that
+// plain stores also cause. That hidden read is what streaming stores save.
+// Inputs are synthetic render-like frames (GradeAOVSynth.h) : mostly empty
+// mask, sparse HDR emission, denoiser negatives, so the grade takes the
+// branches and early-outs it takes in production.
+// "triad3" (dst = src + aov * mask) has the grade's exact traffic with
+// next to no maths, it is the bandwidth the grade can hope for.
+// The simd, ispc and halide rows are checked against the native grade,
+// the exit status is 1 when one of them is off by more than 1e-5.
+//
+// BUILD :
+//   g++ -O3 -march=native -std=c++17 -pthread GradeAOVBench.cpp -o GradeAOVBench
+//   add -DGRADEAOV_STATS for hot path counters per frame (GradeAOVStats.h)
+//   add -DGRADEAOV_ALLOC_CHECK to abort on any allocation while grading
+//   rows (GradeAOVAlloc.h)
+//   add -DGRADEAOV_ISPC and the ispc objects for an "ispc" grade row
+//   (GradeAOVIspc.h)
+//   add -DGRADEAOV_HALIDE and the Halide libraries for "halide" and
+//   "halide auto" grade rows (GradeAOVHalide.h)
+
+#include "GradeAOVArena.h"
+#include "GradeAOVExecutor.h"
+#include "GradeAOVHalide.h"
+#include "GradeAOVHeatmap.h"
+#include "GradeAOVIspc.h"
+#include "GradeAOVPerf.h"
+#include "GradeAOVResults.h"
+#include "GradeAOVProfile.h"
+#include "GradeAOVRoofline.h"
+#include "GradeAOVSimd.h"
+#include "GradeAOVSynth.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <memory>
+#include <thread>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace GradeAOV;
+
+namespace
+{
+
+// -----------------------------
+// BENCH STATE
+// -----------------------------
+struct Bench
+{
+  int width = 7680, height = 4320;
+  int repeats = 5;
+  int bandRows = 64;
+
+  FrameArena::Buffer src, aov, mask, dst;
+  ImageView srcV, aovV, maskV, dstV;
+
+  // Synthetic input frames
+  SynthParams synth;
+
+  // Every reported kernel, for --json
+  RunResults results;
+
+  // Hardware counters, one group per executor thread, opened by that
+  // thread on its first tile
+  bool perf = false;
+  std::vector<std::unique_ptr<PerfCounters>> counters;
+  std::string perfError;
+
+  PerfSample perfTotal() const
+  {
+    PerfSample total;
+    for (const auto& c : counters)
+      if (c)
+        total += c->read();
+    return total;
+  }
+
+  // Bytes asked for by one pass (3 reads, 1 write)
+  double bytes() const { return 4.0 * 16.0 * width * height; }
+
+  // Take the four frame buffers from the arena
+  void acquire(FrameArena& arena)
+  {
+    const size_t frameBytes = size_t(16) * width * height;
+    src  = arena.acquire(frameBytes);
+    aov  = arena.acquire(frameBytes);
+    mask = arena.acquire(frameBytes);
+    dst  = arena.acquire(frameBytes);
+    srcV  = ImageView::interleaved(src.data(),  width, height);
+    aovV  = ImageView::interleaved(aov.data(),  width, height);
+    maskV = ImageView::interleaved(mask.data(), width, height);
+    dstV  = ImageView::interleaved(dst.data(),  width, height);
+  }
+
+  void release()
+  {
+    src.reset();
+    aov.reset();
+    mask.reset();
+    dst.reset();
+  }
+};
+
+// Best pass of a kernel
+struct Timing
+{
+  double seconds = 1e30;
+
+  // Bytes moved by the threads of each node, tiles run off their node
+  std::vector<double> nodeBytes;
+  unsigned long long stolen = 0;
+
+  // Hardware counters of the pass (all threads), zeros without --perf
+  PerfSample perf;
+
+  // Every timed pass
+  std::vector<double> samples;
+};
+
+// Run fn(y0, y1) on full-width bands, keep the best of bench.repeats passes
+Timing timeBest(Executor& executor, Bench& bench,
+                const std::function<void(int, int)>& fn)
+{
+  std::vector<double> threadBytes(executor.threads());
+  const double rowBytes = 4.0 * 16.0 * bench.width;
+
+  if (bench.perf)
+    bench.counters.resize(executor.threads());
+
+  auto pass = [&]
+  {
+    std::fill(threadBytes.begin(), threadBytes.end(), 0.0);
+    executor.forEachTile(bench.width, bench.height, 0, bench.bandRows,
+      [&](const Tile& t, int thread)
+      {
+        // Counters follow threads, open them on the thread itself
+        if (bench.perf && !bench.counters[thread])
+        {
+          bench.counters[thread].reset(new PerfCounters());
+          if (!bench.counters[thread]->open() && thread == 0)
+            bench.perfError = bench.counters[thread]->error();
+        }
+
+        fn(t.y0, t.y1);
+        threadBytes[thread] += rowBytes * (t.y1 - t.y0);
+      });
+  };
+
+  // Warm up (page tables, pool threads)
+  pass();
+
+  Timing best;
+  for (int r = 0; r < bench.repeats; r++)
+  {
+    const unsigned long long stolen = executor.stolenTiles();
+    const PerfSample counted = bench.perfTotal();
+    auto start = std::chrono::steady_clock::now();
+    pass();
+    const double seconds = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - start).count();
+    best.samples.push_back(seconds);
+
+    if (seconds < best.seconds)
+    {
+      best.seconds = seconds;
+      best.perf    = bench.perfTotal() - counted;
+      best.stolen  = executor.stolenTiles() - stolen;
+      best.nodeBytes.assign(executor.nodes(), 0.0);
+      for (int i = 0; i < executor.threads(); i++)
+        best.nodeBytes[executor.nodeOf(i)] += threadBytes[i];
+    }
+  }
+  return best;
+}
+
+// -----------------------------
+// STREAM-LIKE BASELINES
+// -----------------------------
+
+// dst = src, STREAM copy (1 read, 1 write)
+void copyRows(const Bench& b, int y0, int y1)
+{
+  const size_t n = size_t(4) * b.width;
+  for (int y = y0; y < y1; y++)
+    std::memcpy(b.dstV.row(0, y), b.srcV.row(0, y), n * sizeof(float));
+}
+
+// dst = src + aov * mask, the grade's traffic
+void triad3Rows(const Bench& b, int y0, int y1, bool stream)
+{
+  const int n = 4 * b.width;
+  for (int y = y0; y < y1; y++)
+  {
+    const float* s = b.srcV.row(0, y);
+    const float* a = b.aovV.row(0, y);
+    const float* m = b.maskV.row(0, y);
+    float* d = b.dstV.row(0, y);
+
+#if defined(GRADEAOV_SSE)
+    if (stream)
+    {
+      for (int i = 0; i < n; i += 4)
+        _mm_stream_ps(d + i, _mm_add_ps(_mm_load_ps(s + i),
+                                        _mm_mul_ps(_mm_load_ps(a + i), _mm_load_ps(m + i))));
+      continue;
+    }
+#else
+    (void)stream;
+#endif
+    for (int i = 0; i < n; i++)
+      d[i] = s[i] + a[i] * m[i];
+  }
+
+#if defined(GRADEAOV_SSE)
+  if (stream)
+    _mm_sfence();
+#endif
+}
+
+// -----------------------------
+// FILL
+// Touched by the pool so pages land near the threads using them.
+// -----------------------------
+void fill(Executor& executor, Bench& b)
+{
+  executor.forEachTile(b.width, b.height, 0, b.bandRows,
+    [&](const Tile& t, int)
+    {
+      synthesizeRows(b.synth, b.srcV, b.aovV, b.maskV, t.y0, t.y1);
+      for (int y = t.y0; y < t.y1; y++)
+        std::fill(b.dstV.row(0, y), b.dstV.row(0, y) + 4 * b.width, 0.0f);
+    });
+}
+
+// name is the kernel's key in results files, params what this build or
+// run picked for it (shown after the name)
+void report(const char* name, Bench& b, const Timing& t, double baseline,
+            const KernelParams& params = KernelParams())
+{
+  b.results.kernels.push_back({name, b.bytes(), t.samples, params});
+
+  std::string label = name;
+  for (const auto& kv : params)
+    label += " " + kv.second;
+
+  const double gbs = b.bytes() / t.seconds * 1e-9;
+  std::printf("  %-26s %9.2f ms %8.2f GB/s", label.c_str(), t.seconds * 1e3, gbs);
+  if (baseline > 0.0)
+    std::printf(" %6.1f%%", 100.0 * gbs / baseline);
+  std::printf("\n");
+
+  // Counters per pixel of the same pass
+  if (t.perf.cycles)
+  {
+    const double pixels = double(b.width) * b.height;
+    std::printf("    IPC %.2f, per pixel : %.1f instructions, %.3f LLC misses,"
+                " %.3f branch misses\n", t.perf.ipc(), t.perf.instructions / pixels,
+                t.perf.llcMisses / pixels, t.perf.branchMisses / pixels);
+  }
+
+  // Per node share of the same pass
+  if (t.nodeBytes.size() > 1)
+  {
+    for (size_t n = 0; n < t.nodeBytes.size(); n++)
+      std::printf("    node %-21zu %21.2f GB/s\n", n, t.nodeBytes[n] / t.seconds * 1e-9);
+    std::printf("    %llu band(s) graded off their node\n", t.stolen);
+  }
+}
+
+// -----------------------------
+// CHECK AGAINST THE NATIVE GRADE
+// Regrades every band with GradeAOVOpt's own rows into a per thread row
+// and compares with dst as the last kernel left it. Values differ unless
+// bit identical (NaN equals NaN), differences are relative to
+// max(1, |native|). Returns the number of values differing by more than
+// kCheckTolerance : FMA contraction, and the pow() of ISPC or Halide
+// (not libm's), stay well under it, a wrong branch or lane does not.
+// -----------------------------
+const double kCheckTolerance = 1e-5;
+
+unsigned long long checkDiffers(Executor& executor, const Bench& b, const GradeAOVOpt& op)
+{
+  std::vector<std::vector<float>> rows(executor.threads(),
+                                       std::vector<float>(size_t(4) * b.width));
+  std::vector<unsigned long long> differ(executor.threads(), 0);
+  std::vector<unsigned long long> beyond(executor.threads(), 0);
+  std::vector<double> largest(executor.threads(), 0.0);
+
+  executor.forEachTile(b.width, b.height, 0, b.bandRows,
+    [&](const Tile& t, int thread)
+    {
+      float* ref = rows[thread].data();
+      const ImageView refV = ImageView::interleaved(ref, b.width, 1);
+      for (int y = t.y0; y < t.y1; y++)
+      {
+        const ImageView maskRow = b.maskV.crop(0, y, b.width, 1);
+        processRows(op, b.srcV.crop(0, y, b.width, 1), b.aovV.crop(0, y, b.width, 1),
+                    &maskRow, refV, 0, 1);
+        const float* out = b.dstV.row(0, y);
+        for (int i = 0; i < 4 * b.width; i++)
+          if (out[i] != ref[i] && !(std::isnan(out[i]) && std::isnan(ref[i])))
+          {
+            const double d = std::fabs(double(out[i]) - ref[i]) /
+                             std::max(1.0, std::fabs(double(ref[i])));
+            differ[thread]++;
+            beyond[thread] += !(d <= kCheckTolerance);
+            largest[thread] = std::max(largest[thread], d);
+          }
+      }
+    });
+
+  unsigned long long total = 0, failed = 0;
+  double worst = 0.0;
+  for (int i = 0; i < executor.threads(); i++)
+  {
+    total += differ[i];
+    failed += beyond[i];
+    worst = std::max(worst, largest[i]);
+  }
+  if (total)
+    std::printf("    %llu value(s) differ from the native grade, largest relative"
+                " difference %.3g, %llu over %g\n", total, worst, failed, kCheckTolerance);
+  else
+    std::printf("    same output as the native grade\n");
+  return failed;
+}
+
+// -----------------------------
+// AUTOTUNE
+// Coordinate descent rather than the full grid (hundreds of 8K passes) :
+// thread count, then tile shape, then kernel variant, then the thread
+// count again with the winners. Every candidate grades the whole frame
+// through processImage(), best of bench.repeats.
+// -----------------------------
+TuneProfile tune(const Bench& bench, const GradeAOVOpt& op, bool numa)
+{
+  std::map<int, std::unique_ptr<Executor>> executors;
+
+  auto measure = [&](const TuneProfile& p)
+  {
+    std::unique_ptr<Executor>& executor = executors[p.threads];
+    if (!executor)
+      executor.reset(new Executor(p.threads, numa));
+
+    double best = 1e30;
+    for (int r = 0; r <= bench.repeats; r++)
+    {
+      auto start = std::chrono::steady_clock::now();
+      processImage(*executor, op, bench.srcV, bench.aovV, &bench.maskV, bench.dstV,
+                   p.tileW, p.tileH, p.hints);
+      const double seconds = std::chrono::duration<double>(
+                               std::chrono::steady_clock::now() - start).count();
+      // First pass is the warm up
+      if (r)
+        best = std::min(best, seconds);
+    }
+
+    std::printf("  %3d thread(s)  tile %4d x %-4d  stream %-3s  prefetch %-4d %9.2f ms\n",
+                p.threads, p.tileW, p.tileH, p.hints.stream ? "on" : "off",
+                p.hints.prefetchSrc, best * 1e3);
+    return best;
+  };
+
+  TuneProfile best;
+  best.host   = hostName();
+  best.numa   = numa;
+  best.frameW = bench.width;
+  best.frameH = bench.height;
+  best.threads = int(std::max(1u, std::thread::hardware_concurrency()));
+  best.ms = measure(best) * 1e3;
+
+  // Keep a candidate if it beats the best so far
+  auto consider = [&](const TuneProfile& p)
+  {
+    const double ms = measure(p) * 1e3;
+    if (ms < best.ms)
+    {
+      best = p;
+      best.ms = ms;
+    }
+  };
+
+  auto sweepThreads = [&]
+  {
+    const int hardware = int(std::max(1u, std::thread::hardware_concurrency()));
+    const TuneProfile base = best;
+    for (int t = 1; t <= hardware; t = (t * 2 > hardware && t < hardware) ? hardware : t * 2)
+      if (t != base.threads)
+      {
+        TuneProfile p = base;
+        p.threads = t;
+        consider(p);
+      }
+  };
+
+  std::printf("threads\n");
+  sweepThreads();
+
+  std::printf("tile shape\n");
+  {
+    const TuneProfile base = best;
+    const int shapes[][2] = {{0, 16}, {0, 64}, {0, 256}, {128, 128}, {256, 64}, {512, 128}};
+    for (const auto& shape : shapes)
+      if (shape[0] != base.tileW || shape[1] != base.tileH)
+      {
+        TuneProfile p = base;
+        p.tileW = shape[0];
+        p.tileH = shape[1];
+        consider(p);
+      }
+  }
+
+  std::printf("kernel variant\n");
+  {
+    const TuneProfile base = best;
+    for (bool stream : {false, true})
+      for (int prefetch : {0, 32, 128})
+        if (stream != base.hints.stream || prefetch != base.hints.prefetchSrc)
+        {
+          TuneProfile p = base;
+          p.hints.stream = stream;
+          p.hints.prefetchSrc = p.hints.prefetchAov = p.hints.prefetchMask = prefetch;
+          consider(p);
+        }
+  }
+
+  std::printf("threads again\n");
+  sweepThreads();
+
+  return best;
+}
+
+} // namespace
+
+// -----------------------------
+// MAIN
+// -----------------------------
+// Reported kernels and the setup they ran on, for --json
+void saveResults(const Executor& executor, Bench& bench, const std::string& path)
+{
+  bench.results.machine = machineMetadata();
+  bench.results.machine.emplace_back("threads", std::to_string(executor.threads()));
+  bench.results.machine.emplace_back("numa_nodes", std::to_string(executor.nodes()));
+  bench.results.machine.emplace_back("frame", std::to_string(bench.width) + "x" +
+                                              std::to_string(bench.height));
+  bench.results.machine.emplace_back("repeats", std::to_string(bench.repeats));
+  bench.results.machine.emplace_back("seed", std::to_string(bench.synth.seed));
+  writeResults(bench.results, path);
+  std::printf("results: %zu kernel(s) written to %s\n", bench.results.kernels.size(),
+              path.c_str());
+}
+
+// -----------------------------
+// ROOFLINE
+// Every combination of gamma, unpremult and mask on the same frames.
+// -----------------------------
+void roofline(Executor& executor, Bench& bench, const GradeAOVOpt& op)
+{
+  const double peak = measurePeakFlops(executor.threads());
+
+  // The roof is the best STREAM-like bandwidth of the grade's traffic
+  const double triad = timeBest(executor, bench,
+    [&](int y0, int y1) { triad3Rows(bench, y0, y1, false); }).seconds;
+  const double triadStream = timeBest(executor, bench,
+    [&](int y0, int y1) { triad3Rows(bench, y0, y1, true); }).seconds;
+  const double bandwidth = bench.bytes() / std::min(triad, triadStream);
+  const double ridge = peak / bandwidth;
+
+  std::printf("peak %.1f GFLOP/s, bandwidth %.2f GB/s, ridge at %.2f FLOP/byte\n",
+              peak * 1e-9, bandwidth * 1e-9, ridge);
+  std::printf("  %-28s %8s %6s %9s %10s %10s %8s %6s  %s\n", "variant", "FLOP/px", "B/px",
+              "FLOP/B", "roof GF/s", "got GF/s", "got GB/s", "roof", "bound");
+
+  const double pixels = double(bench.width) * bench.height;
+  int memoryBound = 0, variants = 0;
+  double bestShare = 0.0;
+
+  for (int v = 0; v < 8; v++)
+  {
+    GradeAOVOpt g = op;
+    const bool gamma = v & 1, unpremult = v & 2, mask = v & 4;
+    const float one = 1.0f;
+    if (!gamma)
+      g.setParam("gamma", &one, 1);
+    g.unpremult = unpremult;
+    g.useMask   = mask;
+    g.init();
+
+    const std::string name = std::string(gamma ? "gamma" : "no gamma") +
+                             (unpremult ? " + unpremult" : "") + (mask ? " + mask" : "");
+
+    const Timing t = timeBest(executor, bench, [&](int y0, int y1)
+      {
+        processRows(g, bench.srcV, bench.aovV, mask ? &bench.maskV : nullptr, bench.dstV, y0, y1);
+      });
+
+    const double flops     = countFlops(g, bench.srcV, bench.aovV, &bench.maskV);
+    const double bytes     = pixelBytes(g, true);
+    const double intensity = flops / bytes;
+    const double roof      = rooflineBound(peak, bandwidth, intensity);
+    const double achieved  = flops * pixels / t.seconds;
+    const bool boundByMemory = intensity < ridge;
+
+    std::printf("  %-28s %8.1f %6.0f %9.3f %10.1f %10.1f %8.2f %5.1f%%  %s\n", name.c_str(),
+                flops, bytes, intensity, roof * 1e-9, achieved * 1e-9,
+                bytes * pixels / t.seconds * 1e-9, 100.0 * achieved / roof,
+                boundByMemory ? "memory" : "compute");
+
+    bench.results.kernels.push_back({"roofline " + name, bytes * pixels, t.samples, {}});
+    memoryBound += boundByMemory;
+    variants++;
+    bestShare = std::max(bestShare, achieved / roof);
+  }
+
+  if (memoryBound == variants)
+    std::printf("every variant is memory bound here : cut bytes (half floats, fewer"
+                " channels), cheaper maths will not show\n");
+  else if (memoryBound == 0)
+    std::printf("every variant is compute bound here : cheaper maths (pow) pays first\n");
+  else
+    std::printf("%d of %d variants memory bound : the compute bound ones gain from cheaper"
+                " maths (pow), the others from fewer bytes\n", memoryBound, variants);
+
+  // Far under every roof, the kernel's own code (scalar, branchy) is the limit
+  if (bestShare < 0.5)
+    std::printf("no variant reaches half its roof (best %.0f%%) : the row kernel itself is the"
+                " limit, vectorizing it pays before either\n", 100.0 * bestShare);
+}
+
+int main(int argc, char* argv[])
+{
+  Bench bench;
+  int threads = 0;
+  bool numa = false;
+  int frames = 4;
+  bool recycle = true;
+  bool hugePages = true;
+  bool autotune = false;
+  bool rooflineOnly = false;
+  bool denormals = false;
+  std::string profilePath;
+  std::string tracePath;
+  std::string jsonPath;
+  std::string heatmapPath;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (!std::strcmp(argv[i], "-w") && i + 1 < argc)
+      bench.width = std::atoi(argv[++i]);
+    else if (!std::strcmp(argv[i], "-h") && i + 1 < argc)
+      bench.height = std::atoi(argv[++i]);
+    else if (!std::strcmp(argv[i], "-t") && i + 1 < argc)
+      threads = std::atoi(argv[++i]);
+    else if (!std::strcmp(argv[i], "-r") && i + 1 < argc)
+      bench.repeats = std::max(1, std::atoi(argv[++i]));
+    else if (!std::strcmp(argv[i], "--numa"))
+      numa = true;
+    else if (!std::strcmp(argv[i], "-f") && i + 1 < argc)
+      frames = std::max(0, std::atoi(argv[++i]));
+    else if (!std::strcmp(argv[i], "--no-arena"))
+      recycle = false;
+    else if (!std::strcmp(argv[i], "--no-huge"))
+      hugePages = false;
+    else if (!std::strcmp(argv[i], "--tune"))
+      autotune = true;
+    else if (!std::strcmp(argv[i], "--profile") && i + 1 < argc)
+      profilePath = argv[++i];
+    else if (!std::strcmp(argv[i], "--trace") && i + 1 < argc)
+      tracePath = argv[++i];
+    else if (!std::strcmp(argv[i], "--perf"))
+      bench.perf = true;
+    else if (!std::strcmp(argv[i], "--heatmap") && i + 1 < argc)
+      heatmapPath = argv[++i];
+    else if (!std::strcmp(argv[i], "--denormals"))
+      denormals = true;
+    else if (!std::strcmp(argv[i], "--roofline"))
+      rooflineOnly = true;
+    else if (!std::strcmp(argv[i], "--seed") && i + 1 < argc)
+      bench.synth.seed = uint32_t(std::strtoul(argv[++i], nullptr, 10));
+    else if (!std::strcmp(argv[i], "--json") && i + 1 < argc)
+      jsonPath = argv[++i];
+    else if (!std::strcmp(argv[i], "--compare") && i + 2 < argc)
+    {
+      // Comparison only, no benchmark
+      double threshold = 5.0;
+      if (i + 4 < argc && !std::strcmp(argv[i + 3], "--threshold"))
+        threshold = std::atof(argv[i + 4]);
+      try
+      {
+        const bool pass = compareResults(readResults(argv[i + 1]), readResults(argv[i + 2]),
+                                         threshold, stdout);
+        std::printf("%s (threshold %.1f%%)\n", pass ? "PASS" : "FAIL", threshold);
+        return pass ? 0 : 1;
+      }
+      catch (const std::exception& e)
+      {
+        std::fprintf(stderr, "GradeAOVBench: %s\n", e.what());
+        return 2;
+      }
+    }
+    else
+    {
+      std::fprintf(stderr, "usage: %s [-w width] [-h height] [-t threads] [-r repeats]"
+                           " [--numa]\n          [-f frames] [--no-arena] [--no-huge] [--tune]"
+                           " [--profile path]\n          [--trace path] [--perf] [--json results.json]"
+                           " [--seed n] [--roofline]\n          [--heatmap cost.png] [--denormals]\n"
+                           "       %s --compare baseline.json results.json [--threshold percent]\n",
+                   argv[0], argv[0]);
+      return 2;
+    }
+  }
+
+  try
+  {
+    if (bench.width <= 0 || bench.height <= 0)
+      throw std::runtime_error("bad image size");
+    if (!heatmapPath.empty() && frames == 0)
+      throw std::runtime_error("--heatmap needs at least one frame (-f)");
+
+    FrameArena arena(recycle, hugePages);
+    bench.acquire(arena);
+
+    // Buffers are untouched so far, fill() places their pages
+    Executor executor(threads, numa);
+    fill(executor, bench);
+
+    // A grade with every stage on, the mask is read
+    GradeAOVOpt op;
+    const float gain[4] = {1.2f, 1.1f, 1.0f, 1.0f};
+    const float gamma   = 0.9f;
+    op.setParam("gain", gain, 4);
+    op.setParam("gamma", &gamma, 1);
+    op.unpremult = true;
+    op.useMask   = true;
+    op.init();
+
+    if (autotune)
+    {
+      if (profilePath.empty())
+        profilePath = hostProfilePath();
+
+      std::printf("GradeAOVBench: tuning on %d x %d RGBA float, best of %d\n",
+                  bench.width, bench.height, bench.repeats);
+      const TuneProfile best = tune(bench, op, numa);
+      saveProfile(best, profilePath);
+
+      std::printf("best: %d thread(s), tile %d x %d, stream %s, prefetch %d, %.2f ms\n"
+                  "saved to %s\n", best.threads, best.tileW, best.tileH,
+                  best.hints.stream ? "on" : "off", best.hints.prefetchSrc, best.ms,
+                  profilePath.c_str());
+      return 0;
+    }
+
+    if (rooflineOnly)
+    {
+      std::printf("GradeAOVBench: roofline on %d x %d RGBA float, %d thread(s), best of %d\n",
+                  bench.width, bench.height, executor.threads(), bench.repeats);
+      roofline(executor, bench, op);
+      if (!jsonPath.empty())
+        saveResults(executor, bench, jsonPath);
+      return 0;
+    }
+
+    std::printf("GradeAOVBench: %d x %d RGBA float, %d thread(s) on %d node(s),"
+                " %.1f MB per pass, best of %d\n", bench.width, bench.height,
+                executor.threads(), executor.nodes(), bench.bytes() / 1048576.0,
+                bench.repeats);
+
+    // -----------------------------
+    // BASELINES
+    // -----------------------------
+    std::printf("baseline\n");
+
+    const Timing copy = timeBest(executor, bench,
+      [&](int y0, int y1) { copyRows(bench, y0, y1); });
+    // Copy moves half the bytes of a 4 stream pass
+    std::printf("  %-26s %9.2f ms %8.2f GB/s\n", "copy", copy.seconds * 1e3,
+                bench.bytes() * 0.5 / copy.seconds * 1e-9);
+    bench.results.kernels.push_back({"copy", bench.bytes() * 0.5, copy.samples, {}});
+
+    const Timing triad = timeBest(executor, bench,
+      [&](int y0, int y1) { triad3Rows(bench, y0, y1, false); });
+    const double baseline = bench.bytes() / triad.seconds * 1e-9;
+    report("triad3", bench, triad, 0.0);
+
+    report("triad3 stream", bench, timeBest(executor, bench,
+      [&](int y0, int y1) { triad3Rows(bench, y0, y1, true); }), baseline);
+
+    // -----------------------------
+    // GRADE VARIANTS
+    // Percentages are of the triad3 bandwidth.
+    // -----------------------------
+    std::printf("grade\n");
+
+    auto gradeWith = [&](const RowHints& hints)
+    {
+      return timeBest(executor, bench, [&](int y0, int y1)
+        {
+          processRows(op, bench.srcV, bench.aovV, &bench.maskV, bench.dstV, y0, y1, hints);
+        });
+    };
+
+    report("plain", bench, gradeWith(RowHints()), baseline);
+
+    // Values the other grade kernels got wrong (see checkDiffers())
+    unsigned long long wrongValues = 0;
+
+    // Same rows, Simd::kWidth pixels at a time (GradeAOVSimd.h)
+    report("simd", bench, timeBest(executor, bench, [&](int y0, int y1)
+      {
+        processRowsSimd(op, bench.srcV, bench.aovV, &bench.maskV, bench.dstV, y0, y1);
+      }), baseline, {{"backend", Simd::backend()}, {"width", "x" + std::to_string(Simd::kWidth)}});
+    wrongValues += checkDiffers(executor, bench, op);
+
+#if defined(GRADEAOV_ISPC)
+    // Same rows, one pixel per SIMD lane (GradeAOV.ispc)
+    report("ispc", bench, timeBest(executor, bench, [&](int y0, int y1)
+      {
+        processRowsIspc(op, bench.srcV, bench.aovV, &bench.maskV, bench.dstV, y0, y1);
+      }), baseline);
+    wrongValues += checkDiffers(executor, bench, op);
+#endif
+
+#if defined(GRADEAOV_HALIDE)
+    // Same bands through the Halide pipelines, the Executor owns the threads
+    halide_set_num_threads(1);
+    for (HalideSchedule schedule : {HalideSchedule::kHand, HalideSchedule::kAuto})
+    {
+      report(schedule == HalideSchedule::kHand ? "halide" : "halide auto", bench,
+             timeBest(executor, bench, [&](int y0, int y1)
+               {
+                 processRowsHalide(op, bench.srcV, bench.aovV, &bench.maskV, bench.dstV,
+                                   y0, y1, schedule);
+               }), baseline);
+      wrongValues += checkDiffers(executor, bench, op);
+    }
+#endif
+
+    RowHints streamOnly;
+    streamOnly.stream = true;
+    report("stream", bench, gradeWith(streamOnly), baseline);
+
+    // Prefetch distances, in pixels (4 per cache line)
+    int bestDistance = 0;
+    double bestTime = 1e30;
+    for (int distance : {16, 32, 64, 128, 256})
+    {
+      RowHints hints;
+      hints.prefetchSrc = hints.prefetchAov = hints.prefetchMask = distance;
+
+      const Timing t = gradeWith(hints);
+      if (t.seconds < bestTime)
+      {
+        bestTime = t.seconds;
+        bestDistance = distance;
+      }
+
+      const std::string name = "prefetch " + std::to_string(distance);
+      report(name.c_str(), bench, t, baseline);
+    }
+
+    RowHints both;
+    both.stream = true;
+    both.prefetchSrc = both.prefetchAov = both.prefetchMask = bestDistance;
+    report("stream + prefetch", bench, gradeWith(both), baseline,
+           {{"distance", std::to_string(bestDistance)}});
+
+    // -----------------------------
+    // FORWARD GAMMA BRANCHES
+    // Same frames, no mask (every pixel graded, none takes the early-out),
+    // gains picked so graded channels take one branch of forward_gamma()
+    // (denoiser negatives aside) or the data dependent mix of the pow
+    // segment and the linear tail. The branch misses per graded channel
+    // tell the mispredict cost.
+    // -----------------------------
+    if (bench.perf)
+    {
+      std::printf("forward_gamma branches\n");
+
+      GradeAOVOpt mixed = op;
+      mixed.useMask = false;
+      mixed.init();
+
+      const double channels = 3.0 * bench.width * bench.height;
+      auto gradeOp = [&](const char* name, const GradeAOVOpt& g)
+      {
+        const Timing t = timeBest(executor, bench, [&](int y0, int y1)
+          {
+            processRows(g, bench.srcV, bench.aovV, nullptr, bench.dstV, y0, y1);
+          });
+        report(name, bench, t, baseline);
+        if (t.perf.cycles && g.mix > 0.0f)
+          std::printf("    %.4f branch misses per graded channel\n",
+                      t.perf.branchMisses / channels);
+      };
+
+      GradeAOVOpt identity = mixed;
+      const float one = 1.0f;
+      identity.setParam("gamma", &one, 1);
+      identity.init();
+      gradeOp("gamma 1 (no pow)", identity);
+
+      GradeAOVOpt powOnly = mixed;
+      const float tiny = 1e-3f;
+      powOnly.setParam("gain", &tiny, 1);
+      powOnly.init();
+      gradeOp("pow segment only", powOnly);
+
+      gradeOp("pow / linear tail mix", mixed);
+
+      if (!bench.perfError.empty())
+        std::printf("  no hardware counters : %s\n", bench.perfError.c_str());
+    }
+
+    // -----------------------------
+    // DENORMALS
+    // Half the covered pixels (alpha > 0) that neither emit nor went
+    // negative hold denormal residue (see synthesizeRows()). No mask, so
+    // the residue reaches the grade everywhere, and viewaov : composited
+    // into the beauty, a 1e-20 change is lost in the beauty's own value,
+    // in the graded AOV (a layer GradeAOVRegrade writes out) it is not.
+    // Three cases : gamma 0.9 (pow keeps denormals denormal), gamma 2 (pow
+    // lifts them to ~1e-20, FTZ turns those into 0) and unpremult (the
+    // divide by a small edge alpha lifts them into the normal range before
+    // the grade).
+    // -----------------------------
+    if (denormals)
+    {
+      std::printf("denormals\n");
+
+      const SynthParams clean = bench.synth;
+      bench.synth.denormalDensity = 0.5f;
+      fill(executor, bench);
+      std::printf("  %-26s %14llu of %llu AOV values\n", "denormal inputs",
+                  (unsigned long long)countDenormals(bench.aovV),
+                  4ull * bench.width * bench.height);
+
+      struct DenormalCase
+      {
+        const char* name;
+        float gamma;
+        bool unpremult;
+      };
+      const DenormalCase cases[] = {{"gamma 0.9", 0.9f, false},
+                                    {"gamma 2", 2.0f, false},
+                                    {"unpremult", 0.9f, true}};
+
+      for (const DenormalCase& dc : cases)
+      {
+        GradeAOVOpt plain = op;
+        plain.setParam("gamma", &dc.gamma, 1);
+        plain.unpremult = dc.unpremult;
+        plain.useMask   = false;
+        plain.viewaov   = true;
+        plain.init();
+
+        auto gradePlain = [&](int y0, int y1)
+        {
+          processRows(plain, bench.srcV, bench.aovV, nullptr, bench.dstV, y0, y1);
+        };
+
+        const std::string kept = std::string(dc.name) + ", denormals kept";
+        const Timing exact = timeBest(executor, bench, gradePlain);
+        report(kept.c_str(), bench, exact, baseline);
+        const std::vector<float> keptOut(bench.dstV.row(0, 0),
+                                         bench.dstV.row(0, 0) +
+                                           size_t(4) * bench.width * bench.height);
+
+        const std::string ftz = std::string(dc.name) + ", flush to zero";
+        executor.setFlushDenormals(true);
+        const Timing flushed = timeBest(executor, bench, gradePlain);
+        executor.setFlushDenormals(false);
+        report(ftz.c_str(), bench, flushed, baseline);
+
+        // What flushing changed in the output
+        double maxDiff = 0.0;
+        unsigned long long changed = 0;
+        const float* out = bench.dstV.row(0, 0);
+        for (size_t i = 0; i < keptOut.size(); i++)
+          if (out[i] != keptOut[i])
+          {
+            changed++;
+            maxDiff = std::max(maxDiff, double(std::fabs(out[i] - keptOut[i])));
+          }
+        std::printf("    speed-up %.2fx, %llu output value(s) changed, max difference %.3g\n",
+                    exact.seconds / flushed.seconds, changed, maxDiff);
+      }
+
+      bench.synth = clean;
+      fill(executor, bench);
+    }
+
+    // -----------------------------
+    // FRAME SEQUENCE
+    // Every frame acquires, fills, grades and releases its four buffers,
+    // like a render of a sequence would. Counters are per frame.
+    // -----------------------------
+    bench.release();
+
+    if (frames > 0)
+      std::printf("frames (%s, huge pages %s)\n", recycle ? "arena" : "no arena",
+                  hugePages ? "requested" : "off");
+
+    // Square tiles for the heatmap, bands otherwise
+    const bool heatmap = !heatmapPath.empty();
+    const int frameTileW = heatmap ? 64 : 0;
+
+    TraceRecorder trace;
+    if (!tracePath.empty())
+      executor.setTrace(&trace);
+
+    for (int f = 0; f < frames; f++)
+    {
+      const uint64_t faults      = processPageFaults();
+      const uint64_t allocations = arena.allocations();
+      const uint64_t reuses      = arena.reuses();
+      auto start = std::chrono::steady_clock::now();
+      const double frameBegin = trace.now();
+
+      bench.acquire(arena);
+      fill(executor, bench);
+      const double fillEnd = trace.now();
+
+      GradeStats stats;
+      std::vector<TileStats> tiles;
+      processImageStats(executor, op, bench.srcV, bench.aovV, &bench.maskV, bench.dstV,
+                        stats, (kStatsEnabled || heatmap) ? &tiles : nullptr, frameTileW,
+                        bench.bandRows);
+      bench.release();
+
+      if (!tracePath.empty())
+      {
+        trace.complete(0, "fill", "frame", frameBegin, fillEnd);
+        trace.complete(0, "frame", "frame", frameBegin, trace.now(),
+                       "\"frame\": " + std::to_string(f));
+      }
+
+      const double seconds = std::chrono::duration<double>(
+                               std::chrono::steady_clock::now() - start).count();
+      std::printf("  frame %-20d %9.2f ms  %llu allocation(s), %llu reuse(s),"
+                  " %llu page fault(s)\n", f, seconds * 1e3,
+                  (unsigned long long)(arena.allocations() - allocations),
+                  (unsigned long long)(arena.reuses() - reuses),
+                  (unsigned long long)(processPageFaults() - faults));
+
+      if (heatmap && f == frames - 1)
+      {
+        TileHeatmap map(bench.width, bench.height, frameTileW, bench.bandRows);
+        for (const TileStats& t : tiles)
+          map.add(t.tile.x0, t.tile.y0, t.tile.x1 - t.tile.x0, t.tile.y1 - t.tile.y0, t.seconds);
+        map.writePNG(heatmapPath);
+
+        double lo, hi;
+        map.range(lo, hi);
+        std::printf("    heatmap: %d x %d tiles, %.2f (black) to %.2f (white) ns per pixel,"
+                    " written to %s\n", map.cols(), map.rows(), lo, hi, heatmapPath.c_str());
+      }
+
+      if (kStatsEnabled && !tiles.empty())
+      {
+        stats.print(stdout, "    ");
+
+        // Most expensive tile per pixel
+        auto cost = [](const TileStats& t)
+        {
+          const uint64_t pixels = t.stats.counts[GradeStats::kPixels];
+          return pixels ? double(t.stats.cycles[GradeStats::kStageRow]) / pixels : 0.0;
+        };
+        const TileStats& worst = *std::max_element(tiles.begin(), tiles.end(),
+          [&](const TileStats& a, const TileStats& b) { return cost(a) < cost(b); });
+        std::printf("    slowest tile (%d, %d)-(%d, %d) %.1f row cycles per pixel\n",
+                    worst.tile.x0, worst.tile.y0, worst.tile.x1, worst.tile.y1, cost(worst));
+      }
+    }
+
+    if (!tracePath.empty())
+    {
+      executor.setTrace(nullptr);
+      trace.write(tracePath);
+      std::printf("trace: %zu event(s) written to %s\n", trace.events(), tracePath.c_str());
+    }
+
+    if (!jsonPath.empty())
+      saveResults(executor, bench, jsonPath);
+
+    if (kAllocCheckEnabled)
+      std::printf("allocation check: %llu allocation(s) seen, none while grading\n",
+                  allocationsChecked());
+
+    if (wrongValues)
+    {
+      std::fprintf(stderr, "GradeAOVBench: %llu value(s) differ from the native grade by more"
+                           " than %g\n", wrongValues, kCheckTolerance);
+      return 1;
+    }
+  }
+  catch (const std::exception& e)
+  {
+    std::fprintf(stderr, "GradeAOVBench: %s\n", e.what());
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,560 @@
+// ============================================================================
+// GradeAOVBlink — BlinkScript compatibility shim for GCC / Clang
+// The Blink types, image accessors, kernel base class and maths functions
+// GradeAOV.cpp uses, so the kernel source itself (after GradeAOVBlinkPP)
+// compiles as C++ and runs over ImageViews on the Executor.
+// ============================================================================
+
+// MAJOR NOTES :
+// Not a Blink compiler : only what the kernels of this repo need.
+//   kernels   : ImageComputationKernel<ePixelWise>, process() or
+//               process(int2 pos), define() / init() / defineParam()
+//   images    : eAccessPoint only (edge modes are then irrelevant),
+//               src() reads the RGBA pixel, dst() = v writes it
+//   types     : int2, float2, float3, float4 (x y z w, [i], element-wise
+//               operators, scalar on either side)
+//   functions : pow, max, min, clamp, fabs, _fc_lerp, on floats and
+//               element-wise on vectors
+// The `kernel` keyword and the param: / local: sections are not C++ :
+// GradeAOVBlinkPP rewrites them and lists the kernel's images, the rest of
+// the source is compiled as it is. Everything lives in GradeAOV::Blink, so
+// the kernel's GradeAOVOpt does not clash with the native port.
+// An unconnected input reads as 0 like in Nuke, so does a channel the view
+// does not have. Writes to a missing channel are dropped.
+// Maths are single precision float like the native port (pow is powf) :
+// with the same compiler flags the shim build is bit exact with
+// GradeAOVOpt in GradeAOVNative.h (GradeAOVBlinkRun checks it).
+// Knobs are found by their Blink label ("black clamp"), the kernel
+// remembers them as offsets, so a copied kernel keeps working.
+
+#pragma once
+
+#include "GradeAOVAlloc.h"
+#include "GradeAOVExecutor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace GradeAOV
+{
+namespace Blink
+{
+
+// -----------------------------
+// ENUMS
+// -----------------------------
+enum KernelGranularity { ePixelWise, eComponentWise };
+enum ImageAccess { eRead, eWrite, eReadWrite };
+enum ImageAccessPattern { eAccessPoint, eAccessRanged1D, eAccessRanged2D, eAccessRandom };
+enum ImageEdgeMethod { eEdgeNone, eEdgeClamped, eEdgeConstant };
+
+// -----------------------------
+// VECTOR TYPES
+// -----------------------------
+struct int2
+{
+  int x = 0, y = 0;
+
+  int2() = default;
+  int2(int x_, int y_) : x(x_), y(y_) {}
+
+  int& operator[](int i) { return i ? y : x; }
+  int operator[](int i) const { return i ? y : x; }
+};
+
+struct float2
+{
+  float x = 0.0f, y = 0.0f;
+
+  static constexpr int size = 2;
+
+  float2() = default;
+  explicit float2(float v) : x(v), y(v) {}
+  float2(float x_, float y_) : x(x_), y(y_) {}
+
+  float& operator[](int i) { return (&x)[i]; }
+  float operator[](int i) const { return (&x)[i]; }
+};
+
+struct float3
+{
+  float x = 0.0f, y = 0.0f, z = 0.0f;
+
+  static constexpr int size = 3;
+
+  float3() = default;
+  explicit float3(float v) : x(v), y(v), z(v) {}
+  float3(float x_, float y_, float z_) : x(x_), y(y_), z(z_) {}
+
+  float& operator[](int i) { return (&x)[i]; }
+  float operator[](int i) const { return (&x)[i]; }
+};
+
+struct float4
+{
+  float x = 0.0f, y = 0.0f, z = 0.0f, w = 0.0f;
+
+  static constexpr int size = 4;
+
+  float4() = default;
+  explicit float4(float v) : x(v), y(v), z(v), w(v) {}
+  float4(float x_, float y_, float z_, float w_) : x(x_), y(y_), z(z_), w(w_) {}
+  float4(const float3& v, float w_) : x(v.x), y(v.y), z(v.z), w(w_) {}
+
+  float& operator[](int i) { return (&x)[i]; }
+  float operator[](int i) const { return (&x)[i]; }
+};
+
+template <class T>
+struct IsVector : std::false_type
+{
+};
+template <>
+struct IsVector<float2> : std::true_type
+{
+};
+template <>
+struct IsVector<float3> : std::true_type
+{
+};
+template <>
+struct IsVector<float4> : std::true_type
+{
+};
+
+// Enables a function for the float vector types only
+template <class T, class R = T>
+using ForVector = typename std::enable_if<IsVector<T>::value, R>::type;
+
+// Element-wise f(a[i], b[i])
+template <class T, class F>
+inline T zipWith(T a, const T& b, F f)
+{
+  for (int i = 0; i < T::size; i++)
+    a[i] = f(a[i], b[i]);
+  return a;
+}
+
+template <class T>
+inline T splat(float v)
+{
+  return T(v);
+}
+
+// -----------------------------
+// OPERATORS
+// -----------------------------
+#define GRADEAOV_BLINK_OPERATOR(OP)                                                           \
+  template <class T>                                                                          \
+  inline ForVector<T> operator OP(const T& a, const T& b)                                     \
+  {                                                                                           \
+    return zipWith(a, b, [](float u, float v) { return u OP v; });                            \
+  }                                                                                           \
+  template <class T>                                                                          \
+  inline ForVector<T> operator OP(const T& a, float b)                                        \
+  {                                                                                           \
+    return a OP splat<T>(b);                                                                  \
+  }                                                                                           \
+  template <class T>                                                                          \
+  inline ForVector<T> operator OP(float a, const T& b)                                        \
+  {                                                                                           \
+    return splat<T>(a) OP b;                                                                  \
+  }                                                                                           \
+  template <class T>                                                                          \
+  inline ForVector<T, T&> operator OP##=(T& a, const T& b)                                    \
+  {                                                                                           \
+    return a = a OP b;                                                                        \
+  }                                                                                           \
+  template <class T>                                                                          \
+  inline ForVector<T, T&> operator OP##=(T& a, float b)                                       \
+  {                                                                                           \
+    return a = a OP splat<T>(b);                                                              \
+  }
+
+GRADEAOV_BLINK_OPERATOR(+)
+GRADEAOV_BLINK_OPERATOR(-)
+GRADEAOV_BLINK_OPERATOR(*)
+GRADEAOV_BLINK_OPERATOR(/)
+
+#undef GRADEAOV_BLINK_OPERATOR
+
+template <class T>
+inline ForVector<T> operator-(T a)
+{
+  for (int i = 0; i < T::size; i++)
+    a[i] = -a[i];
+  return a;
+}
+
+// -----------------------------
+// MATHS FUNCTIONS
+// -----------------------------
+inline float pow(float x, float y) { return std::pow(x, y); }
+inline float fabs(float x) { return std::fabs(x); }
+inline float max(float a, float b) { return std::max(a, b); }
+inline float min(float a, float b) { return std::min(a, b); }
+inline float clamp(float x, float lo, float hi) { return min(max(x, lo), hi); }
+inline float _fc_lerp(float a, float b, float t) { return a + (b - a) * t; }
+
+template <class T>
+inline ForVector<T> pow(const T& x, const T& y)
+{
+  return zipWith(x, y, [](float u, float v) { return std::pow(u, v); });
+}
+
+template <class T>
+inline ForVector<T> fabs(T x)
+{
+  for (int i = 0; i < T::size; i++)
+    x[i] = std::fabs(x[i]);
+  return x;
+}
+
+template <class T>
+inline ForVector<T> max(const T& a, const T& b)
+{
+  return zipWith(a, b, [](float u, float v) { return std::max(u, v); });
+}
+
+template <class T>
+inline ForVector<T> min(const T& a, const T& b)
+{
+  return zipWith(a, b, [](float u, float v) { return std::min(u, v); });
+}
+
+template <class T>
+inline ForVector<T> clamp(const T& x, const T& lo, const T& hi)
+{
+  return min(max(x, lo), hi);
+}
+
+template <class T>
+inline ForVector<T> _fc_lerp(const T& a, const T& b, float t)
+{
+  return a + (b - a) * t;
+}
+
+template <class T>
+inline ForVector<T> _fc_lerp(const T& a, const T& b, const T& t)
+{
+  return a + (b - a) * t;
+}
+
+// -----------------------------
+// IMAGES
+// ImageBase holds the bound view and the current pixel, the runner moves
+// it. Read images hand out a float4, writable ones a Pixel reference.
+// -----------------------------
+class ImageBase
+{
+public:
+  explicit ImageBase(bool writable) : _writable(writable) {}
+
+  bool writable() const { return _writable; }
+  bool bound() const { return _bound; }
+
+  void bind(const ImageView& view)
+  {
+    _view  = view;
+    _bound = true;
+  }
+
+  // Cursor on pixel (x, y), row by row
+  void seekRow(int y)
+  {
+    for (int c = 0; c < 4; c++)
+      _row[c] = _bound ? reinterpret_cast<char*>(_view.row(c, y)) : nullptr;
+    _offset = 0;
+  }
+  void seekX(int x) { _offset = x * _view.pixelStride; }
+
+  float4 load() const
+  {
+    float4 v;
+    for (int c = 0; c < 4; c++)
+      if (_row[c])
+        v[c] = *reinterpret_cast<const float*>(_row[c] + _offset);
+    return v;
+  }
+
+  void store(const float4& v) const
+  {
+    for (int c = 0; c < 4; c++)
+      if (_row[c])
+        *reinterpret_cast<float*>(_row[c] + _offset) = v[c];
+  }
+
+private:
+  ImageView _view;
+  bool _writable;
+  bool _bound = false;
+  char* _row[4] = {nullptr, nullptr, nullptr, nullptr};
+  ptrdiff_t _offset = 0;
+};
+
+// dst() of a writable image : assign a float4, or read it back
+class Pixel
+{
+public:
+  explicit Pixel(const ImageBase& image) : _image(image) {}
+
+  const Pixel& operator=(const float4& v) const
+  {
+    _image.store(v);
+    return *this;
+  }
+
+  operator float4() const { return _image.load(); }
+
+private:
+  const ImageBase& _image;
+};
+
+template <int Access, int Pattern = eAccessPoint, int Edge = eEdgeNone>
+class Image : public ImageBase
+{
+  static_assert(Pattern == eAccessPoint, "GradeAOVBlink : only eAccessPoint images are supported");
+
+public:
+  Image() : ImageBase(Access != eRead) {}
+
+  auto operator()() const
+  {
+    if constexpr (Access == eRead)
+      return load();
+    else
+      return Pixel(*this);
+  }
+};
+
+// -----------------------------
+// ROW ACCESSORS
+// src() / dst() = v over one interleaved RGBA pixel, for kernel bodies
+// compiled as plain functions (GradeAOVGen variants). A null pixel reads
+// as 0.
+// -----------------------------
+class PixelIn
+{
+public:
+  explicit PixelIn(const float* p) : _p(p) {}
+
+  float4 operator()() const { return _p ? float4(_p[0], _p[1], _p[2], _p[3]) : float4(); }
+
+private:
+  const float* _p;
+};
+
+class PixelOut
+{
+public:
+  explicit PixelOut(float* p) : _p(p) {}
+
+  const PixelOut& operator()() const { return *this; }
+
+  const PixelOut& operator=(const float4& v) const
+  {
+    for (int c = 0; c < 4; c++)
+      _p[c] = v[c];
+    return *this;
+  }
+
+private:
+  float* _p;
+};
+
+// -----------------------------
+// KERNEL BASE
+// defineParam() sets the default and remembers the knob by its label.
+// -----------------------------
+template <int Granularity>
+class ImageComputationKernel
+{
+  static_assert(Granularity == ePixelWise, "GradeAOVBlink : only ePixelWise kernels are supported");
+
+public:
+  // -----------------------------
+  // SET A KNOB BY ITS LABEL
+  // Vector knobs take 1 (all components) or up to their size values
+  // (the first ones, like 3 for RGB), ints and bools one,
+  // a bool is set when its value is not 0.
+  // Returns false for unknown knobs or a bad value count.
+  // -----------------------------
+  bool setParam(const std::string& label, const float* v, int n)
+  {
+    for (const Knob& knob : _knobs)
+    {
+      if (knob.label != label)
+        continue;
+
+      char* p = reinterpret_cast<char*>(this) + knob.offset;
+      if (knob.kind == kBool && n == 1)
+        *reinterpret_cast<bool*>(p) = (v[0] != 0.0f);
+      else if (knob.kind == kInt && n == 1)
+        *reinterpret_cast<int*>(p) = int(v[0]);
+      else if (knob.kind == kFloat && n >= 1 && n <= knob.size)
+      {
+        // One value fills every component, more set the first n
+        float* f = reinterpret_cast<float*>(p);
+        for (int i = 0; i < (n == 1 ? knob.size : n); i++)
+          f[i] = v[n == 1 ? 0 : i];
+      }
+      else
+        return false;
+      return true;
+    }
+    return false;
+  }
+
+  // Labels in define() order
+  std::vector<std::string> knobLabels() const
+  {
+    std::vector<std::string> labels;
+    for (const Knob& knob : _knobs)
+      labels.push_back(knob.label);
+    return labels;
+  }
+
+protected:
+  void defineParam(float& p, const char* label, float v) { p = v; addKnob(&p, label, kFloat, 1); }
+  void defineParam(float2& p, const char* label, const float2& v) { p = v; addKnob(&p, label, kFloat, 2); }
+  void defineParam(float3& p, const char* label, const float3& v) { p = v; addKnob(&p, label, kFloat, 3); }
+  void defineParam(float4& p, const char* label, const float4& v) { p = v; addKnob(&p, label, kFloat, 4); }
+  void defineParam(int& p, const char* label, int v) { p = v; addKnob(&p, label, kInt, 1); }
+  void defineParam(bool& p, const char* label, bool v) { p = v; addKnob(&p, label, kBool, 1); }
+
+private:
+  enum Kind { kFloat, kInt, kBool };
+
+  struct Knob
+  {
+    std::string label;
+    ptrdiff_t offset;
+    Kind kind;
+    int size;
+  };
+
+  void addKnob(const void* p, const char* label, Kind kind, int size)
+  {
+    const ptrdiff_t offset = reinterpret_cast<const char*>(p) - reinterpret_cast<const char*>(this);
+    for (Knob& knob : _knobs)
+      if (knob.label == label)
+      {
+        knob = Knob{label, offset, kind, size};
+        return;
+      }
+    _knobs.push_back(Knob{label, offset, kind, size});
+  }
+
+  std::vector<Knob> _knobs;
+};
+
+// -----------------------------
+// IMAGES OF A KERNEL
+// Specialized by GradeAOVBlinkPP for every kernel it translates :
+//   static constexpr int count;
+//   static const char* name(int i);
+//   static ImageBase& image(K& kernel, int i);
+// -----------------------------
+template <class K>
+struct KernelImages;
+
+// A default constructed kernel after define(), ready for setParam()
+template <class K>
+inline K makeKernel()
+{
+  K kernel;
+  kernel.define();
+  return kernel;
+}
+
+// process(int2 pos) when the kernel has it, process() otherwise
+template <class K>
+inline auto callProcess(K& kernel, int x, int y, int) -> decltype(kernel.process(int2()), void())
+{
+  kernel.process(int2(x, y));
+}
+template <class K>
+inline void callProcess(K& kernel, int, int, long)
+{
+  kernel.process();
+}
+
+// An input of runKernel() : the kernel image name and its view (null :
+// unconnected, reads as 0)
+struct Input
+{
+  const char* name;
+  const ImageView* view;
+};
+
+// -----------------------------
+// RUN A KERNEL OVER A VIEW ON THE POOL
+// init() runs once on a copy of kernel, every thread then grades its tiles
+// with its own copy of that. The writable image(s) are bound to dst, read
+// images to the input of the same name (an unconnected input the kernel
+// does not have is ignored, so one input list fits every GradeAOVGen
+// variant). Every view must have the size of dst. Throws
+// std::invalid_argument on an unknown input or a bad size.
+// -----------------------------
+template <class K>
+inline void runKernel(Executor& executor, const K& kernel, const std::vector<Input>& inputs,
+                      const ImageView& dst, int tileW = 0, int tileH = 64)
+{
+  using Images = KernelImages<K>;
+
+  K ready = kernel;
+  for (const Input& input : inputs)
+  {
+    int i = 0;
+    while (i < Images::count && std::string(Images::name(i)) != input.name)
+      i++;
+    if (i == Images::count && !input.view)
+      continue;
+    if (i == Images::count || Images::image(ready, i).writable())
+      throw std::invalid_argument(std::string("GradeAOVBlink: no input image named ") + input.name);
+
+    if (input.view)
+    {
+      if (input.view->width != dst.width || input.view->height != dst.height)
+        throw std::invalid_argument("GradeAOVBlink: inputs and dst must have the same size");
+      Images::image(ready, i).bind(*input.view);
+    }
+  }
+  for (int i = 0; i < Images::count; i++)
+    if (Images::image(ready, i).writable())
+      Images::image(ready, i).bind(dst);
+
+  ready.init();
+
+  // Copies hold the cursors, one per thread
+  std::vector<K> perThread(size_t(executor.threads()), ready);
+
+  executor.forEachTile(dst.width, dst.height, tileW, tileH,
+    [&](const Tile& t, int thread)
+    {
+      K& k = perThread[size_t(thread)];
+      GRADEAOV_NO_ALLOC();
+
+      for (int y = t.y0; y < t.y1; y++)
+      {
+        for (int i = 0; i < Images::count; i++)
+          Images::image(k, i).seekRow(y);
+
+        for (int x = t.x0; x < t.x1; x++)
+        {
+          for (int i = 0; i < Images::count; i++)
+            Images::image(k, i).seekX(x);
+          callProcess(k, x, y, 0);
+        }
+      }
+    });
+}
+
+} // namespace Blink
+} // namespace GradeAOV
@@ -0,0 +1,281 @@
+// ============================================================================
+// GradeAOVBlinkPP — turns a BlinkScript kernel file into a C++ header
+// The output compiles against GradeAOVBlink.h and runs with
+// Blink::runKernel(), so the real GradeAOV.cpp can be built, profiled and
+// checked natively instead of a hand-maintained copy of it.
+// ============================================================================
+
+// USAGE :
+//   GradeAOVBlinkPP kernel.cpp out.h
+//
+// MAJOR NOTES :
+// Only the Blink syntax C++ does not have is rewritten, in place :
+//   kernel Name : ...    ->  struct Name : ...
+//   param: / local:      ->  public:
+// Comments, strings and everything else are copied as they are, and the
+// line numbers do not move : a #line directive points compiler errors,
+// debuggers and profilers at the kernel file itself.
+// For every kernel the Image members (in declaration order) are listed in
+// a KernelImages specialization, which is how runKernel() binds inputs by
+// name and finds the output.
+// The output is wrapped in namespace GradeAOV::Blink.
+//
+// BUILD :
+//   g++ -O2 -std=c++17 GradeAOVBlinkPP.cpp -o GradeAOVBlinkPP
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+struct KernelInfo
+{
+  std::string name;
+  std::vector<std::string> images;
+};
+
+// -----------------------------
+// TRANSLATE
+// A small lexer : it only has to tell code from comments and strings,
+// track the brace depth, and see identifiers.
+// -----------------------------
+class Translator
+{
+public:
+  explicit Translator(const std::string& source) : _s(source) {}
+
+  std::string run()
+  {
+    while (_i < _s.size())
+    {
+      const char c = _s[_i];
+
+      if (startsWith("//"))
+        copyUntil("\n", false);
+      else if (startsWith("/*"))
+        copyUntil("*/", true);
+      else if (c == '"' || c == '\'')
+        copyQuoted(c);
+      else if (std::isalpha(static_cast<unsigned char>(c)) || c == '_')
+        identifier();
+      else
+      {
+        if (c == '{')
+          _depth++;
+        else if (c == '}')
+        {
+          _depth--;
+          if (_depth == 0)
+            _inKernel = false;
+        }
+        _out += c;
+        _i++;
+      }
+    }
+
+    if (_depth != 0)
+      throw std::runtime_error("unbalanced braces");
+    return _out;
+  }
+
+  const std::vector<KernelInfo>& kernels() const { return _kernels; }
+
+private:
+  bool startsWith(const char* text) const { return _s.compare(_i, std::char_traits<char>::length(text), text) == 0; }
+
+  void copyUntil(const char* end, bool inclusive)
+  {
+    size_t stop = _s.find(end, _i + 2);
+    if (stop == std::string::npos)
+      stop = _s.size();
+    else if (inclusive)
+      stop += std::char_traits<char>::length(end);
+    _out.append(_s, _i, stop - _i);
+    _i = stop;
+  }
+
+  void copyQuoted(char quote)
+  {
+    size_t j = _i + 1;
+    while (j < _s.size() && _s[j] != quote && _s[j] != '\n')
+      j += (_s[j] == '\\') ? 2 : 1;
+    j = std::min(j + 1, _s.size());
+    _out.append(_s, _i, j - _i);
+    _i = j;
+  }
+
+  void skipSpace(size_t& j) const
+  {
+    while (j < _s.size() && std::isspace(static_cast<unsigned char>(_s[j])))
+      j++;
+  }
+
+  std::string word(size_t& j) const
+  {
+    const size_t start = j;
+    while (j < _s.size() && (std::isalnum(static_cast<unsigned char>(_s[j])) || _s[j] == '_'))
+      j++;
+    return _s.substr(start, j - start);
+  }
+
+  void identifier()
+  {
+    size_t j = _i;
+    const std::string id = word(j);
+
+    // kernel Name : base
+    if (id == "kernel" && _depth == 0)
+    {
+      size_t k = j;
+      skipSpace(k);
+      const std::string name = word(k);
+      if (!name.empty())
+      {
+        _kernels.push_back(KernelInfo{name, {}});
+        _inKernel = true;
+        _out += "struct";
+        _i = j;
+        return;
+      }
+    }
+
+    // param: / local: sections of the kernel body
+    if ((id == "param" || id == "local") && _inKernel && _depth == 1)
+    {
+      size_t k = j;
+      while (k < _s.size() && (_s[k] == ' ' || _s[k] == '\t'))
+        k++;
+      if (k < _s.size() && _s[k] == ':' && (k + 1 >= _s.size() || _s[k + 1] != ':'))
+      {
+        // The colon is copied next
+        _out += "public";
+        _i = j;
+        return;
+      }
+    }
+
+    // Image<...> a, b; members
+    if (id == "Image" && _inKernel && _depth == 1)
+      imageMembers(j);
+
+    _out += id;
+    _i = j;
+  }
+
+  // Records the names declared after Image<...> at j (not consumed)
+  void imageMembers(size_t j)
+  {
+    skipSpace(j);
+    if (j >= _s.size() || _s[j] != '<')
+      return;
+    const size_t close = _s.find('>', j);
+    if (close == std::string::npos)
+      return;
+
+    j = close + 1;
+    for (;;)
+    {
+      skipSpace(j);
+      const std::string name = word(j);
+      if (name.empty())
+        return;
+      _kernels.back().images.push_back(name);
+      skipSpace(j);
+      if (j >= _s.size() || _s[j] != ',')
+        return;
+      j++;
+    }
+  }
+
+  const std::string& _s;
+  size_t _i = 0;
+  int _depth = 0;
+  bool _inKernel = false;
+  std::string _out;
+  std::vector<KernelInfo> _kernels;
+};
+
+// KernelImages<Name> for runKernel()
+std::string imagesTraits(const KernelInfo& k)
+{
+  std::ostringstream out;
+  out << "\ntemplate <>\nstruct KernelImages<" << k.name << ">\n{\n"
+      << "  static constexpr int count = " << k.images.size() << ";\n\n"
+      << "  static const char* name(int i)\n  {\n    static const char* const names[] = {";
+  for (size_t i = 0; i < k.images.size(); i++)
+    out << (i ? ", " : "") << '"' << k.images[i] << '"';
+  out << "};\n    return names[i];\n  }\n\n"
+      << "  static ImageBase& image(" << k.name << "& kernel, int i)\n  {\n"
+      << "    switch (i)\n    {\n";
+  for (size_t i = 0; i + 1 < k.images.size(); i++)
+    out << "    case " << i << ": return kernel." << k.images[i] << ";\n";
+  out << "    default: return kernel." << k.images.back() << ";\n    }\n  }\n};\n";
+  return out.str();
+}
+
+std::string readFile(const std::string& path)
+{
+  std::ifstream in(path, std::ios::binary);
+  if (!in)
+    throw std::runtime_error("cannot read " + path);
+  std::ostringstream text;
+  text << in.rdbuf();
+  return text.str();
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+  if (argc != 3)
+  {
+    std::fprintf(stderr, "usage: %s kernel.cpp out.h\n", argv[0]);
+    return 2;
+  }
+
+  try
+  {
+    const std::string path = argv[1];
+    const std::string source = readFile(path);
+
+    Translator translator(source);
+    const std::string body = translator.run();
+    if (translator.kernels().empty())
+      throw std::runtime_error("no kernel in " + path);
+
+    std::string out;
+    out += "// Generated by GradeAOVBlinkPP from " + path + ", do not edit.\n";
+    out += "#pragma once\n\n#include \"GradeAOVBlink.h\"\n\n";
+    out += "namespace GradeAOV\n{\nnamespace Blink\n{\n\n";
+    out += "#line 1 \"" + path + "\"\n" + body;
+    if (!body.empty() && body.back() != '\n')
+      out += '\n';
+    for (const KernelInfo& k : translator.kernels())
+    {
+      if (k.images.empty())
+        throw std::runtime_error("kernel " + k.name + " has no Image");
+      out += imagesTraits(k);
+    }
+    out += "\n} // namespace Blink\n} // namespace GradeAOV\n";
+
+    std::ofstream file(argv[2], std::ios::binary);
+    if (!file || !(file << out))
+      throw std::runtime_error(std::string("cannot write ") + argv[2]);
+
+    for (const KernelInfo& k : translator.kernels())
+      std::printf("%s : %zu image(s)\n", k.name.c_str(), k.images.size());
+  }
+  catch (const std::exception& e)
+  {
+    std::fprintf(stderr, "GradeAOVBlinkPP: %s\n", e.what());
+    return 1;
+  }
+  return 0;
+}
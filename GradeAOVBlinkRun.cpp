@@ -0,0 +1,372 @@
+// ============================================================================
+// GradeAOVBlinkRun — runs the real GradeAOV.cpp kernel natively
+// Grades synthetic frames with the BlinkScript source itself (through
+// GradeAOVBlinkPP and the GradeAOVBlink.h shim) on the thread pool, checks
+// every output value against the native port GradeAOVOpt, and times both.
+// ============================================================================
+
+// USAGE :
+//   GradeAOVBlinkRun [-w width] [-h height] [-t threads] [-r repeats]
+//                    [--seed n] [--configs n] [--tolerance t] [--variants]
+//
+//   -w / -h    : image size (default 1920 x 1080)
+//   -t threads : worker threads, 0 = one per hardware thread (default)
+//   -r repeats : timed passes per path, the best one is kept (default 5)
+//   --seed     : seed of the synthetic frames and knob sets (default 1)
+//   --configs  : random knob sets checked after the fixed one (default 64)
+//   --tolerance: largest difference allowed, relative to max(1, |value|)
+//                (default 0, bit exact)
+//   --variants : also check the 64 specialized variants of GradeAOVGen
+//                (GradeAOVVariants.h) against the native port, for every
+//                knob set, and time the one of the fixed knob set
+//
+// Exits 1 when an output differs (the port drifted from the kernel, or a
+// variant from the port).
+//
+// MAJOR NOTES :
+// The fixed knob set has every stage on (gain, gamma, unpremult, mask),
+// the random ones cover the reverse, clamp, view AOV, mix and gamma <= 0
+// paths. Knobs are set by their Blink labels on both sides.
+// NaN outputs compare equal to NaN. Bit exactness needs the compiler to
+// keep the roundings the sources ask for : GCC fuses a * b + c into an FMA
+// wherever it likes with -march=native, and the two sources group their
+// expressions differently, hence -ffp-contract=off below. A contracted
+// build differs by about 1e-7 relative (more ulps near 0, where the
+// composite cancels), check it with --tolerance 1e-6.
+// The shim path reads and writes through per-pixel accessors : it is
+// the kernel as Blink writes it, not a fast path, the timings show what
+// the native port's row loops buy.
+//
+// BUILD :
+//   g++ -O2 -std=c++17 GradeAOVBlinkPP.cpp -o GradeAOVBlinkPP
+//   ./GradeAOVBlinkPP GradeAOV.cpp GradeAOVBlinkKernel.h
+//   g++ -O3 -march=native -ffp-contract=off -std=c++17 -pthread GradeAOVBlinkRun.cpp -o GradeAOVBlinkRun
+//   (perf record / gdb then see GradeAOV.cpp lines)
+//   --variants needs ./GradeAOVGen first, the build picks up
+//   GradeAOVVariants.h when it is there
+
+#include "GradeAOVBlinkKernel.h"
+#include "GradeAOVExecutor.h"
+#include "GradeAOVSynth.h"
+
+#if __has_include("GradeAOVVariants.h")
+#include "GradeAOVVariants.h"
+#define GRADEAOV_VARIANTS 1
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace GradeAOV;
+
+namespace
+{
+
+// One knob value, set the same way on both sides
+struct KnobValue
+{
+  std::string label;
+  std::vector<float> values;
+};
+
+using KnobSet = std::vector<KnobValue>;
+
+// Every stage on, the mask is read
+KnobSet fixedKnobs()
+{
+  return {{"gain", {1.2f, 1.1f, 1.0f, 1.0f}},
+          {"gamma", {0.9f}},
+          {"(un)premult", {1.0f}},
+          {"use mask", {1.0f}}};
+}
+
+KnobSet randomKnobs(std::mt19937& rng)
+{
+  auto uniform = [&](float lo, float hi) { return std::uniform_real_distribution<float>(lo, hi)(rng); };
+  auto chance = [&](int percent) { return int(rng() % 100) < percent; };
+
+  // RGBA, some components on the 0 / 1 special cases
+  auto colour = [&](float lo, float hi)
+  {
+    std::vector<float> v(4);
+    for (float& x : v)
+      x = chance(20) ? float(rng() % 2) : uniform(lo, hi);
+    return v;
+  };
+
+  return {{"blackpoint", colour(-0.2f, 0.3f)},
+          {"whitepoint", colour(0.5f, 2.0f)},
+          {"lift", colour(-0.2f, 0.2f)},
+          {"gain", colour(0.0f, 2.0f)},
+          {"multiply", colour(0.0f, 2.0f)},
+          {"offset", colour(-0.2f, 0.2f)},
+          {"gamma", colour(-0.5f, 2.5f)},
+          {"black clamp", {float(chance(50))}},
+          {"white clamp", {float(chance(50))}},
+          {"view AOV", {float(chance(25))}},
+          {"reverse", {float(chance(50))}},
+          {"(un)premult", {float(chance(50))}},
+          {"mix", {chance(70) ? 1.0f : uniform(0.0f, 1.0f)}},
+          {"use mask", {float(chance(50))}}};
+}
+
+template <class Op>
+void setKnobs(Op& op, const KnobSet& knobs)
+{
+  for (const KnobValue& k : knobs)
+    if (!op.setParam(k.label, k.values.data(), int(k.values.size())))
+      throw std::runtime_error("unknown knob " + k.label);
+}
+
+// Values of a and b further apart than tolerance * max(1, |b|) (NaN
+// equal to NaN), the first one and the largest such relative difference
+long countMismatches(const std::vector<float>& a, const std::vector<float>& b, double tolerance,
+                     long& first, double& largest)
+{
+  long n = 0;
+  first = -1;
+  largest = 0.0;
+  for (size_t i = 0; i < a.size(); i++)
+  {
+    double d;
+    if (std::isnan(a[i]) || std::isnan(b[i]))
+      d = (std::isnan(a[i]) && std::isnan(b[i])) ? 0.0 : HUGE_VAL;
+    else if (std::memcmp(&a[i], &b[i], sizeof(float)) == 0)
+      d = 0.0;
+    else
+      d = std::fabs(double(a[i]) - b[i]) / std::max(1.0, std::fabs(double(b[i])));
+
+    largest = std::max(largest, d);
+    if (d > tolerance || (d > 0.0 && tolerance == 0.0))
+    {
+      if (first < 0)
+        first = long(i);
+      n++;
+    }
+  }
+  return n;
+}
+
+// Best wall time of repeats calls of fn, in milliseconds
+template <class F>
+double bestMs(int repeats, F fn)
+{
+  double best = 1e30;
+  for (int r = 0; r < repeats; r++)
+  {
+    const auto start = std::chrono::steady_clock::now();
+    fn();
+    const auto stop = std::chrono::steady_clock::now();
+    best = std::min(best, std::chrono::duration<double, std::milli>(stop - start).count());
+  }
+  return best;
+}
+
+#if defined(GRADEAOV_VARIANTS)
+// The specialized variant for flags over the frame, on the pool
+void runVariant(Executor& executor, const GradeAOVOpt& op, int flags, const ImageView& src,
+                const ImageView& aov, const ImageView& mask, const ImageView& dst)
+{
+  const Blink::Variants::VariantRow row = Blink::Variants::variantRow(flags);
+  executor.forEachTile(dst.width, dst.height, 0, 64,
+    [&](const Tile& t, int)
+    {
+      for (int y = t.y0; y < t.y1; y++)
+        row(op, src.row(0, y), aov.row(0, y), mask.row(0, y), dst.row(0, y), dst.width);
+    });
+}
+#endif
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+  int width = 1920, height = 1080;
+  int threads = 0;
+  int repeats = 5;
+  int configs = 64;
+  double tolerance = 0.0;
+  bool variants = false;
+  // Denser than production frames : more of every branch per frame
+  SynthParams synth;
+  synth.maskCoverage    = 0.5f;
+  synth.emissionDensity = 0.3f;
+  synth.negativeDensity = 0.2f;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (!std::strcmp(argv[i], "-w") && i + 1 < argc)
+      width = std::atoi(argv[++i]);
+    else if (!std::strcmp(argv[i], "-h") && i + 1 < argc)
+      height = std::atoi(argv[++i]);
+    else if (!std::strcmp(argv[i], "-t") && i + 1 < argc)
+      threads = std::atoi(argv[++i]);
+    else if (!std::strcmp(argv[i], "-r") && i + 1 < argc)
+      repeats = std::max(1, std::atoi(argv[++i]));
+    else if (!std::strcmp(argv[i], "--seed") && i + 1 < argc)
+      synth.seed = uint32_t(std::strtoul(argv[++i], nullptr, 10));
+    else if (!std::strcmp(argv[i], "--configs") && i + 1 < argc)
+      configs = std::max(0, std::atoi(argv[++i]));
+    else if (!std::strcmp(argv[i], "--tolerance") && i + 1 < argc)
+      tolerance = std::max(0.0, std::atof(argv[++i]));
+    else if (!std::strcmp(argv[i], "--variants"))
+      variants = true;
+    else
+    {
+      std::fprintf(stderr, "usage: %s [-w width] [-h height] [-t threads] [-r repeats]"
+                           " [--seed n] [--configs n]\n          [--tolerance t] [--variants]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  try
+  {
+    if (width <= 0 || height <= 0)
+      throw std::runtime_error("bad image size");
+#if !defined(GRADEAOV_VARIANTS)
+    if (variants)
+      throw std::runtime_error("--variants : built without GradeAOVVariants.h (run GradeAOVGen)");
+#endif
+
+    const size_t values = size_t(width) * height * 4;
+    std::vector<float> beauty(values), aov(values), mask(values);
+    std::vector<float> blinkOut(values), nativeOut(values);
+
+    const ImageView beautyView = ImageView::interleaved(beauty.data(), width, height);
+    const ImageView aovView    = ImageView::interleaved(aov.data(), width, height);
+    const ImageView maskView   = ImageView::interleaved(mask.data(), width, height);
+    const ImageView blinkView  = ImageView::interleaved(blinkOut.data(), width, height);
+    const ImageView nativeView = ImageView::interleaved(nativeOut.data(), width, height);
+    synthesize(synth, beautyView, aovView, maskView);
+
+    Executor executor(threads);
+    const std::vector<Blink::Input> inputs = {
+      {"src", &beautyView}, {"aov", &aovView}, {"mask", &maskView}};
+
+    std::printf("GradeAOVBlinkRun: %d x %d RGBA float, %d thread(s), seed %u\n", width, height,
+                executor.threads(), unsigned(synth.seed));
+
+    std::mt19937 rng(synth.seed);
+    long failed = 0;
+    long variantsFailed = 0;
+    double worst = 0.0;
+
+    for (int config = 0; config <= configs; config++)
+    {
+      const KnobSet knobs = config == 0 ? fixedKnobs() : randomKnobs(rng);
+
+      Blink::GradeAOVOpt kernel = Blink::makeKernel<Blink::GradeAOVOpt>();
+      setKnobs(kernel, knobs);
+
+      GradeAOVOpt op;
+      setKnobs(op, knobs);
+      op.init();
+
+      auto runBlink = [&] { Blink::runKernel(executor, kernel, inputs, blinkView); };
+      auto runNative = [&] { processImage(executor, op, beautyView, aovView, &maskView, nativeView); };
+
+      if (config == 0)
+      {
+        const double blinkMs  = bestMs(repeats, runBlink);
+        const double nativeMs = bestMs(repeats, runNative);
+        const double mpix = double(width) * height * 1e-6;
+        std::printf("%-22s %9.2f ms %9.1f Mpix/s\n", "GradeAOV.cpp (shim)", blinkMs,
+                    mpix / (blinkMs * 1e-3));
+        std::printf("%-22s %9.2f ms %9.1f Mpix/s\n", "GradeAOVOpt (native)", nativeMs,
+                    mpix / (nativeMs * 1e-3));
+      }
+      else
+      {
+        runBlink();
+        runNative();
+      }
+
+      long first;
+      double largest;
+      const long bad = countMismatches(blinkOut, nativeOut, tolerance, first, largest);
+      worst = std::max(worst, largest);
+      if (bad)
+      {
+        const long pixel = first / 4;
+        std::printf("config %d : %ld value(s) differ, first at (%ld, %ld) channel %ld :"
+                    " kernel %.9g, native %.9g\n", config, bad, pixel % width, pixel / width,
+                    first % 4, blinkOut[first], nativeOut[first]);
+        failed++;
+      }
+
+#if defined(GRADEAOV_VARIANTS)
+      if (!variants)
+        continue;
+
+      for (int flags = 0; flags < Blink::Variants::kVariantCount; flags++)
+      {
+        GradeAOVOpt flagged = op;
+        flagged.unpremult   = flags & 1;
+        flagged.reverse     = flags & 2;
+        flagged.black_clamp = flags & 4;
+        flagged.white_clamp = flags & 8;
+        flagged.viewaov     = flags & 16;
+        flagged.useMask     = flags & 32;
+        flagged.init();
+
+        auto runFlagged = [&]
+        {
+          processImage(executor, flagged, beautyView, aovView, &maskView, nativeView);
+        };
+        auto runSpecialized = [&]
+        {
+          runVariant(executor, flagged, flags, beautyView, aovView, maskView, blinkView);
+        };
+
+        if (config == 0 && flags == Blink::Variants::variantFlags(op, true))
+        {
+          const double variantMs = bestMs(repeats, runSpecialized);
+          const double mpix = double(width) * height * 1e-6;
+          std::printf("%-22s %9.2f ms %9.1f Mpix/s  (%s)\n", "specialized variant", variantMs,
+                      mpix / (variantMs * 1e-3), Blink::Variants::variantName(flags));
+        }
+        else
+          runSpecialized();
+        runFlagged();
+
+        const long differ = countMismatches(blinkOut, nativeOut, tolerance, first, largest);
+        worst = std::max(worst, largest);
+        if (differ)
+        {
+          if (variantsFailed < 8)
+          {
+            const long pixel = first / 4;
+            std::printf("config %d, %s : %ld value(s) differ, first at (%ld, %ld) channel %ld :"
+                        " variant %.9g, native %.9g\n", config, Blink::Variants::variantName(flags),
+                        differ, pixel % width, pixel / width, first % 4, blinkOut[first],
+                        nativeOut[first]);
+          }
+          variantsFailed++;
+        }
+      }
+#endif
+    }
+
+    if (variants)
+      std::printf("%d knob set(s) checked, %ld differ, %ld variant run(s) differ,"
+                  " largest relative difference %.3g\n", configs + 1, failed, variantsFailed, worst);
+    else
+      std::printf("%d knob set(s) checked, %ld differ, largest relative difference %.3g\n",
+                  configs + 1, failed, worst);
+    return (failed || variantsFailed) ? 1 : 0;
+  }
+  catch (const std::exception& e)
+  {
+    std::fprintf(stderr, "GradeAOVBlinkRun: %s\n", e.what());
+    return 1;
+  }
+}
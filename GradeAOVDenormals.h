@@ -0,0 +1,107 @@
+// ============================================================================
+// GradeAOVDenormals — flush-to-zero mode and denormal counts for the grade
+// Denoised AOVs are full of tiny values, and x86 runs arithmetic (powf
+// above all) on denormal floats through a microcode assist that costs
+// 100+ cycles per operation.
+// ============================================================================
+
+// MAJOR NOTES :
+// FlushDenormals sets the calling thread's FTZ (results flushed to zero)
+// and DAZ (inputs read as zero) modes, and puts the previous mode back
+// when it goes out of scope. The mode is per thread : the Executor sets it
+// around every tile when setFlushDenormals(true) (see GradeAOVExecutor.h).
+// ACCURACY : values below FLT_MIN (1.18e-38) become 0 (signed), inputs
+// and results alike. Through the linear stage alone that is an error of
+// about |A| * FLT_MIN. But FTZ can change results anywhere a denormal
+// feeds pow() or a divide, by far more than that : pow(x, 1 / gamma) with
+// gamma > 1 lifts a denormal into the normal range (gamma 2 on 1e-40
+// gives 1e-20, flushed it gives 0), and so does unpremult's divide by a
+// small alpha. Composited into the beauty such changes usually vanish,
+// in a graded AOV written on its own they stay. GradeAOVBench --denormals
+// reports the difference for gamma 0.9, gamma 2 and unpremult.
+// x86 (SSE MXCSR) and AArch64 (FPCR.FZ, flushes inputs and results) only,
+// elsewhere the scope does nothing and flushing() says false.
+// Builds with -ffast-math already start in FTZ / DAZ mode.
+
+#pragma once
+
+#include "GradeAOVImage.h"
+
+#include <cmath>
+#include <cstdint>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define GRADEAOV_MXCSR 1
+#elif defined(__aarch64__)
+#define GRADEAOV_FPCR 1
+#endif
+
+namespace GradeAOV
+{
+
+// -----------------------------
+// FLUSH-TO-ZERO SCOPE
+// -----------------------------
+class FlushDenormals
+{
+public:
+  explicit FlushDenormals(bool on = true)
+  {
+    _saved = readMode();
+    if (on)
+      writeMode(_saved | kFlushBits);
+  }
+
+  ~FlushDenormals() { writeMode(_saved); }
+
+  FlushDenormals(const FlushDenormals&) = delete;
+  FlushDenormals& operator=(const FlushDenormals&) = delete;
+
+  // True when the calling thread flushes denormals now
+  static bool flushing() { return kFlushBits && (readMode() & kFlushBits) == kFlushBits; }
+
+private:
+#if defined(GRADEAOV_MXCSR)
+  // FTZ (bit 15) and DAZ (bit 6)
+  static constexpr uint64_t kFlushBits = 0x8040;
+  static uint64_t readMode() { return _mm_getcsr(); }
+  static void writeMode(uint64_t mode) { _mm_setcsr(unsigned(mode)); }
+#elif defined(GRADEAOV_FPCR)
+  // FZ (bit 24)
+  static constexpr uint64_t kFlushBits = uint64_t(1) << 24;
+  static uint64_t readMode()
+  {
+    uint64_t fpcr;
+    __asm__ __volatile__("mrs %0, fpcr" : "=r"(fpcr));
+    return fpcr;
+  }
+  static void writeMode(uint64_t mode) { __asm__ __volatile__("msr fpcr, %0" : : "r"(mode)); }
+#else
+  static constexpr uint64_t kFlushBits = 0;
+  static uint64_t readMode() { return 0; }
+  static void writeMode(uint64_t) {}
+#endif
+
+  uint64_t _saved;
+};
+
+// -----------------------------
+// COUNT DENORMAL VALUES OF A VIEW
+// Every present channel of every pixel.
+// -----------------------------
+inline uint64_t countDenormals(const ImageView& view)
+{
+  uint64_t n = 0;
+  for (int y = 0; y < view.height; y++)
+    for (int c = 0; c < 4; c++)
+      if (const float* row = view.row(c, y))
+      {
+        const char* p = reinterpret_cast<const char*>(row);
+        for (int x = 0; x < view.width; x++, p += view.pixelStride)
+          n += std::fpclassify(*reinterpret_cast<const float*>(p)) == FP_SUBNORMAL;
+      }
+  return n;
+}
+
+} // namespace GradeAOV
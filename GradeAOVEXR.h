@@ -0,0 +1,399 @@
+// ============================================================================
+// GradeAOVEXR — channel-selective EXR reading for the GradeAOV tools
+// Decodes only the requested channels of a multi-part / multi-layer EXR
+// into planar float buffers, counting the bytes actually read from disk,
+// and copies untouched parts to an output without decoding them.
+// Tiled inputs can be read region by region through a bounded LRU tile
+// cache, so memory stays fixed whatever the image size.
+// ============================================================================
+
+// MAJOR NOTES :
+// Parts holding none of the requested channels are never read, their chunks
+// are skipped entirely. Inside a part OpenEXR still reads and decompresses
+// whole chunks (all channels are interleaved per scanline in a chunk), only
+// the requested channels are converted to float. Renders written with one
+// part per AOV get the full saving.
+// UINT channels (object IDs) are not converted : their 32 bits are stored
+// as they are in the float plane (see planeSliceType), for copying only.
+
+#pragma once
+
+#include "GradeAOVTileCache.h"
+
+#include <OpenEXR/ImfChannelList.h>
+#include <OpenEXR/ImfCompression.h>
+#include <OpenEXR/ImfFrameBuffer.h>
+#include <OpenEXR/ImfHeader.h>
+#include <OpenEXR/ImfIO.h>
+#include <OpenEXR/ImfInputPart.h>
+#include <OpenEXR/ImfMultiPartInputFile.h>
+#include <OpenEXR/ImfMultiPartOutputFile.h>
+#include <OpenEXR/ImfOutputPart.h>
+#include <OpenEXR/ImfPartType.h>
+#include <OpenEXR/ImfThreading.h>
+#include <OpenEXR/ImfTiledInputPart.h>
+#include <OpenEXR/ImfTiledOutputPart.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace GradeAOV
+{
+
+// -----------------------------
+// INPUT STREAM COUNTING THE BYTES READ
+// -----------------------------
+class CountingIStream : public Imf::IStream
+{
+public:
+  explicit CountingIStream(const char fileName[])
+    : Imf::IStream(fileName), _in(fileName, std::ios::binary)
+  {
+    if (!_in)
+      throw std::runtime_error(std::string("cannot open ") + fileName);
+
+    _in.seekg(0, std::ios::end);
+    _size = uint64_t(_in.tellg());
+    _in.seekg(0);
+  }
+
+  bool read(char c[], int n) override
+  {
+    _in.read(c, n);
+    if (_in.gcount() != n)
+      throw std::runtime_error(std::string("early end of file in ") + fileName());
+
+    _bytes += uint64_t(n);
+    return !_in.eof();
+  }
+
+  uint64_t tellg() override { return uint64_t(_in.tellg()); }
+
+  void seekg(uint64_t pos) override
+  {
+    _in.seekg(std::streamoff(pos));
+    _seeks++;
+  }
+
+  void clear() override { _in.clear(); }
+
+  // Bytes handed to OpenEXR so far, and seeks done
+  uint64_t bytesRead() const { return _bytes; }
+  uint64_t seeks() const { return _seeks; }
+
+  // Size of the file on disk
+  uint64_t fileSize() const { return _size; }
+
+private:
+  std::ifstream _in;
+  uint64_t _bytes = 0;
+  uint64_t _seeks = 0;
+  uint64_t _size  = 0;
+};
+
+// -----------------------------
+// SLICE TYPE OF A PLANE
+// HALF and FLOAT channels decode to float. A UINT channel goes through a
+// UINT slice : converting IDs to float would round those above 2^24.
+// -----------------------------
+inline Imf::PixelType planeSliceType(Imf::PixelType channelType)
+{
+  return channelType == Imf::UINT ? Imf::UINT : Imf::FLOAT;
+}
+
+// -----------------------------
+// CHANNEL-SELECTIVE PLANAR READER
+// request() every channel first, then readBlock() scanline blocks, or
+// readRegion() any box of tiled parts.
+// Each channel lands in its own plane, rows of the block packed one after
+// the other (width floats per row), ready for GradeAOVOpt::processRowPlanar.
+// -----------------------------
+class EXRChannelReader
+{
+public:
+  explicit EXRChannelReader(const char fileName[],
+                            int numThreads = Imf::globalThreadCount())
+    : _stream(fileName), _file(_stream, numThreads),
+      _used(_file.parts(), false), _scan(_file.parts()), _tiled(_file.parts())
+  {
+  }
+
+  // Decoded tile budget for readRegion(), in bytes
+  void setTileCacheSize(size_t bytes) { _cache.setBudget(bytes); }
+
+  // Part holding a channel, -1 if not in the file
+  int findChannel(const std::string& name) const
+  {
+    for (int p = 0; p < _file.parts(); p++)
+      if (_file.header(p).channels().findChannel(name.c_str()))
+        return p;
+    return -1;
+  }
+
+  // Ask for a channel, returns its plane index (-1 if not in the file).
+  // Asking twice for the same channel returns the same plane.
+  int request(const std::string& name)
+  {
+    for (size_t i = 0; i < _planes.size(); i++)
+      if (_planes[i].name == name)
+        return int(i);
+
+    int p = findChannel(name);
+    if (p < 0)
+      return -1;
+
+    // Every part we read must cover the same pixels
+    const Imath::Box2i& dw = _file.header(p).dataWindow();
+    if (_planes.empty())
+      _dw = dw;
+    else if (dw.min.x != _dw.min.x || dw.max.x != _dw.max.x ||
+             dw.min.y != _dw.min.y || dw.max.y != _dw.max.y)
+      throw std::runtime_error("channel '" + name + "' has a different data window");
+
+    if (!_used[p])
+    {
+      _used[p] = true;
+      _blockLines = std::max(_blockLines,
+                             Imf::getCompressionNumScanlines(_file.header(p).compression()));
+    }
+
+    Plane plane;
+    plane.name = name;
+    plane.part = p;
+    plane.type = _file.header(p).channels().findChannel(name.c_str())->type;
+    _planes.push_back(plane);
+    return int(_planes.size() - 1);
+  }
+
+  // Ask for every channel of a part
+  void requestPart(int part)
+  {
+    const Imf::ChannelList& channels = _file.header(part).channels();
+    for (Imf::ChannelList::ConstIterator i = channels.begin(); i != channels.end(); ++i)
+      request(i.name());
+  }
+
+  // Decode rows y0..y1 (inclusive) of every requested channel
+  void readBlock(int y0, int y1)
+  {
+    const int width = _dw.max.x - _dw.min.x + 1;
+    const size_t xStride = sizeof(float);
+    const size_t yStride = xStride * width;
+
+    for (int p = 0; p < int(_used.size()); p++)
+    {
+      if (!_used[p])
+        continue;
+
+      if (!_scan[p])
+        _scan[p].reset(new Imf::InputPart(_file, p));
+
+      Imf::FrameBuffer fb;
+      for (Plane& plane : _planes)
+      {
+        if (plane.part != p)
+          continue;
+
+        if (plane.data.size() < size_t(width) * _blockLines)
+          plane.data.resize(size_t(width) * _blockLines);
+
+        char* base = reinterpret_cast<char*>(plane.data.data())
+                   - _dw.min.x * xStride - y0 * yStride;
+        fb.insert(plane.name.c_str(),
+                  Imf::Slice(planeSliceType(plane.type), base, xStride, yStride));
+      }
+
+      _scan[p]->setFrameBuffer(fb);
+      _scan[p]->readPixels(y0, y1);
+    }
+  }
+
+  // Decode a box of every requested channel, all parts must be tiled.
+  // Planes are packed with the box width. Tiles come from the LRU cache,
+  // a tile straddling two boxes is decoded once as long as it stays cached.
+  void readRegion(const Imath::Box2i& box)
+  {
+    const int w = box.max.x - box.min.x + 1;
+    const int h = box.max.y - box.min.y + 1;
+
+    for (Plane& plane : _planes)
+      if (plane.data.size() < size_t(w) * h)
+        plane.data.resize(size_t(w) * h);
+
+    for (int p = 0; p < int(_used.size()); p++)
+    {
+      if (!_used[p])
+        continue;
+
+      if (!_tiled[p])
+      {
+        if (!_file.header(p).hasTileDescription())
+          throw std::runtime_error("part " + std::to_string(p) + " is not tiled");
+        _tiled[p].reset(new Imf::TiledInputPart(_file, p));
+      }
+
+      Imf::TiledInputPart& in = *_tiled[p];
+      const int tw = int(in.tileXSize());
+      const int th = int(in.tileYSize());
+
+      // Tiles overlapping the box
+      const int tx0 = (box.min.x - _dw.min.x) / tw;
+      const int tx1 = (box.max.x - _dw.min.x) / tw;
+      const int ty0 = (box.min.y - _dw.min.y) / th;
+      const int ty1 = (box.max.y - _dw.min.y) / th;
+
+      for (int ty = ty0; ty <= ty1; ty++)
+        for (int tx = tx0; tx <= tx1; tx++)
+        {
+          const Imath::Box2i tb = in.dataWindowForTile(tx, ty);
+          const int tileW = tb.max.x - tb.min.x + 1;
+          const int tilePx = tileW * (tb.max.y - tb.min.y + 1);
+          const float* tile = fetchTile(p, tx, ty, tb);
+
+          // Overlap of tile and box
+          const int x0 = std::max(tb.min.x, box.min.x);
+          const int x1 = std::min(tb.max.x, box.max.x);
+          const int y0 = std::max(tb.min.y, box.min.y);
+          const int y1 = std::min(tb.max.y, box.max.y);
+
+          int k = 0;
+          for (Plane& plane : _planes)
+          {
+            if (plane.part != p)
+              continue;
+
+            const float* from = tile + size_t(k++) * tilePx;
+            for (int y = y0; y <= y1; y++)
+              std::copy(from + (y - tb.min.y) * tileW + (x0 - tb.min.x),
+                        from + (y - tb.min.y) * tileW + (x1 - tb.min.x) + 1,
+                        plane.data.data() + size_t(y - box.min.y) * w + (x0 - box.min.x));
+          }
+        }
+    }
+  }
+
+  // -----------------------------
+  // ACCESSORS
+  // -----------------------------
+
+  Imf::MultiPartInputFile& file() { return _file; }
+  const Imf::Header& header(int part) const { return _file.header(part); }
+  int parts() const { return _file.parts(); }
+
+  // Data window shared by the requested channels
+  const Imath::Box2i& dataWindow() const { return _dw; }
+
+  // Scanlines per block : tallest compression chunk of the parts we read
+  int blockLines() const { return _blockLines; }
+
+  int planes() const { return int(_planes.size()); }
+  float* plane(int i) { return _planes[i].data.data(); }
+  std::vector<float>& planeBuffer(int i) { return _planes[i].data; }
+  const std::string& planeName(int i) const { return _planes[i].name; }
+  int planePart(int i) const { return _planes[i].part; }
+  Imf::PixelType planeType(int i) const { return _planes[i].type; }
+
+  // Parts we decode
+  bool partRead(int part) const { return _used[part]; }
+
+  // Number of parts we actually decode
+  int partsRead() const { return int(std::count(_used.begin(), _used.end(), true)); }
+
+  // Tile cache statistics
+  uint64_t tileHits() const { return _cache.hits(); }
+  uint64_t tileMisses() const { return _cache.misses(); }
+  uint64_t tileEvictions() const { return _cache.evictions(); }
+  size_t tileCacheBytes() const { return _cache.bytes(); }
+  size_t tileCachePeak() const { return _cache.peak(); }
+
+  const CountingIStream& stream() const { return _stream; }
+
+private:
+  struct Plane
+  {
+    std::string name;
+    int part = -1;
+    Imf::PixelType type = Imf::HALF;
+    std::vector<float> data;
+  };
+
+  // Tile tb of part p from the cache : the requested planes of the part,
+  // one after the other, decoding them on a miss
+  const float* fetchTile(int p, int tx, int ty, const Imath::Box2i& tb)
+  {
+    const int tileW = tb.max.x - tb.min.x + 1;
+    const size_t tilePx = size_t(tileW) * (tb.max.y - tb.min.y + 1);
+
+    size_t planes = 0;
+    for (const Plane& plane : _planes)
+      planes += (plane.part == p);
+
+    return _cache.fetch(p, tx, ty, planes * tilePx, [&](float* data)
+      {
+        // Decode the requested channels of this tile only
+        Imf::FrameBuffer fb;
+        const size_t xStride = sizeof(float);
+        const size_t yStride = xStride * tileW;
+        size_t k = 0;
+        for (const Plane& plane : _planes)
+        {
+          if (plane.part != p)
+            continue;
+
+          char* base = reinterpret_cast<char*>(data + k++ * tilePx)
+                     - tb.min.x * xStride - tb.min.y * yStride;
+          fb.insert(plane.name.c_str(),
+                    Imf::Slice(planeSliceType(plane.type), base, xStride, yStride));
+        }
+        Imf::TiledInputPart& in = *_tiled[p];
+        in.setFrameBuffer(fb);
+        in.readTile(tx, ty);
+      }).data();
+  }
+
+  CountingIStream _stream;
+  Imf::MultiPartInputFile _file;
+  std::vector<bool> _used;
+  std::vector<std::unique_ptr<Imf::InputPart>> _scan;
+  std::vector<std::unique_ptr<Imf::TiledInputPart>> _tiled;
+  std::vector<Plane> _planes;
+  Imath::Box2i _dw;
+  int _blockLines = 1;
+
+  // Decoded tiles of readRegion()
+  TileCache _cache;
+};
+
+// -----------------------------
+// COPY A PART VERBATIM
+// Compressed chunks go straight from input to output, nothing is decoded.
+// The output header must be the input header of that part.
+// -----------------------------
+inline void copyPartVerbatim(Imf::MultiPartInputFile& in, int inPart,
+                             Imf::MultiPartOutputFile& out, int outPart)
+{
+  const Imf::Header& h = in.header(inPart);
+
+  if (h.hasType() && (h.type() == Imf::DEEPSCANLINE || h.type() == Imf::DEEPTILE))
+    throw std::runtime_error("deep parts can't be copied");
+
+  if (h.hasTileDescription())
+  {
+    Imf::TiledInputPart src(in, inPart);
+    Imf::TiledOutputPart dst(out, outPart);
+    dst.copyPixels(src);
+  }
+  else
+  {
+    Imf::InputPart src(in, inPart);
+    Imf::OutputPart dst(out, outPart);
+    dst.copyPixels(src);
+  }
+}
+
+} // namespace GradeAOV
@@ -0,0 +1,423 @@
+// ============================================================================
+// GradeAOVExecutor — tiled multi-threaded driver for the native GradeAOVOpt
+// Splits an image into tiles and runs them on a persistent thread pool.
+// ============================================================================
+
+// MAJOR NOTES :
+// Tiles are handed out through an atomic counter, so threads that finish
+// early pick up more work. The calling thread works too (as thread 0).
+// The first exception thrown by a tile is rethrown by forEachTile().
+// Tiles never overlap and every pixel belongs to exactly one tile, which is
+// what makes in-place grading safe with any tile shape and thread count.
+// NUMA mode : threads are pinned to memory nodes in blocks and every node
+// owns a fixed, contiguous share of the tiles (it steals from the other
+// nodes only once its own share is done). Buffers first touched through
+// firstTouch() with the same tiling end up on the node that grades them.
+// setTrace() records every tile, queue stall and drain wait per thread
+// into a Chrome trace (GradeAOVTrace.h).
+// setFlushDenormals() runs every tile in flush-to-zero mode
+// (GradeAOVDenormals.h), the threads' own mode is restored after each tile.
+
+#pragma once
+
+#include "GradeAOVDenormals.h"
+#include "GradeAOVImage.h"
+#include "GradeAOVNuma.h"
+#include "GradeAOVTrace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace GradeAOV
+{
+
+// Pixel box [x0, x1) x [y0, y1)
+struct Tile
+{
+  int x0, y0, x1, y1;
+};
+
+class Executor
+{
+public:
+  // threads <= 0 : one per hardware thread
+  // numa : pin threads per memory node and split tiles per node
+  explicit Executor(int threads = 0, bool numa = false)
+    : _numa(numa)
+  {
+    if (threads <= 0)
+      threads = int(std::max(1u, std::thread::hardware_concurrency()));
+
+    // Threads go to nodes in contiguous blocks, thread 0 on node 0
+    _threadNode.assign(threads, 0);
+    if (_numa)
+    {
+      _topology = NumaTopology::detect();
+      _nodes = std::max(1, std::min(_topology.nodes(), threads));
+      for (int i = 0; i < threads; i++)
+        _threadNode[i] = int(int64_t(i) * _nodes / threads);
+    }
+    _nodeNext.reset(new std::atomic<int>[_nodes]);
+    _nodeEnd.assign(_nodes, 0);
+
+    for (int i = 1; i < threads; i++)
+      _workers.emplace_back([this, i] { workerLoop(i); });
+  }
+
+  ~Executor()
+  {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _quit = true;
+    }
+    _wake.notify_all();
+    for (std::thread& t : _workers)
+      t.join();
+  }
+
+  Executor(const Executor&) = delete;
+  Executor& operator=(const Executor&) = delete;
+
+  int threads() const { return int(_workers.size()) + 1; }
+
+  // Memory nodes in use (1 unless NUMA mode found several)
+  int nodes() const { return _nodes; }
+  int nodeOf(int thread) const { return _threadNode[thread]; }
+
+  // Tiles run by a thread of another node than their own, since creation
+  unsigned long long stolenTiles() const { return _stolen; }
+
+  // Record jobs into trace (null = off), one lane per thread.
+  // Only call between jobs, the recorder must outlive its use.
+  void setTrace(TraceRecorder* trace)
+  {
+    _trace = trace;
+    if (!_trace)
+      return;
+
+    _trace->addLanes(threads());
+    for (int i = 0; i < threads(); i++)
+    {
+      std::string name = i ? "worker " + std::to_string(i) : std::string("caller");
+      if (_nodes > 1)
+        name += " (node " + std::to_string(_threadNode[i]) + ")";
+      _trace->setLaneName(i, name);
+    }
+  }
+
+  TraceRecorder* trace() const { return _trace; }
+
+  // Flush denormals to zero in every tile (FTZ / DAZ), between jobs only
+  void setFlushDenormals(bool on) { _flushDenormals = on; }
+  bool flushDenormals() const { return _flushDenormals; }
+
+  // -----------------------------
+  // RUN fn(tile, thread) ON EVERY TILE OF A width x height IMAGE
+  // tileW / tileH <= 0 mean full width / full height.
+  // Tiles are numbered row by row, thread is in [0, threads()).
+  // Node n owns tiles [n * count / nodes(), (n + 1) * count / nodes()).
+  // -----------------------------
+  void forEachTile(int width, int height, int tileW, int tileH,
+                   const std::function<void(const Tile&, int)>& fn)
+  {
+    if (width <= 0 || height <= 0)
+      return;
+
+    tileW = (tileW <= 0) ? width  : std::min(tileW, width);
+    tileH = (tileH <= 0) ? height : std::min(tileH, height);
+
+    const int tilesX = (width  + tileW - 1) / tileW;
+    const int tilesY = (height + tileH - 1) / tileH;
+
+    // Publish the job
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _fn     = &fn;
+      _width  = width;
+      _height = height;
+      _tileW  = tileW;
+      _tileH  = tileH;
+      _tilesX = tilesX;
+      _tiles  = tilesX * tilesY;
+      for (int n = 0; n < _nodes; n++)
+      {
+        _nodeNext[n] = int(int64_t(n) * _tiles / _nodes);
+        _nodeEnd[n]  = int(int64_t(n + 1) * _tiles / _nodes);
+      }
+      _busy   = int(_workers.size());
+      _error  = nullptr;
+      _published = _trace ? _trace->now() : 0.0;
+      _job++;
+    }
+    _wake.notify_all();
+
+    // Work on it ourselves (on node 0 in NUMA mode), then wait for the workers
+    if (_numa)
+    {
+      const std::vector<int> saved = currentAffinity();
+      pinCurrentThread(_topology.nodeCpus[0]);
+      runTiles(0);
+      pinCurrentThread(saved);
+    }
+    else
+      runTiles(0);
+
+    const double drain = _trace ? _trace->now() : 0.0;
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    _done.wait(lock, [this] { return _busy == 0; });
+    _fn = nullptr;
+
+    // Time the caller waited for the slowest worker
+    if (_trace)
+      _trace->complete(0, "drain", "executor", drain, _trace->now());
+
+    if (_error)
+      std::rethrow_exception(_error);
+  }
+
+private:
+  void workerLoop(int index)
+  {
+    if (_numa)
+      pinCurrentThread(_topology.nodeCpus[_threadNode[index]]);
+
+    unsigned seen = 0;
+    for (;;)
+    {
+      {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _wake.wait(lock, [&] { return _quit || _job != seen; });
+        if (_quit)
+          return;
+        seen = _job;
+      }
+
+      runTiles(index);
+
+      std::lock_guard<std::mutex> lock(_mutex);
+      if (--_busy == 0)
+        _done.notify_one();
+    }
+  }
+
+  void runTiles(int thread)
+  {
+    // From the job being published to this thread starting on it
+    if (_trace)
+      _trace->complete(thread, "queue stall", "executor", _published, _trace->now());
+
+    // Own node first, then help the others
+    const int home = _threadNode[thread];
+    for (int k = 0; k < _nodes; k++)
+    {
+      const int node = (home + k) % _nodes;
+      for (;;)
+      {
+        const int i = _nodeNext[node].fetch_add(1);
+        if (i >= _nodeEnd[node])
+          break;
+        if (k)
+          _stolen++;
+        runTile(i, thread, k != 0);
+      }
+    }
+  }
+
+  void runTile(int i, int thread, bool stolen)
+  {
+    Tile t;
+    t.x0 = (i % _tilesX) * _tileW;
+    t.y0 = (i / _tilesX) * _tileH;
+    t.x1 = std::min(t.x0 + _tileW, _width);
+    t.y1 = std::min(t.y0 + _tileH, _height);
+
+    const double begin = _trace ? _trace->now() : 0.0;
+
+    try
+    {
+      FlushDenormals flush(_flushDenormals);
+      (*_fn)(t, thread);
+    }
+    catch (...)
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      if (!_error)
+        _error = std::current_exception();
+
+      // Skip the remaining tiles
+      for (int n = 0; n < _nodes; n++)
+        _nodeNext[n] = _nodeEnd[n];
+    }
+
+    if (_trace)
+      _trace->complete(thread, "tile", "grade", begin, _trace->now(),
+                       "\"x0\": " + std::to_string(t.x0) + ", \"y0\": " + std::to_string(t.y0) +
+                       ", \"x1\": " + std::to_string(t.x1) + ", \"y1\": " + std::to_string(t.y1) +
+                       (stolen ? ", \"stolen\": true" : ""));
+  }
+
+  std::vector<std::thread> _workers;
+  std::mutex _mutex;
+  std::condition_variable _wake;
+  std::condition_variable _done;
+
+  // Current job
+  const std::function<void(const Tile&, int)>* _fn = nullptr;
+  int _width = 0, _height = 0;
+  int _tileW = 0, _tileH = 0;
+  int _tilesX = 0, _tiles = 0;
+
+  // Next and end tile of every node's share
+  std::unique_ptr<std::atomic<int>[]> _nodeNext;
+  std::vector<int> _nodeEnd;
+  int _busy = 0;
+  unsigned _job = 0;
+  bool _quit = false;
+  std::exception_ptr _error;
+
+  // NUMA layout
+  bool _numa = false;
+  NumaTopology _topology;
+  int _nodes = 1;
+  std::vector<int> _threadNode;
+  std::atomic<unsigned long long> _stolen{0};
+
+  bool _flushDenormals = false;
+
+  // Tracing
+  TraceRecorder* _trace = nullptr;
+  double _published = 0.0;
+};
+
+// -----------------------------
+// PROCESS A WHOLE VIEW ON THE POOL
+// Same contract as processImage(), tiles of tileW x tileH pixels
+// (default : full-width bands of 64 rows).
+// -----------------------------
+inline void processImage(Executor& executor, const GradeAOVOpt& op,
+                         const ImageView& src, const ImageView& aov,
+                         const ImageView* mask, const ImageView& dst,
+                         int tileW = 0, int tileH = 64, const RowHints& hints = RowHints())
+{
+  checkViews(src, aov, mask, dst);
+
+  executor.forEachTile(src.width, src.height, tileW, tileH,
+    [&](const Tile& t, int)
+    {
+      const int w = t.x1 - t.x0;
+      const int h = t.y1 - t.y0;
+
+      const ImageView m = mask ? mask->crop(t.x0, t.y0, w, h) : ImageView();
+      processRows(op, src.crop(t.x0, t.y0, w, h), aov.crop(t.x0, t.y0, w, h),
+                  mask ? &m : nullptr, dst.crop(t.x0, t.y0, w, h), 0, h, hints);
+    });
+}
+
+// In-place version, the result overwrites image
+inline void processImageInPlace(Executor& executor, const GradeAOVOpt& op,
+                                const ImageView& image, const ImageView& aov,
+                                const ImageView* mask, int tileW = 0, int tileH = 64,
+                                const RowHints& hints = RowHints())
+{
+  processImage(executor, op, image, aov, mask, image, tileW, tileH, hints);
+}
+
+// -----------------------------
+// FIRST TOUCH A VIEW ON THE POOL
+// Zeroes every channel tile by tile. Linux places a page on the node of
+// the thread that first writes it, so call this on freshly allocated
+// (never written) memory with the tiling used to grade it later.
+// Full-width bands keep pages from straddling two nodes.
+// -----------------------------
+inline void firstTouch(Executor& executor, const ImageView& view, int tileW = 0, int tileH = 64)
+{
+  executor.forEachTile(view.width, view.height, tileW, tileH,
+    [&](const Tile& t, int)
+    {
+      for (int y = t.y0; y < t.y1; y++)
+        for (int c = 0; c < 4; c++)
+          if (float* row = view.row(c, y))
+          {
+            char* p = reinterpret_cast<char*>(row) + t.x0 * view.pixelStride;
+            for (int x = t.x0; x < t.x1; x++, p += view.pixelStride)
+              *reinterpret_cast<float*>(p) = 0.0f;
+          }
+    });
+}
+
+// -----------------------------
+// PROCESS A WHOLE VIEW WITH HOT PATH STATS
+// Same as processImage(), frame receives the totals and tiles (if not null)
+// the stats of every tile, row by row. Stats are all zero unless the grade
+// is built with -DGRADEAOV_STATS (see GradeAOVStats.h), tile times are
+// always there.
+// -----------------------------
+struct TileStats
+{
+  Tile tile;
+  GradeStats stats;
+
+  // Wall time of the tile
+  double seconds = 0.0;
+};
+
+inline void processImageStats(Executor& executor, const GradeAOVOpt& op,
+                              const ImageView& src, const ImageView& aov,
+                              const ImageView* mask, const ImageView& dst,
+                              GradeStats& frame, std::vector<TileStats>* tiles = nullptr,
+                              int tileW = 0, int tileH = 64, const RowHints& hints = RowHints())
+{
+  checkViews(src, aov, mask, dst);
+  if (src.width <= 0 || src.height <= 0)
+  {
+    frame = GradeStats();
+    if (tiles)
+      tiles->clear();
+    return;
+  }
+
+  // One slot per tile, row by row, allocated before the tiles run : every
+  // tile writes its own, no locking and no allocation in the tiles
+  tileW = (tileW <= 0) ? src.width  : std::min(tileW, src.width);
+  tileH = (tileH <= 0) ? src.height : std::min(tileH, src.height);
+  const int tilesX = (src.width + tileW - 1) / tileW;
+  const int tilesY = (src.height + tileH - 1) / tileH;
+  std::vector<TileStats> slots(size_t(tilesX) * tilesY);
+
+  executor.forEachTile(src.width, src.height, tileW, tileH,
+    [&](const Tile& t, int)
+    {
+      GRADEAOV_NO_ALLOC();
+      const int w = t.x1 - t.x0;
+      const int h = t.y1 - t.y0;
+
+      TileStats& ts = slots[size_t(t.y0 / tileH) * tilesX + t.x0 / tileW];
+      ts.tile = t;
+      const auto start = std::chrono::steady_clock::now();
+      {
+        StatsScope scope(ts.stats);
+        const ImageView m = mask ? mask->crop(t.x0, t.y0, w, h) : ImageView();
+        processRows(op, src.crop(t.x0, t.y0, w, h), aov.crop(t.x0, t.y0, w, h),
+                    mask ? &m : nullptr, dst.crop(t.x0, t.y0, w, h), 0, h, hints);
+      }
+      ts.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    });
+
+  frame = GradeStats();
+  for (const TileStats& ts : slots)
+    frame.merge(ts.stats);
+  if (tiles)
+    tiles->swap(slots);
+}
+
+} // namespace GradeAOV
@@ -0,0 +1,727 @@
+// ============================================================================
+// GradeAOVGen — specialized GradeAOVOpt variants from one description
+// Blink cannot template on the boolean knobs, so GradeAOV.cpp tests
+// unpremult / reverse / clamps / view AOV / use mask on every pixel. This
+// tool holds the grade maths once, in the Blink dialect, and emits
+//   - BlinkScript kernels for chosen flag combinations, the bool knobs
+//     baked in and the dead branches stripped (GradeAOVOpt_<flags>.cpp)
+//   - the same bodies for all 64 combinations as C++ row functions over
+//     the GradeAOVBlink.h types, with a table indexed by the flags
+//     (GradeAOVVariants.h)
+// ============================================================================
+
+// USAGE :
+//   GradeAOVGen [-o dir] [--blink flags]... [--blink-all]
+//
+//   -o dir       : output directory (default .)
+//   --blink      : emit the Blink kernel of one combination, flags joined
+//                  by '+' among unpremult, reverse, blackclamp, whiteclamp,
+//                  viewaov, mask, or "plain" for none (repeatable, default
+//                  plain, unpremult, mask and unpremult+mask)
+//   --blink-all  : emit the Blink kernels of all 64 combinations
+//
+// MAJOR NOTES :
+// The description below is GradeAOV.cpp with its per-pixel bool tests
+// turned into @if / @elif / @else / @end lines, conditions being flags,
+// !flag, && and || (&& binds tighter). Everything else is kept word for
+// word, in the same order : a variant rounds exactly like the general
+// kernel for its flags, GradeAOVBlinkRun --variants checks every C++
+// variant against GradeAOVNative.h bit for bit.
+// GradeAOV.cpp stays the reference : a change to the grade goes there,
+// into GradeAOVNative.h and into the description here.
+// With the mask flag off a variant does not have the mask input (Blink
+// variants) or ignores it (C++), mAlpha is 1. variantFlags() gives the
+// combination of a GradeAOVOpt, mask off when there is no mask.
+//
+// BUILD :
+//   g++ -O2 -std=c++17 GradeAOVGen.cpp -o GradeAOVGen
+//   ./GradeAOVGen && ls GradeAOVVariants.h GradeAOVOpt_*.cpp
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+// -----------------------------
+// FLAGS
+// Bit i of a combination is kFlags[i].
+// -----------------------------
+struct Flag
+{
+  const char* knob; // name in the description
+  const char* name; // name in variant names and --blink
+};
+
+const Flag kFlags[] = {{"unpremult", "unpremult"},     {"reverse", "reverse"},
+                       {"black_clamp", "blackclamp"}, {"white_clamp", "whiteclamp"},
+                       {"viewaov", "viewaov"},         {"useMask", "mask"}};
+
+constexpr int kFlagCount = 6;
+constexpr int kCombinations = 1 << kFlagCount;
+
+std::string variantSuffix(int flags)
+{
+  std::string suffix;
+  for (int i = 0; i < kFlagCount; i++)
+    if (flags & (1 << i))
+      suffix += std::string(suffix.empty() ? "" : "_") + kFlags[i].name;
+  return suffix.empty() ? "plain" : suffix;
+}
+
+std::string variantName(int flags) { return "GradeAOVOpt_" + variantSuffix(flags); }
+
+// "unpremult+mask" -> bits
+int parseFlags(const std::string& text)
+{
+  if (text == "plain")
+    return 0;
+
+  int flags = 0;
+  size_t start = 0;
+  while (start <= text.size())
+  {
+    size_t end = text.find('+', start);
+    if (end == std::string::npos)
+      end = text.size();
+    const std::string word = text.substr(start, end - start);
+
+    int i = 0;
+    while (i < kFlagCount && word != kFlags[i].name)
+      i++;
+    if (i == kFlagCount)
+      throw std::runtime_error("unknown flag " + word);
+    flags |= 1 << i;
+    start = end + 1;
+  }
+  return flags;
+}
+
+// -----------------------------
+// THE GRADE, ONCE
+// Blink dialect. $SECTION$ alone on a line is replaced by that section,
+// indented like the placeholder.
+// -----------------------------
+
+// Gamma curves, GradeAOV.cpp forward_gamma() / reverse_gamma()
+const char* const kGamma = R"(@if !reverse
+// -----------------------------
+// FORWARD GAMMA FUNCTION
+// Applies gamma correction in forward mode (Nuke's piecewise behaviour)
+// -----------------------------
+float3 forward_gamma(float3 x, float3 G, float3 invG)
+{
+  float3 o;
+  for (int i = 0; i < 3; i++)
+  {
+    float xi = x[i];
+    float Gi = G[i];
+
+    // gamma <= 0 : black / unchanged / "infinite" white
+    if (Gi <= 0.0f)
+    {
+      o[i] = (xi < 0.0f) ? 0.0f
+           : ((xi > 1.0f) ? 1e30f : xi);
+    }
+    // gamma != 1 : negative unchanged, pow curve, linear tail
+    else if (Gi != 1.0f)
+    {
+      float ig = invG[i];
+      if (xi < 0.0f)
+      {
+        o[i] = xi;
+      }
+      else if (xi < 1.0f)
+      {
+        o[i] = pow(xi, ig);
+      }
+      else
+      {
+        o[i] = 1.0f + (xi - 1.0f) * ig;
+      }
+    }
+    // gamma == 1 : no change
+    else
+    {
+      o[i] = xi;
+    }
+  }
+  return o;
+}
+@else
+// -----------------------------
+// REVERSE GAMMA FUNCTION
+// Inverse of forward_gamma
+// -----------------------------
+float3 reverse_gamma(float3 x, float3 G)
+{
+  float3 o;
+  for (int i = 0; i < 3; i++)
+  {
+    float xi = x[i];
+    float Gi = G[i];
+
+    // gamma <= 0 : above 0 white, else black
+    if (Gi <= 0.0f)
+    {
+      o[i] = (xi > 0.0f) ? 1.0f : 0.0f;
+    }
+    // gamma != 1 : non positive unchanged, pow curve, linear tail
+    else if (Gi != 1.0f)
+    {
+      if (xi <= 0.0f)
+      {
+        o[i] = xi;
+      }
+      else if (xi < 1.0f)
+      {
+        o[i] = pow(xi, Gi);
+      }
+      else
+      {
+        o[i] = 1.0f + (xi - 1.0f) * Gi;
+      }
+    }
+    // gamma == 1 : no change
+    else
+    {
+      o[i] = xi;
+    }
+  }
+  return o;
+}
+@end
+)";
+
+// Body of process(), GradeAOV.cpp process()
+const char* const kProcess = R"(// Read beauty and AOV pixels
+float4 srcPx = src();
+float4 aovPx = aov();
+
+@if useMask
+// Mask alpha
+float mAlpha = mask().w;
+
+// Early-out if nothing will be applied
+if (mix <= 0.0f || mAlpha <= 0.0f)
+@else
+// Early-out if nothing will be applied
+if (mix <= 0.0f)
+@end
+{
+  // Output = unchanged AOV, alpha from src
+@if viewaov
+  float4 result = srcPx - srcPx + aovPx;
+@else
+  float4 result = srcPx - aovPx + aovPx;
+@end
+  result.w = srcPx.w;
+  dst() = result;
+  return;
+}
+
+// Pack A, B, gamma values into RGB-only vectors
+float3 A3    = float3(A.x, A.y, A.z);
+float3 B3    = float3(B.x, B.y, B.z);
+float3 G3    = float3(gamma.x, gamma.y, gamma.z);
+@if !reverse
+float3 invG3 = float3(invGamma.x, invGamma.y, invGamma.z);
+@end
+
+@if unpremult
+// Unpremult the AOV with a safe inverse alpha
+float invA = 1.0f / max(srcPx.w, 1e-8f);
+float4 linAov4 = aovPx * invA;
+float3 x = float3(linAov4.x, linAov4.y, linAov4.z);
+@else
+// RGB from premultiplied AOV
+float3 x = float3(aovPx.x, aovPx.y, aovPx.z);
+@end
+
+@if !reverse
+// Linear stage, clamps, forward gamma
+float3 lin = A3 * x + B3;
+@if black_clamp && white_clamp
+lin = clamp(lin, float3(0.0f), float3(1.0f));
+@elif black_clamp
+lin = max(lin, float3(0.0f));
+@elif white_clamp
+lin = min(lin, float3(1.0f));
+@end
+float3 y = forward_gamma(lin, G3, invG3);
+@else
+// Reverse gamma, safe inverse A per channel, reverse linear stage
+float3 rev = reverse_gamma(x, G3);
+float3 Ainv;
+for (int i = 0; i < 3; i++)
+{
+  float Ai = A3[i];
+  Ainv[i] = (fabs(Ai) > 1e-6f) ? (1.0f / Ai) : 1.0f;
+}
+float3 Brev = -B3 * Ainv;
+rev = rev * Ainv + Brev;
+@if black_clamp
+rev = max(rev, float3(0.0f));
+@elif white_clamp
+rev = min(rev, float3(1.0f));
+@end
+float3 y = rev;
+@end
+
+// Before and after grading, premultiplied
+@if unpremult
+float4 original_pm = float4(x, linAov4.w) * srcPx.w;
+float4 graded_pm   = float4(y, linAov4.w) * srcPx.w;
+@else
+float4 original_pm = aovPx;
+float4 graded_pm   = float4(y, aovPx.w);
+@end
+
+// Blend factor from mask alpha and mix knob
+@if useMask
+float t = min(1.0f, max(0.0f, mAlpha * mix));
+@else
+float t = min(1.0f, max(0.0f, mix));
+@end
+float4 masked_pm = (t >= 1.0f) ? graded_pm
+                               : _fc_lerp(original_pm, graded_pm, t);
+
+// Put the graded AOV back (or alone), alpha from src
+@if viewaov
+float4 result = srcPx - srcPx + masked_pm;
+@else
+float4 result = srcPx - aovPx + masked_pm;
+@end
+result.w = srcPx.w;
+dst() = result;
+)";
+
+// Blink kernel around the sections
+const char* const kBlinkKernel = R"(// ============================================================================
+// $NAME$ — BlinkScript GPU kernel, generated by GradeAOVGen, do not edit
+// GradeAOVOpt (GradeAOV.cpp) specialized for $FLAGS$,
+// the other bool knobs off. Same knobs otherwise.
+// ============================================================================
+
+kernel $NAME$ : ImageComputationKernel<ePixelWise>
+{
+  // Main beauty image input and the AOV to grade (premultiplied RGBA)
+  Image<eRead,  eAccessPoint, eEdgeClamped> src;
+  Image<eRead,  eAccessPoint, eEdgeClamped> aov;
+@if useMask
+
+  // Mask input, only its alpha channel is used
+  Image<eRead,  eAccessPoint, eEdgeClamped> mask;
+@end
+
+  // Output image
+  Image<eWrite> dst;
+
+  param:
+    float4 blackpoint;
+    float4 whitepoint;
+    float4 lift;
+    float4 gain;
+    float4 multiply;
+    float4 offset;
+    float4 gamma;
+    float mix;
+
+  local:
+    float4 A;
+    float4 B;
+    float4 invGamma;
+
+  void define()
+  {
+    defineParam(blackpoint, "blackpoint", float4(0.0f));
+    defineParam(whitepoint, "whitepoint", float4(1.0f));
+    defineParam(lift, "lift", float4(0.0f));
+    defineParam(gain, "gain", float4(1.0f));
+    defineParam(multiply, "multiply", float4(1.0f));
+    defineParam(offset, "offset", float4(0.0f));
+    defineParam(gamma, "gamma", float4(1.0f));
+    defineParam(mix, "mix", float(1.0f));
+  }
+
+  void init()
+  {
+    A = multiply * (gain - lift) / (whitepoint - blackpoint);
+    B = offset + lift - (A * blackpoint);
+    invGamma = float4(1.0f / gamma.x,
+                      1.0f / gamma.y,
+                      1.0f / gamma.z,
+                      1.0f / gamma.w);
+  }
+
+  $GAMMA$
+
+  void process()
+  {
+    $PROCESS$
+  }
+};
+)";
+
+// C++ struct of one variant, in GradeAOVVariants.h
+const char* const kCppVariant = R"(// $FLAGS$
+struct $NAME$ : VariantKnobs
+{
+  using VariantKnobs::VariantKnobs;
+
+  $GAMMA$
+
+  void process(const PixelIn& src, const PixelIn& aov, [[maybe_unused]] const PixelIn& mask,
+               const PixelOut& dst)
+  {
+    $PROCESS$
+  }
+};
+
+)";
+
+const char* const kCppHead = R"(// ============================================================================
+// GradeAOVVariants — GradeAOVOpt specialized for every bool knob combination
+// Generated by GradeAOVGen, do not edit.
+// ============================================================================
+
+// USAGE :
+//   const int flags = GradeAOV::Blink::Variants::variantFlags(op, mask != nullptr);
+//   GradeAOV::Blink::Variants::variantRow(flags)(op, src, aov, mask, dst, width);
+//
+// Same contract as GradeAOVOpt::processRow() (interleaved RGBA rows, dst
+// may be src), op after init(). The bool knobs of op are ignored : the
+// variant's own are baked in.
+
+#pragma once
+
+#include "GradeAOVBlink.h"
+#include "GradeAOVNative.h"
+
+namespace GradeAOV
+{
+namespace Blink
+{
+namespace Variants
+{
+
+// The native port, not a translated GradeAOV.cpp
+using NativeOpt = ::GradeAOV::GradeAOVOpt;
+
+// Knobs and locals of the kernel, from a native GradeAOVOpt after init()
+struct VariantKnobs
+{
+  float4 A, B, gamma, invGamma;
+  float mix;
+
+  explicit VariantKnobs(const NativeOpt& op)
+    : A(op.A[0], op.A[1], op.A[2], op.A[3]),
+      B(op.B[0], op.B[1], op.B[2], op.B[3]),
+      gamma(op.gamma[0], op.gamma[1], op.gamma[2], op.gamma[3]),
+      invGamma(op.invGamma[0], op.invGamma[1], op.invGamma[2], op.invGamma[3]),
+      mix(op.mix)
+  {
+  }
+};
+
+)";
+
+const char* const kCppTail = R"(
+using VariantRow = void (*)(const NativeOpt& op, const float* src, const float* aov,
+                            const float* mask, float* dst, int width);
+
+template <class V>
+inline void processRowVariant(const NativeOpt& op, const float* src, const float* aov,
+                              const float* mask, float* dst, int width)
+{
+  V v(op);
+  for (int x = 0; x < width; x++)
+    v.process(PixelIn(src + 4 * x), PixelIn(aov + 4 * x), PixelIn(mask ? mask + 4 * x : nullptr),
+              PixelOut(dst + 4 * x));
+}
+
+// Bits : $BITS$
+inline int variantFlags(const NativeOpt& op, bool maskGiven)
+{
+  return (op.unpremult ? 1 : 0) | (op.reverse ? 2 : 0) | (op.black_clamp ? 4 : 0) |
+         (op.white_clamp ? 8 : 0) | (op.viewaov ? 16 : 0) | ((op.useMask && maskGiven) ? 32 : 0);
+}
+
+constexpr int kVariantCount = $COUNT$;
+
+inline const char* variantName(int flags)
+{
+  static const char* const names[kVariantCount] = {
+$NAMES$
+  };
+  return names[flags];
+}
+
+inline VariantRow variantRow(int flags)
+{
+  static const VariantRow rows[kVariantCount] = {
+$ROWS$
+  };
+  return rows[flags];
+}
+
+} // namespace Variants
+} // namespace Blink
+} // namespace GradeAOV
+)";
+
+// -----------------------------
+// SPECIALIZE
+// -----------------------------
+bool flagValue(const std::string& word, int flags)
+{
+  for (int i = 0; i < kFlagCount; i++)
+    if (word == kFlags[i].knob)
+      return (flags & (1 << i)) != 0;
+  throw std::runtime_error("unknown flag in condition : " + word);
+}
+
+// a && !b || c
+bool evaluate(const std::string& condition, int flags)
+{
+  bool any = false;
+  size_t start = 0;
+  while (start <= condition.size())
+  {
+    size_t orAt = condition.find("||", start);
+    if (orAt == std::string::npos)
+      orAt = condition.size();
+
+    bool all = true;
+    size_t t = start;
+    while (t < orAt)
+    {
+      size_t andAt = condition.find("&&", t);
+      if (andAt == std::string::npos || andAt > orAt)
+        andAt = orAt;
+
+      std::string term = condition.substr(t, andAt - t);
+      term.erase(0, term.find_first_not_of(" \t"));
+      term.erase(term.find_last_not_of(" \t") + 1);
+      const bool negate = !term.empty() && term[0] == '!';
+      if (negate)
+        term.erase(0, term.find_first_not_of(" \t", 1));
+
+      all = all && (flagValue(term, flags) != negate);
+      t = andAt + 2;
+    }
+
+    any = any || all;
+    start = orAt + 2;
+  }
+  return any;
+}
+
+std::vector<std::string> splitLines(const std::string& text)
+{
+  std::vector<std::string> lines;
+  size_t start = 0;
+  while (start < text.size())
+  {
+    size_t end = text.find('\n', start);
+    if (end == std::string::npos)
+      end = text.size();
+    lines.push_back(text.substr(start, end - start));
+    start = end + 1;
+  }
+  return lines;
+}
+
+// Keeps the lines of text live for flags, drops the @ lines
+std::string specialize(const std::string& text, int flags)
+{
+  struct Level
+  {
+    bool outer; // the enclosing level is live
+    bool taken; // a branch of this @if was live
+    bool live;
+  };
+  std::vector<Level> stack;
+  auto live = [&] { return stack.empty() || stack.back().live; };
+
+  std::string out;
+  for (const std::string& line : splitLines(text))
+  {
+    const size_t first = line.find_first_not_of(" \t");
+    if (first != std::string::npos && line[first] == '@')
+    {
+      const std::string directive = line.substr(first);
+      if (directive.compare(0, 4, "@if ") == 0)
+      {
+        const bool outer = live();
+        const bool value = outer && evaluate(directive.substr(4), flags);
+        stack.push_back(Level{outer, value, value});
+      }
+      else if (directive.compare(0, 6, "@elif ") == 0 && !stack.empty())
+      {
+        Level& l = stack.back();
+        l.live = l.outer && !l.taken && evaluate(directive.substr(6), flags);
+        l.taken = l.taken || l.live;
+      }
+      else if (directive == "@else" && !stack.empty())
+      {
+        Level& l = stack.back();
+        l.live = l.outer && !l.taken;
+        l.taken = true;
+      }
+      else if (directive == "@end" && !stack.empty())
+        stack.pop_back();
+      else
+        throw std::runtime_error("bad directive : " + directive);
+      continue;
+    }
+
+    if (live())
+      out += line + "\n";
+  }
+
+  if (!stack.empty())
+    throw std::runtime_error("@if without @end");
+  return out;
+}
+
+// Replaces $KEY$ : alone on a line by the indented section, else inline
+std::string expand(const std::string& text, const std::map<std::string, std::string>& values)
+{
+  std::string out;
+  for (const std::string& line : splitLines(text))
+  {
+    const size_t first = line.find_first_not_of(" \t");
+    if (first != std::string::npos && line[first] == '$' && line.back() == '$')
+    {
+      const auto it = values.find(line.substr(first + 1, line.size() - first - 2));
+      if (it != values.end())
+      {
+        const std::string indent = line.substr(0, first);
+        for (const std::string& s : splitLines(it->second))
+          out += (s.empty() ? s : indent + s) + "\n";
+        continue;
+      }
+    }
+
+    std::string l = line;
+    for (const auto& kv : values)
+    {
+      const std::string key = "$" + kv.first + "$";
+      for (size_t at = l.find(key); at != std::string::npos; at = l.find(key, at + kv.second.size()))
+        l.replace(at, key.size(), kv.second);
+    }
+    out += l + "\n";
+  }
+  return out;
+}
+
+// Human list of the flags on
+std::string describe(int flags)
+{
+  std::string text;
+  for (int i = 0; i < kFlagCount; i++)
+    if (flags & (1 << i))
+      text += std::string(text.empty() ? "" : ", ") + kFlags[i].knob;
+  return text.empty() ? "every bool knob off" : text + " on";
+}
+
+std::string variantText(const char* shell, int flags)
+{
+  // Drops the trailing newline of a section
+  auto section = [&](const char* text)
+  {
+    std::string s = specialize(text, flags);
+    while (!s.empty() && s.back() == '\n')
+      s.pop_back();
+    return s;
+  };
+
+  return expand(specialize(shell, flags), {{"NAME", variantName(flags)},
+                                           {"FLAGS", describe(flags)},
+                                           {"GAMMA", section(kGamma)},
+                                           {"PROCESS", section(kProcess)}});
+}
+
+void writeFile(const std::string& path, const std::string& text)
+{
+  std::ofstream file(path, std::ios::binary);
+  if (!file || !(file << text))
+    throw std::runtime_error("cannot write " + path);
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+  std::string dir = ".";
+  std::vector<int> blink;
+  bool blinkAll = false;
+
+  try
+  {
+    for (int i = 1; i < argc; i++)
+    {
+      if (!std::strcmp(argv[i], "-o") && i + 1 < argc)
+        dir = argv[++i];
+      else if (!std::strcmp(argv[i], "--blink") && i + 1 < argc)
+        blink.push_back(parseFlags(argv[++i]));
+      else if (!std::strcmp(argv[i], "--blink-all"))
+        blinkAll = true;
+      else
+      {
+        std::fprintf(stderr, "usage: %s [-o dir] [--blink flags]... [--blink-all]\n", argv[0]);
+        return 2;
+      }
+    }
+
+    if (blinkAll)
+    {
+      blink.clear();
+      for (int flags = 0; flags < kCombinations; flags++)
+        blink.push_back(flags);
+    }
+    else if (blink.empty())
+      blink = {0, parseFlags("unpremult"), parseFlags("mask"), parseFlags("unpremult+mask")};
+
+    // C++ : every combination
+    std::string cpp = kCppHead;
+    std::string names, rows, bits;
+    for (int flags = 0; flags < kCombinations; flags++)
+    {
+      cpp += variantText(kCppVariant, flags);
+      names += "    \"" + variantName(flags) + "\",\n";
+      rows  += "    &processRowVariant<" + variantName(flags) + ">,\n";
+    }
+    for (int i = 0; i < kFlagCount; i++)
+      bits += std::string(i ? ", " : "") + std::to_string(1 << i) + " " + kFlags[i].knob;
+    names.erase(names.size() - 2);
+    rows.erase(rows.size() - 2);
+    cpp += expand(kCppTail, {{"BITS", bits},
+                             {"COUNT", std::to_string(kCombinations)},
+                             {"NAMES", names},
+                             {"ROWS", rows}});
+
+    writeFile(dir + "/GradeAOVVariants.h", cpp);
+    std::printf("%s/GradeAOVVariants.h : %d C++ variants\n", dir.c_str(), kCombinations);
+
+    // Blink : the chosen ones
+    for (int flags : blink)
+    {
+      const std::string path = dir + "/" + variantName(flags) + ".cpp";
+      writeFile(path, variantText(kBlinkKernel, flags));
+      std::printf("%s\n", path.c_str());
+    }
+  }
+  catch (const std::exception& e)
+  {
+    std::fprintf(stderr, "GradeAOVGen: %s\n", e.what());
+    return 1;
+  }
+  return 0;
+}
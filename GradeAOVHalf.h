@@ -0,0 +1,95 @@
+// ============================================================================
+// GradeAOVHalf — IEEE 754 half <-> float conversion for the native tools
+// Bit exact with OpenEXR's half (round to nearest even, denormals kept),
+// without pulling in Imath.
+// ============================================================================
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+namespace GradeAOV
+{
+
+// -----------------------------
+// HALF TO FLOAT
+// -----------------------------
+inline float halfToFloat(uint16_t h)
+{
+  const uint32_t sign = uint32_t(h & 0x8000) << 16;
+  uint32_t exp  = (h >> 10) & 0x1f;
+  uint32_t mant = h & 0x3ff;
+  uint32_t bits;
+
+  if (exp == 0x1f)
+    // Inf / NaN
+    bits = sign | 0x7f800000 | (mant << 13);
+  else if (exp != 0)
+    // Normal
+    bits = sign | ((exp + 112) << 23) | (mant << 13);
+  else if (mant == 0)
+    // Zero
+    bits = sign;
+  else
+  {
+    // Denormal, renormalise
+    exp = 113;
+    while (!(mant & 0x400))
+    {
+      mant <<= 1;
+      exp--;
+    }
+    bits = sign | (exp << 23) | ((mant & 0x3ff) << 13);
+  }
+
+  float f;
+  std::memcpy(&f, &bits, sizeof(f));
+  return f;
+}
+
+// -----------------------------
+// FLOAT TO HALF
+// Round to nearest even, overflow to infinity
+// -----------------------------
+inline uint16_t floatToHalf(float f)
+{
+  uint32_t bits;
+  std::memcpy(&bits, &f, sizeof(bits));
+
+  const uint16_t sign = uint16_t((bits >> 16) & 0x8000);
+  const uint32_t absBits = bits & 0x7fffffff;
+
+  // Inf / NaN (keep NaN quiet and non-zero)
+  if (absBits >= 0x7f800000)
+    return sign | 0x7c00 | (absBits > 0x7f800000 ? 0x200 | ((absBits >> 13) & 0x3ff) : 0);
+
+  // Too large : infinity
+  if (absBits >= 0x477ff000)
+    return sign | 0x7c00;
+
+  // Normal half
+  if (absBits >= 0x38800000)
+  {
+    uint32_t r = absBits - 0x38000000;
+    r += 0xfff + ((r >> 13) & 1);
+    return sign | uint16_t(r >> 13);
+  }
+
+  // Too small : zero
+  if (absBits < 0x33000000)
+    return sign;
+
+  // Denormal half
+  const uint32_t exp  = absBits >> 23;
+  const uint32_t mant = (absBits & 0x7fffff) | 0x800000;
+  const uint32_t shift = 126 - exp;
+  uint32_t r = mant >> shift;
+  const uint32_t rest = mant & ((1u << shift) - 1);
+  const uint32_t halfway = 1u << (shift - 1);
+  if (rest > halfway || (rest == halfway && (r & 1)))
+    r++;
+  return sign | uint16_t(r);
+}
+
+} // namespace GradeAOV
@@ -0,0 +1,277 @@
+// ============================================================================
+// GradeAOVHalide — Halide generator of the grade
+// The GradeAOVOpt maths as a Halide pipeline (beauty, aov and mask buffers,
+// every knob a param), compiled ahead of time into static libraries with a
+// hand-written or an autoscheduled schedule (see GradeAOVHalide.h for the
+// C++ side).
+// ============================================================================
+
+// USAGE :
+//   GradeAOVHalideGen -g gradeaov -f <name> -e static_library,h -o <dir>
+//                     target=<target> [interleaved=false]
+//                     [autoscheduler=Mullapudi2016 -p libautoschedule_mullapudi2016.so]
+//
+// MAJOR NOTES :
+// Same maths as GradeAOVNative.h, in the same order, written with select()
+// instead of branches : both sides of every data dependent branch are
+// computed, the pow() of the gamma curves included.
+// ACCURACY : Halide may simplify float maths (s - s + aov is folded to aov)
+// and LLVM may contract mul + add into FMA. For the native port's results
+// bit for bit, generate with the strict_float target feature.
+// LAYOUT : one generated function per row layout, picked with the
+// interleaved generator param. Buffers are x, y, c (c in 0..3) :
+//   interleaved=true  : channel stride 1, pixel stride 4 (Nuke rows)
+//   interleaved=false : pixel stride 1, any channel stride (EXR planes)
+// The mask is a 2D alpha buffer with any strides (the RGBA pipelines get
+// the alpha of an interleaved row, pixel stride 4). It is read under a
+// select(), but bounds inference still asks for it : pass any buffer of
+// the right size (the aov alpha) when there is no mask.
+// SCHEDULE : the hand-written one is serial, the caller's Executor owns the
+// threads (one call per band, like processRows()). Rows are vectorized
+// with GuardWithIf tails : ShiftInwards would grade the overlap twice when
+// the output is the beauty itself. The bool knobs that change the inner
+// loop most (reverse, unpremult) are specialized, the others stay selects.
+// Its intermediates are one vector of pixels, stored on the stack : no
+// halide_malloc per call (see GradeAOVHalide.h).
+// The autoscheduled one gets band-sized estimates, its parallel loops run
+// on Halide's thread pool (set it to 1 thread under an Executor).
+// FUSION : the output is one Func over the graded pixel, neighbouring ops
+// (colour transforms, mask combines) are fused by defining them on top of
+// composite / mAlpha and scheduling them in the same loop nest.
+//
+// BUILD :
+//   g++ -O2 -std=c++17 -fno-rtti GradeAOVHalide.cpp $HALIDE/share/Halide/tools/GenGen.cpp -I$HALIDE/include -L$HALIDE/lib -lHalide -ldl -lpthread -o GradeAOVHalideGen
+//   ./GradeAOVHalideGen -g gradeaov -f gradeaov_rgba -e static_library,h -o . target=host
+//   ./GradeAOVHalideGen -g gradeaov -f gradeaov_planar -e static_library,h -o . target=host-no_runtime interleaved=false
+//   ./GradeAOVHalideGen -g gradeaov -f gradeaov_rgba_auto -e static_library,h -o . target=host-no_runtime autoscheduler=Mullapudi2016 -p $HALIDE/lib/libautoschedule_mullapudi2016.so
+//   (Halide 15 or later, only the first library carries the Halide runtime,
+//   link all three)
+
+#include "Halide.h"
+
+namespace
+{
+
+using namespace Halide;
+
+// -----------------------------
+// FORWARD GAMMA FUNCTION
+// Nuke's piecewise behaviour, see GradeAOV.cpp
+// -----------------------------
+Expr forwardGamma(Expr x, Expr G, Expr invG)
+{
+  // gamma != 1 : negative unchanged, pow curve, linear tail
+  Expr curve = select(x < 0.0f, x,
+                      x < 1.0f, pow(x, invG),
+                      1.0f + (x - 1.0f) * invG);
+
+  // gamma <= 0 : black / unchanged / "infinite" white, gamma == 1 : no change
+  return select(G <= 0.0f, select(x < 0.0f, 0.0f, x > 1.0f, 1e30f, x),
+                G != 1.0f, curve,
+                x);
+}
+
+// -----------------------------
+// REVERSE GAMMA FUNCTION
+// Inverse of forwardGamma
+// -----------------------------
+Expr reverseGamma(Expr x, Expr G)
+{
+  // gamma != 1 : <= 0 unchanged, pow curve, linear tail
+  Expr curve = select(x <= 0.0f, x,
+                      x < 1.0f, pow(x, G),
+                      1.0f + (x - 1.0f) * G);
+
+  // gamma <= 0 : above 0 white, else black, gamma == 1 : no change
+  return select(G <= 0.0f, select(x > 0.0f, 1.0f, 0.0f),
+                G != 1.0f, curve,
+                x);
+}
+
+class GradeAOVGenerator : public Generator<GradeAOVGenerator>
+{
+public:
+  // Row layout of beauty, aov and output
+  GeneratorParam<bool> interleaved{"interleaved", true};
+
+  // -----------------------------
+  // INPUTS
+  // Knob names and defaults of GradeAOVOpt, RGB only
+  // -----------------------------
+  Input<Buffer<float, 3>> beauty{"beauty"};
+  Input<Buffer<float, 3>> aov{"aov"};
+  Input<Buffer<float, 2>> mask{"mask"};
+
+  Input<float[3]> blackpoint{"blackpoint", 0.0f};
+  Input<float[3]> whitepoint{"whitepoint", 1.0f};
+  Input<float[3]> lift{"lift", 0.0f};
+  Input<float[3]> gain{"gain", 1.0f};
+  Input<float[3]> multiply{"multiply", 1.0f};
+  Input<float[3]> offset{"offset", 0.0f};
+  Input<float[3]> gamma{"gamma", 1.0f};
+  Input<float> mix{"mix", 1.0f};
+
+  Input<bool> black_clamp{"black_clamp", false};
+  Input<bool> white_clamp{"white_clamp", false};
+  Input<bool> viewaov{"viewaov", false};
+  Input<bool> reverse{"reverse", false};
+  Input<bool> unpremult{"unpremult", false};
+  Input<bool> use_mask{"use_mask", false};
+
+  Output<Buffer<float, 3>> output{"output"};
+
+  void generate()
+  {
+    Expr s[4], a[4];
+    for (int i = 0; i < 4; i++)
+    {
+      s[i] = beauty(x, y, i);
+      a[i] = aov(x, y, i);
+    }
+
+    // Mask alpha (or 1.0 if no mask)
+    mAlpha(x, y) = select(use_mask, mask(x, y), 1.0f);
+    Expr m = mAlpha(x, y);
+
+    // Safe inverse alpha, unpremultiplied AOV
+    Expr invA = 1.0f / max(s[3], 1e-8f);
+    Expr u[3];
+    for (int i = 0; i < 3; i++)
+      u[i] = select(unpremult, a[i] * invA, a[i]);
+    Expr linW = a[3] * invA;
+
+    Expr original_pm[4], graded_pm[4];
+    for (int i = 0; i < 3; i++)
+    {
+      // init() : linear stage slope / offset, inverse gamma, reverse stage
+      Expr A    = multiply[i] * (gain[i] - lift[i]) / (whitepoint[i] - blackpoint[i]);
+      Expr B    = offset[i] + lift[i] - (A * blackpoint[i]);
+      Expr invG = 1.0f / gamma[i];
+      Expr Ainv = select(abs(A) > 1e-6f, 1.0f / A, 1.0f);
+      Expr Brev = -B * Ainv;
+
+      // Forward : linear stage, clamps, forward gamma
+      Expr lin = A * u[i] + B;
+      lin = select(black_clamp && white_clamp, min(max(lin, 0.0f), 1.0f),
+                   black_clamp, max(lin, 0.0f),
+                   white_clamp, min(lin, 1.0f),
+                   lin);
+      Expr fwd = forwardGamma(lin, gamma[i], invG);
+
+      // Reverse : reverse gamma, reverse linear stage, clamps (black clamp wins)
+      Expr rev = reverseGamma(u[i], gamma[i]) * Ainv + Brev;
+      rev = select(black_clamp, max(rev, 0.0f),
+                   white_clamp, min(rev, 1.0f),
+                   rev);
+
+      Expr y_i = select(reverse, rev, fwd);
+
+      // Premult before and after grading
+      original_pm[i] = select(unpremult, u[i] * s[3], a[i]);
+      graded_pm[i]   = select(unpremult, y_i * s[3], y_i);
+    }
+    original_pm[3] = graded_pm[3] = select(unpremult, linW * s[3], a[3]);
+
+    // Blend factor from mask alpha and mix knob, early-out keeps the AOV
+    Expr t = min(1.0f, max(0.0f, m * mix));
+    Expr early = mix <= 0.0f || m <= 0.0f;
+
+    // Put the graded AOV back (or alone), alpha from src
+    std::vector<Expr> out(4);
+    for (int i = 0; i < 3; i++)
+    {
+      Expr blended = select(t >= 1.0f, graded_pm[i],
+                            original_pm[i] + (graded_pm[i] - original_pm[i]) * t);
+      Expr g = select(early, a[i], blended);
+      out[i] = select(viewaov, s[i] - s[i] + g, s[i] - a[i] + g);
+    }
+    out[3] = s[3];
+
+    composite(x, y) = Tuple(out);
+    output(x, y, c) = mux(c, {composite(x, y)[0], composite(x, y)[1],
+                              composite(x, y)[2], composite(x, y)[3]});
+  }
+
+  void schedule()
+  {
+    // Buffer layouts, whichever schedule is used
+    auto layout = [&](auto& p)
+    {
+      p.dim(2).set_bounds(0, 4);
+      if (interleaved)
+      {
+        p.dim(0).set_stride(4);
+        p.dim(2).set_stride(1);
+      }
+      else
+        p.dim(0).set_stride(1);
+    };
+    layout(beauty);
+    layout(aov);
+    layout(output);
+
+    // Halide wants a pixel stride of 1 on inputs unless told otherwise, the
+    // mask is the alpha of an RGBA row as often as a plane
+    mask.dim(0).set_stride(Expr());
+
+    // One band of an 8K frame, what the Executor hands out
+    beauty.set_estimates({{0, 7680}, {0, 64}, {0, 4}});
+    aov.set_estimates({{0, 7680}, {0, 64}, {0, 4}});
+    mask.set_estimates({{0, 7680}, {0, 64}});
+    output.set_estimates({{0, 7680}, {0, 64}, {0, 4}});
+    blackpoint.set_estimate(0.0f);
+    whitepoint.set_estimate(1.0f);
+    lift.set_estimate(0.0f);
+    gain.set_estimate(1.2f);
+    multiply.set_estimate(1.0f);
+    offset.set_estimate(0.0f);
+    gamma.set_estimate(0.9f);
+    mix.set_estimate(1.0f);
+    black_clamp.set_estimate(false);
+    white_clamp.set_estimate(false);
+    viewaov.set_estimate(false);
+    reverse.set_estimate(false);
+    unpremult.set_estimate(true);
+    use_mask.set_estimate(true);
+
+    if (using_autoscheduler())
+      return;
+
+    // -----------------------------
+    // HAND-WRITTEN SCHEDULE
+    // Channels unrolled innermost (interleaved stores, or one vector per
+    // plane), pixels vectorized, the graded pixel computed once per vector
+    // -----------------------------
+    const int vec = natural_vector_size<float>();
+
+    output.bound(c, 0, 4)
+          .split(x, xo, xi, vec, TailStrategy::GuardWithIf)
+          .reorder(c, xi, xo, y)
+          .unroll(c)
+          .vectorize(xi);
+
+    // One vector of pixels per xo, the output's tail is guarded too
+    composite.compute_at(output, xo)
+             .store_in(MemoryType::Stack)
+             .vectorize(x, vec, TailStrategy::GuardWithIf);
+    mAlpha.compute_at(output, xo)
+          .store_in(MemoryType::Stack)
+          .vectorize(x, vec, TailStrategy::GuardWithIf);
+
+    // Loop nests without the forward / reverse and unpremult selects,
+    // inheriting the schedule above
+    for (Func f : {Func(output), composite})
+    {
+      f.specialize(reverse).specialize(unpremult);
+      f.specialize(unpremult);
+    }
+  }
+
+private:
+  Var x{"x"}, y{"y"}, c{"c"}, xo{"xo"}, xi{"xi"};
+  Func mAlpha{"mAlpha"}, composite{"composite"};
+};
+
+} // namespace
+
+HALIDE_REGISTER_GENERATOR(GradeAOVGenerator, gradeaov)
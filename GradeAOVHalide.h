@@ -0,0 +1,180 @@
+// ============================================================================
+// GradeAOVHalide — C++ side of the Halide grade (GradeAOVHalide.cpp)
+// Wraps ImageViews as Halide buffers and calls the ahead-of-time compiled
+// pipelines : hand-written schedule for RGBA and planar rows, autoscheduled
+// one for RGBA rows.
+// ============================================================================
+
+// USAGE :
+//   #define GRADEAOV_HALIDE (or -DGRADEAOV_HALIDE) and link the generated
+//   gradeaov_rgba.a, gradeaov_planar.a and gradeaov_rgba_auto.a
+//   GradeAOVOpt op; ... op.init();
+//   processRowsHalide(op, src, aov, &mask, dst, y0, y1);
+//
+// MAJOR NOTES :
+// Views become Halide buffers without copies (x, y, c, strides in floats).
+// Planar views need equally spaced planes, like one EXR frame buffer.
+// Layouts the pipelines were not generated for take GradeAOVOpt's loops.
+// The pipelines read the user knobs : A, B, ... are recomputed by Halide,
+// op only has to be init()ed for the native fallback.
+// Halide errors (a buffer failing the generator's constraints) throw
+// std::runtime_error.
+// ALLOCATIONS : the pipelines run inside GRADEAOV_NO_ALLOC. The hand
+// schedule keeps its intermediates on the stack and runs serially, nothing
+// reaches halide_malloc. The autoscheduled one may put intermediates on
+// the heap : with -DGRADEAOV_ALLOC_CHECK halide_malloc is routed through
+// the check (on every platform, not only where malloc is hooked), so such
+// a schedule aborts the debug build instead of passing unnoticed.
+// Without GRADEAOV_HALIDE this header is empty.
+//
+// BUILD :
+//   see GradeAOVHalide.cpp for the libraries, then
+//   g++ -O3 -march=native -std=c++17 -pthread -DGRADEAOV_HALIDE -I$HALIDE/include -I. GradeAOVBench.cpp gradeaov_rgba.a gradeaov_planar.a gradeaov_rgba_auto.a -ldl -o GradeAOVBench
+
+#pragma once
+
+#if defined(GRADEAOV_HALIDE)
+
+#include "GradeAOVAlloc.h"
+#include "GradeAOVImage.h"
+#include "GradeAOVNative.h"
+
+#include "HalideBuffer.h"
+
+// Written by GradeAOVHalideGen
+#include "gradeaov_planar.h"
+#include "gradeaov_rgba.h"
+#include "gradeaov_rgba_auto.h"
+
+#include <climits>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+
+namespace GradeAOV
+{
+
+#if defined(GRADEAOV_ALLOC_CHECK)
+// -----------------------------
+// CHECKED HALIDE ALLOCATOR
+// halide_malloc through checkAllocation(), then the runtime's own
+// -----------------------------
+inline halide_malloc_t& halideRuntimeMalloc()
+{
+  static halide_malloc_t runtimeMalloc = nullptr;
+  return runtimeMalloc;
+}
+
+inline void* halideCheckedMalloc(void* userContext, size_t bytes)
+{
+  checkAllocation(bytes, "halide_malloc");
+  return halideRuntimeMalloc()(userContext, bytes);
+}
+
+inline void installHalideAllocCheck()
+{
+  static const bool installed =
+    (halideRuntimeMalloc() = halide_set_custom_malloc(&halideCheckedMalloc), true);
+  (void)installed;
+}
+#else
+inline void installHalideAllocCheck() {}
+#endif
+
+// Which generated schedule grades RGBA rows
+enum class HalideSchedule
+{
+  kHand,
+  kAuto
+};
+
+// -----------------------------
+// VIEW AS A HALIDE BUFFER
+// Rows y0..y1-1 of v, false when the channels are not equally spaced
+// (or further apart than Halide's 32 bit strides)
+// -----------------------------
+inline bool halideBuffer(const ImageView& v, int y0, int y1,
+                         Halide::Runtime::Buffer<float, 3>& buf)
+{
+  for (int c = 0; c < 4; c++)
+    if (!v.chan[c])
+      return false;
+
+  const ptrdiff_t chanStride = v.chan[1] - v.chan[0];
+  if (v.chan[2] - v.chan[1] != chanStride || v.chan[3] - v.chan[2] != chanStride ||
+      chanStride > INT_MAX || chanStride < INT_MIN)
+    return false;
+
+  const ptrdiff_t fs = ptrdiff_t(sizeof(float));
+  halide_dimension_t shape[3] = {
+    {0, v.width, int(v.pixelStride / fs), 0},
+    {0, y1 - y0, int(v.rowStride / fs), 0},
+    {0, 4, int(chanStride), 0}};
+
+  buf = Halide::Runtime::Buffer<float, 3>(v.row(0, y0), 3, shape);
+  return true;
+}
+
+// -----------------------------
+// PROCESS ROWS y0..y1-1 OF A VIEW
+// processRows() with the Halide pipelines, mask may be null
+// -----------------------------
+inline void processRowsHalide(const GradeAOVOpt& op, const ImageView& src, const ImageView& aov,
+                              const ImageView* mask, const ImageView& dst, int y0, int y1,
+                              HalideSchedule schedule = HalideSchedule::kHand)
+{
+  const bool useMaskView = op.useMask && mask;
+
+  Halide::Runtime::Buffer<float, 3> s, a, d;
+  const bool wrapped = halideBuffer(src, y0, y1, s) && halideBuffer(aov, y0, y1, a) &&
+                       halideBuffer(dst, y0, y1, d);
+
+  // Pipeline generated for this layout
+  decltype(&gradeaov_rgba) pipeline = nullptr;
+  if (wrapped && src.isRGBA() && aov.isRGBA() && dst.isRGBA())
+    pipeline = (schedule == HalideSchedule::kAuto) ? &gradeaov_rgba_auto : &gradeaov_rgba;
+  else if (wrapped && src.isPlanar() && aov.isPlanar() && dst.isPlanar())
+    pipeline = &gradeaov_planar;
+
+  if (!pipeline)
+  {
+    processRows(op, src, aov, mask, dst, y0, y1);
+    return;
+  }
+
+  // Mask alpha, or any buffer of the right size when unused (see
+  // GradeAOVHalide.cpp), the aov alpha
+  const ImageView& m = useMaskView ? *mask : aov;
+  const ptrdiff_t fs = ptrdiff_t(sizeof(float));
+  halide_dimension_t maskShape[2] = {
+    {0, m.width, int(m.pixelStride / fs), 0},
+    {0, y1 - y0, int(m.rowStride / fs), 0}};
+  Halide::Runtime::Buffer<float, 2> mb(m.row(3, y0), 2, maskShape);
+
+  installHalideAllocCheck();
+
+  int err = 0;
+  {
+    // Debug builds (-DGRADEAOV_ALLOC_CHECK) abort on any allocation in the
+    // pipeline, the buffers above keep their dimensions inline
+    GRADEAOV_NO_ALLOC();
+
+    err = pipeline(s, a, mb,
+      op.blackpoint[0], op.blackpoint[1], op.blackpoint[2],
+      op.whitepoint[0], op.whitepoint[1], op.whitepoint[2],
+      op.lift[0],       op.lift[1],       op.lift[2],
+      op.gain[0],       op.gain[1],       op.gain[2],
+      op.multiply[0],   op.multiply[1],   op.multiply[2],
+      op.offset[0],     op.offset[1],     op.offset[2],
+      op.gamma[0],      op.gamma[1],      op.gamma[2],
+      op.mix, op.black_clamp, op.white_clamp, op.viewaov, op.reverse, op.unpremult,
+      useMaskView, d);
+  }
+
+  if (err)
+    throw std::runtime_error("GradeAOV: Halide pipeline failed, error " + std::to_string(err));
+}
+
+} // namespace GradeAOV
+
+#endif // GRADEAOV_HALIDE
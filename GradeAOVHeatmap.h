@@ -0,0 +1,233 @@
+// ============================================================================
+// GradeAOVHeatmap — per-tile grade cost maps
+// Accumulates the time spent grading each tile of a frame and writes it as
+// a colour PNG (at a glance), or as ns per pixel for an EXR next to the
+// output (to lay over the image in Nuke).
+// ============================================================================
+
+// MAJOR NOTES :
+// The frame is cut in a fixed grid of cellW x cellH cells, the grader's
+// tile size. add() credits a region to the cell holding its top left
+// corner : regions must not straddle cells (tiles, or pieces of tiles).
+// Costs are nanoseconds per pixel, so edge cells compare with full ones.
+// The PNG maps the cheapest cell to black and the dearest to white
+// (black, purple, red, orange, white), one PNG pixel per `scale` frame
+// pixels, and needs no library (stored, uncompressed deflate).
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace GradeAOV
+{
+
+class TileHeatmap
+{
+public:
+  TileHeatmap(int width, int height, int cellW, int cellH)
+    : _width(width), _height(height), _cellW(std::max(1, cellW)), _cellH(std::max(1, cellH)),
+      _cols((width + _cellW - 1) / _cellW), _rows((height + _cellH - 1) / _cellH),
+      _seconds(size_t(_cols) * _rows, 0.0), _pixels(size_t(_cols) * _rows, 0.0)
+  {
+  }
+
+  int width() const { return _width; }
+  int height() const { return _height; }
+  int cellW() const { return _cellW; }
+  int cellH() const { return _cellH; }
+  int cols() const { return _cols; }
+  int rows() const { return _rows; }
+
+  // Region (x, y, w, h) of the frame took seconds
+  void add(int x, int y, int w, int h, double seconds)
+  {
+    const size_t i = size_t(y / _cellH) * _cols + x / _cellW;
+    _seconds[i] += seconds;
+    _pixels[i]  += double(w) * h;
+  }
+
+  // Nanoseconds per pixel of a cell, 0 if nothing was graded there
+  double cost(int col, int row) const
+  {
+    const size_t i = size_t(row) * _cols + col;
+    return _pixels[i] > 0.0 ? 1e9 * _seconds[i] / _pixels[i] : 0.0;
+  }
+
+  // Cheapest and dearest graded cell
+  void range(double& lo, double& hi) const
+  {
+    lo = 1e30;
+    hi = 0.0;
+    for (int r = 0; r < _rows; r++)
+      for (int c = 0; c < _cols; c++)
+        if (_pixels[size_t(r) * _cols + c] > 0.0)
+        {
+          lo = std::min(lo, cost(c, r));
+          hi = std::max(hi, cost(c, r));
+        }
+    if (lo > hi)
+      lo = hi = 0.0;
+  }
+
+  // Cost of the cell under every frame pixel, rows of width floats
+  std::vector<float> frameImage() const
+  {
+    std::vector<float> image(size_t(_width) * _height);
+    for (int y = 0; y < _height; y++)
+      for (int x = 0; x < _width; x++)
+        image[size_t(y) * _width + x] = float(cost(x / _cellW, y / _cellH));
+    return image;
+  }
+
+  // -----------------------------
+  // WRITE A COLOUR PNG
+  // scale 0 picks one that keeps the longest side around 1024 pixels.
+  // Throws std::runtime_error.
+  // -----------------------------
+  void writePNG(const std::string& path, int scale = 0) const
+  {
+    if (scale <= 0)
+      scale = std::max(1, (std::max(_width, _height) + 1023) / 1024);
+    const int w = std::max(1, _width / scale), h = std::max(1, _height / scale);
+
+    double lo, hi;
+    range(lo, hi);
+
+    // Filter byte + RGB per row
+    std::vector<uint8_t> raw;
+    raw.reserve(size_t(3 * w + 1) * h);
+    for (int y = 0; y < h; y++)
+    {
+      raw.push_back(0);
+      for (int x = 0; x < w; x++)
+      {
+        const int fx = std::min(_width - 1, x * scale + scale / 2);
+        const int fy = std::min(_height - 1, y * scale + scale / 2);
+        const double c = cost(fx / _cellW, fy / _cellH);
+        uint8_t rgb[3];
+        ramp(hi > lo ? (c - lo) / (hi - lo) : 0.0, rgb);
+        raw.insert(raw.end(), rgb, rgb + 3);
+      }
+    }
+
+    std::FILE* f = std::fopen(path.c_str(), "wb");
+    if (!f)
+      throw std::runtime_error("cannot write " + path);
+
+    static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    std::fwrite(signature, 1, 8, f);
+
+    std::vector<uint8_t> ihdr;
+    put32(ihdr, uint32_t(w));
+    put32(ihdr, uint32_t(h));
+    // 8 bit RGB, deflate, no filter, no interlace
+    const uint8_t format[5] = {8, 2, 0, 0, 0};
+    ihdr.insert(ihdr.end(), format, format + 5);
+    chunk(f, "IHDR", ihdr);
+    chunk(f, "IDAT", zlibStored(raw));
+    chunk(f, "IEND", std::vector<uint8_t>());
+
+    const bool ok = !std::ferror(f);
+    if (std::fclose(f) != 0 || !ok)
+      throw std::runtime_error("cannot write " + path);
+  }
+
+private:
+  // 0..1 to black, purple, red, orange, white
+  static void ramp(double t, uint8_t rgb[3])
+  {
+    static const float stops[5][3] = {
+      {0.0f, 0.0f, 0.0f}, {0.35f, 0.05f, 0.55f}, {0.85f, 0.15f, 0.2f},
+      {1.0f, 0.6f, 0.0f}, {1.0f, 1.0f, 1.0f}};
+
+    t = std::min(1.0, std::max(0.0, t)) * 4.0;
+    const int i = std::min(3, int(t));
+    const float f = float(t - i);
+    for (int c = 0; c < 3; c++)
+      rgb[c] = uint8_t(255.0f * (stops[i][c] + (stops[i + 1][c] - stops[i][c]) * f) + 0.5f);
+  }
+
+  static void put32(std::vector<uint8_t>& v, uint32_t x)
+  {
+    for (int s = 24; s >= 0; s -= 8)
+      v.push_back(uint8_t(x >> s));
+  }
+
+  static uint32_t crc32(const uint8_t* p, size_t n, uint32_t crc)
+  {
+    static uint32_t table[256];
+    static const bool init = []
+    {
+      for (uint32_t i = 0; i < 256; i++)
+      {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++)
+          c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        table[i] = c;
+      }
+      return true;
+    }();
+    (void)init;
+
+    crc = ~crc;
+    for (size_t i = 0; i < n; i++)
+      crc = table[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+  }
+
+  static void chunk(std::FILE* f, const char type[4], const std::vector<uint8_t>& data)
+  {
+    std::vector<uint8_t> head;
+    put32(head, uint32_t(data.size()));
+    head.insert(head.end(), type, type + 4);
+    std::fwrite(head.data(), 1, head.size(), f);
+    if (!data.empty())
+      std::fwrite(data.data(), 1, data.size(), f);
+
+    uint32_t crc = crc32(reinterpret_cast<const uint8_t*>(type), 4, 0);
+    crc = crc32(data.data(), data.size(), crc);
+    std::vector<uint8_t> tail;
+    put32(tail, crc);
+    std::fwrite(tail.data(), 1, 4, f);
+  }
+
+  // zlib stream of stored (uncompressed) deflate blocks
+  static std::vector<uint8_t> zlibStored(const std::vector<uint8_t>& raw)
+  {
+    std::vector<uint8_t> z = {0x78, 0x01};
+    size_t pos = 0;
+    do
+    {
+      const size_t n = std::min<size_t>(65535, raw.size() - pos);
+      z.push_back(pos + n == raw.size() ? 1 : 0);
+      z.push_back(uint8_t(n));
+      z.push_back(uint8_t(n >> 8));
+      z.push_back(uint8_t(~n));
+      z.push_back(uint8_t(~n >> 8));
+      z.insert(z.end(), raw.begin() + pos, raw.begin() + pos + n);
+      pos += n;
+    } while (pos < raw.size());
+
+    uint32_t a = 1, b = 0;
+    for (uint8_t byte : raw)
+    {
+      a = (a + byte) % 65521;
+      b = (b + a) % 65521;
+    }
+    put32(z, (b << 16) | a);
+    return z;
+  }
+
+  int _width, _height;
+  int _cellW, _cellH;
+  int _cols, _rows;
+  std::vector<double> _seconds;
+  std::vector<double> _pixels;
+};
+
+} // namespace GradeAOV
@@ -0,0 +1,251 @@
+// ============================================================================
+// GradeAOVImage — caller-owned image views for the native GradeAOVOpt
+// Lets hosts (OIIO ImageBuf, NumPy arrays, Nuke rows, EXR planes) hand their
+// float pixels to the grade as they are, without copying into our layout.
+// ============================================================================
+
+// MAJOR NOTES :
+// Strides are in bytes and may be negative (bottom-up images).
+// Pixel strides must be a multiple of sizeof(float).
+// Interleaved RGBA and planar views take dedicated inner loops, anything
+// else (RGB + separate alpha, padded pixels, ...) the generic strided one.
+
+#pragma once
+
+#include "GradeAOVAlloc.h"
+#include "GradeAOVNative.h"
+
+#include <cstddef>
+#include <stdexcept>
+
+namespace GradeAOV
+{
+
+// -----------------------------
+// IMAGE VIEW
+// Pixel (x, y) of channel c lives at
+//   (char*)chan[c] + y * rowStride + x * pixelStride
+// A null channel reads as 0 (a missing alpha, like Nuke).
+// -----------------------------
+struct ImageView
+{
+  // R, G, B, A of pixel (0, 0)
+  float* chan[4] = {nullptr, nullptr, nullptr, nullptr};
+
+  int width  = 0;
+  int height = 0;
+
+  // Bytes between two pixels of a row / two rows
+  ptrdiff_t pixelStride = 0;
+  ptrdiff_t rowStride   = 0;
+
+  // Interleaved pixels, channels 0..n-1 used as R, G, B(, A).
+  // rowStride 0 means tightly packed rows.
+  static ImageView interleaved(float* data, int width, int height,
+                               int channels = 4, ptrdiff_t rowStride = 0)
+  {
+    ImageView v;
+    for (int c = 0; c < 4 && c < channels; c++)
+      v.chan[c] = data + c;
+    v.width       = width;
+    v.height      = height;
+    v.pixelStride = ptrdiff_t(sizeof(float)) * channels;
+    v.rowStride   = rowStride ? rowStride : v.pixelStride * width;
+    return v;
+  }
+
+  // One plane per channel, a may be null. rowStride 0 means packed rows.
+  static ImageView planar(float* r, float* g, float* b, float* a,
+                          int width, int height, ptrdiff_t rowStride = 0)
+  {
+    ImageView v;
+    v.chan[0] = r;
+    v.chan[1] = g;
+    v.chan[2] = b;
+    v.chan[3] = a;
+    v.width       = width;
+    v.height      = height;
+    v.pixelStride = ptrdiff_t(sizeof(float));
+    v.rowStride   = rowStride ? rowStride : ptrdiff_t(sizeof(float)) * width;
+    return v;
+  }
+
+  // Single channel image (a mask), read as alpha
+  static ImageView single(float* data, int width, int height,
+                          ptrdiff_t pixelStride = sizeof(float), ptrdiff_t rowStride = 0)
+  {
+    ImageView v;
+    v.chan[3]     = data;
+    v.width       = width;
+    v.height      = height;
+    v.pixelStride = pixelStride;
+    v.rowStride   = rowStride ? rowStride : pixelStride * width;
+    return v;
+  }
+
+  // Sub-image of w x h pixels starting at (x, y), same memory
+  ImageView crop(int x, int y, int w, int h) const
+  {
+    ImageView v = *this;
+    for (int c = 0; c < 4; c++)
+      if (chan[c])
+        v.chan[c] = reinterpret_cast<float*>(reinterpret_cast<char*>(chan[c])
+                                             + y * rowStride + x * pixelStride);
+    v.width  = w;
+    v.height = h;
+    return v;
+  }
+
+  // Channel c of row y, null if the channel is missing
+  float* row(int c, int y) const
+  {
+    return chan[c] ? reinterpret_cast<float*>(reinterpret_cast<char*>(chan[c]) + y * rowStride)
+                   : nullptr;
+  }
+
+  // Interleaved RGBA, channels in order at the start of each pixel
+  bool isRGBA() const
+  {
+    return pixelStride == ptrdiff_t(4 * sizeof(float)) && chan[0] &&
+           chan[1] == chan[0] + 1 && chan[2] == chan[0] + 2 && chan[3] == chan[0] + 3;
+  }
+
+  // Unit pixel stride, every channel present
+  bool isPlanar() const
+  {
+    return pixelStride == ptrdiff_t(sizeof(float)) &&
+           chan[0] && chan[1] && chan[2] && chan[3];
+  }
+};
+
+// -----------------------------
+// PROCESS ROWS y0..y1-1 OF A VIEW
+// mask may be null, only its alpha channel is read.
+// hints only apply to interleaved RGBA views.
+// -----------------------------
+inline void processRows(const GradeAOVOpt& op, const ImageView& src, const ImageView& aov,
+                        const ImageView* mask, const ImageView& dst, int y0, int y1,
+                        const RowHints& hints = RowHints())
+{
+  // Debug builds (-DGRADEAOV_ALLOC_CHECK) abort on any allocation in here
+  GRADEAOV_NO_ALLOC();
+
+  const bool hinted = hints.stream || hints.prefetchSrc || hints.prefetchAov ||
+                      hints.prefetchMask;
+
+  const bool useMaskView = op.useMask && mask;
+
+  // Pick the inner loop once for the whole range
+  enum { kStrided, kInterleaved, kPlanar } path = kStrided;
+
+  if (src.isRGBA() && aov.isRGBA() && dst.isRGBA() &&
+      (!useMaskView || mask->isRGBA()))
+    path = kInterleaved;
+  else if (src.isPlanar() && aov.isPlanar() && dst.isPlanar() &&
+           (!useMaskView || mask->pixelStride == ptrdiff_t(sizeof(float))))
+    path = kPlanar;
+
+  const ptrdiff_t fs = ptrdiff_t(sizeof(float));
+
+  for (int y = y0; y < y1; y++)
+  {
+    const float* m = useMaskView ? mask->row(3, y) : nullptr;
+
+#if defined(GRADEAOV_STATS)
+    // Stage cycles before the row : in place, the row overwrites src
+    {
+      const float* s[4] = {src.row(0, y), src.row(1, y), src.row(2, y), src.row(3, y)};
+      const float* a[4] = {aov.row(0, y), aov.row(1, y), aov.row(2, y), aov.row(3, y)};
+      op.statsStageCycles(s, src.pixelStride / fs, a, aov.pixelStride / fs,
+                          m, useMaskView ? mask->pixelStride / fs : 0, src.width);
+    }
+    const uint64_t rowStart = statsClock();
+#endif
+
+    switch (path)
+    {
+      case kInterleaved:
+        // Nuke row layout, processRow reads the mask alpha itself
+        if (hinted)
+          op.processRowHinted(src.row(0, y), aov.row(0, y),
+                              useMaskView ? mask->row(0, y) : nullptr,
+                              dst.row(0, y), src.width, hints);
+        else
+          op.processRow(src.row(0, y), aov.row(0, y), useMaskView ? mask->row(0, y) : nullptr,
+                        dst.row(0, y), src.width);
+        break;
+
+      case kPlanar:
+      {
+        const float* s[4] = {src.row(0, y), src.row(1, y), src.row(2, y), src.row(3, y)};
+        const float* a[4] = {aov.row(0, y), aov.row(1, y), aov.row(2, y), aov.row(3, y)};
+        float* const d[4] = {dst.row(0, y), dst.row(1, y), dst.row(2, y), dst.row(3, y)};
+        op.processRowPlanar(s, a, m, d, src.width);
+        break;
+      }
+
+      default:
+      {
+        const float* s[4] = {src.row(0, y), src.row(1, y), src.row(2, y), src.row(3, y)};
+        const float* a[4] = {aov.row(0, y), aov.row(1, y), aov.row(2, y), aov.row(3, y)};
+        float* const d[4] = {dst.row(0, y), dst.row(1, y), dst.row(2, y), dst.row(3, y)};
+        op.processRowStrided(s, src.pixelStride / fs, a, aov.pixelStride / fs,
+                             m, useMaskView ? mask->pixelStride / fs : 0,
+                             d, dst.pixelStride / fs, src.width);
+        break;
+      }
+    }
+
+#if defined(GRADEAOV_STATS)
+    if (GradeStats* stats = statsSink())
+      stats->cycles[GradeStats::kStageRow] += statsClock() - rowStart;
+#endif
+  }
+}
+
+// -----------------------------
+// CHECK VIEWS BEFORE PROCESSING
+// Every view must have the size of src, throws std::invalid_argument.
+// -----------------------------
+inline void checkViews(const ImageView& src, const ImageView& aov,
+                       const ImageView* mask, const ImageView& dst)
+{
+  auto sameSize = [&](const ImageView& v)
+  {
+    return v.width == src.width && v.height == src.height;
+  };
+
+  if (!sameSize(aov) || !sameSize(dst) || (mask && !sameSize(*mask)))
+    throw std::invalid_argument("GradeAOV: src, aov, mask and dst must have the same size");
+
+  if (src.pixelStride % ptrdiff_t(sizeof(float)) || aov.pixelStride % ptrdiff_t(sizeof(float)) ||
+      dst.pixelStride % ptrdiff_t(sizeof(float)) ||
+      (mask && mask->pixelStride % ptrdiff_t(sizeof(float))))
+    throw std::invalid_argument("GradeAOV: pixel strides must be a multiple of sizeof(float)");
+}
+
+// -----------------------------
+// PROCESS A WHOLE VIEW
+// Single threaded, see GradeAOVExecutor.h for the threaded version.
+// dst must either be src itself (in place, see processImageInPlace) or not
+// share memory with src, aov or mask.
+// -----------------------------
+inline void processImage(const GradeAOVOpt& op, const ImageView& src, const ImageView& aov,
+                         const ImageView* mask, const ImageView& dst)
+{
+  checkViews(src, aov, mask, dst);
+  processRows(op, src, aov, mask, dst, 0, src.height);
+}
+
+// -----------------------------
+// PROCESS A WHOLE VIEW IN PLACE
+// The result overwrites image (the beauty), no dst frame is needed.
+// Safe because each output pixel only depends on the same input pixel.
+// -----------------------------
+inline void processImageInPlace(const GradeAOVOpt& op, const ImageView& image,
+                                const ImageView& aov, const ImageView* mask)
+{
+  processImage(op, image, aov, mask, image);
+}
+
+} // namespace GradeAOV
@@ -0,0 +1,133 @@
+// ============================================================================
+// GradeAOVIspc — C++ side of the ISPC grade (GradeAOV.ispc)
+// Same entry points as GradeAOVImage.h, rows graded by the ISPC exports :
+// one pixel per SIMD lane, the widest target the CPU supports picked at
+// run time (SSE4, AVX2 or AVX-512).
+// ============================================================================
+
+// USAGE :
+//   #define GRADEAOV_ISPC (or -DGRADEAOV_ISPC) and link the ispc objects
+//   GradeAOVOpt op; ... op.init();
+//   processRowsIspc(op, src, aov, &mask, dst, y0, y1);
+//
+// MAJOR NOTES :
+// Interleaved RGBA and planar views go through gradeRowRGBA() /
+// gradeRowPlanar(), any other layout through GradeAOVOpt's strided loop.
+// Outputs match the native port except where ISPC's pow() rounds
+// differently from libm (a few ulps on the pow segments of the gamma
+// curves), see GradeAOV.ispc.
+// Without GRADEAOV_ISPC this header is empty.
+//
+// BUILD :
+//   ispc -O3 --pic --target=sse4-i32x4,avx2-i32x8,avx512skx-i32x16 GradeAOV.ispc -o GradeAOV_ispc.o -h GradeAOV_ispc.h
+//   g++ -O3 -march=native -std=c++17 -pthread -DGRADEAOV_ISPC GradeAOVBench.cpp GradeAOV_ispc*.o -o GradeAOVBench
+
+#pragma once
+
+#if defined(GRADEAOV_ISPC)
+
+#include "GradeAOVAlloc.h"
+#include "GradeAOVImage.h"
+#include "GradeAOVNative.h"
+
+// Written by ispc -h
+#include "GradeAOV_ispc.h"
+
+namespace GradeAOV
+{
+
+// -----------------------------
+// KNOBS FOR THE ISPC EXPORTS
+// op must have been init()ed
+// -----------------------------
+inline ispc::GradeKnobs ispcKnobs(const GradeAOVOpt& op)
+{
+  ispc::GradeKnobs k;
+  for (int i = 0; i < 3; i++)
+  {
+    k.A[i]        = op.A[i];
+    k.B[i]        = op.B[i];
+    k.gamma[i]    = op.gamma[i];
+    k.invGamma[i] = op.invGamma[i];
+    k.Ainv[i]     = op.Ainv[i];
+    k.Brev[i]     = op.Brev[i];
+  }
+  k.mix        = op.mix;
+  k.unpremult  = op.unpremult;
+  k.reverse    = op.reverse;
+  k.blackClamp = op.black_clamp;
+  k.whiteClamp = op.white_clamp;
+  k.viewaov    = op.viewaov;
+  k.useMask    = op.useMask;
+  return k;
+}
+
+// -----------------------------
+// PROCESS A ROW OF PLANAR PIXELS
+// GradeAOVOpt::processRowPlanar() through the ISPC export
+// -----------------------------
+inline void processRowPlanarIspc(const ispc::GradeKnobs& k, const float* const src[4],
+                                 const float* const aov[4], const float* mask,
+                                 float* const dst[4], int width,
+                                 float* const gradedAov[3] = nullptr)
+{
+  ispc::GradePlanes p;
+  for (int i = 0; i < 4; i++)
+  {
+    p.src[i] = src[i];
+    p.aov[i] = aov[i];
+    p.dst[i] = dst[i];
+  }
+  for (int i = 0; i < 3; i++)
+    p.graded[i] = gradedAov ? gradedAov[i] : nullptr;
+  p.mask = mask;
+
+  ispc::gradeRowPlanar(&k, &p, width);
+}
+
+// -----------------------------
+// PROCESS ROWS y0..y1-1 OF A VIEW
+// processRows() with the ISPC row kernels, mask may be null
+// -----------------------------
+inline void processRowsIspc(const GradeAOVOpt& op, const ImageView& src, const ImageView& aov,
+                            const ImageView* mask, const ImageView& dst, int y0, int y1)
+{
+  // Debug builds (-DGRADEAOV_ALLOC_CHECK) abort on any allocation in here
+  GRADEAOV_NO_ALLOC();
+
+  const ispc::GradeKnobs k = ispcKnobs(op);
+  const bool useMaskView = op.useMask && mask;
+
+  const bool interleaved = src.isRGBA() && aov.isRGBA() && dst.isRGBA() &&
+                           (!useMaskView || mask->isRGBA());
+  const bool planar = !interleaved && src.isPlanar() && aov.isPlanar() && dst.isPlanar() &&
+                      (!useMaskView || mask->pixelStride == ptrdiff_t(sizeof(float)));
+
+  // Anything else takes the native strided loop
+  if (!interleaved && !planar)
+  {
+    processRows(op, src, aov, mask, dst, y0, y1);
+    return;
+  }
+
+  for (int y = y0; y < y1; y++)
+  {
+    if (interleaved)
+    {
+      // The ISPC export takes non-const inputs (aos_to_soa4), it only reads them
+      ispc::gradeRowRGBA(&k, src.row(0, y), aov.row(0, y),
+                         useMaskView ? mask->row(0, y) : nullptr, dst.row(0, y), src.width);
+    }
+    else
+    {
+      const float* s[4] = {src.row(0, y), src.row(1, y), src.row(2, y), src.row(3, y)};
+      const float* a[4] = {aov.row(0, y), aov.row(1, y), aov.row(2, y), aov.row(3, y)};
+      float* const d[4] = {dst.row(0, y), dst.row(1, y), dst.row(2, y), dst.row(3, y)};
+      processRowPlanarIspc(k, s, a, useMaskView ? mask->row(3, y) : nullptr, d, src.width);
+    }
+  }
+}
+
+} // namespace GradeAOV
+
+#endif // GRADEAOV_ISPC
@@ -0,0 +1,340 @@
+// ============================================================================
+// GradeAOVJson — minimal JSON reader for the GradeAOV command line tools
+// Enough for recipes and profiles: objects, arrays, numbers, strings, bools.
+// ============================================================================
+
+// MAJOR NOTES :
+// \u escapes are decoded to UTF-8 (surrogate pairs included), numbers are
+// read as double.
+// Errors throw std::runtime_error with the byte offset.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace GradeAOV
+{
+
+struct Json
+{
+  enum Type { Null, Bool, Number, String, Array, Object };
+
+  Type type = Null;
+  bool b = false;
+  double n = 0.0;
+  std::string s;
+  std::vector<Json> a;
+  std::vector<std::pair<std::string, Json>> o;
+
+  // Member lookup, null if missing or not an object
+  const Json* find(const std::string& key) const
+  {
+    if (type != Object)
+      return nullptr;
+    for (const auto& kv : o)
+      if (kv.first == key)
+        return &kv.second;
+    return nullptr;
+  }
+};
+
+class JsonParser
+{
+public:
+  explicit JsonParser(std::string text)
+    : _text(std::move(text)),
+      _p(_text.c_str()), _begin(_text.c_str()), _end(_text.c_str() + _text.size())
+  {
+  }
+
+  Json parse()
+  {
+    Json v = value();
+    ws();
+    if (_p != _end)
+      fail("trailing characters");
+    return v;
+  }
+
+private:
+  std::string _text;
+  const char* _p;
+  const char* _begin;
+  const char* _end;
+
+  // 4 hex digits of a \u escape
+  unsigned hex4()
+  {
+    if (_end - _p < 4)
+      fail("bad \\u escape");
+    unsigned code = 0;
+    for (int i = 0; i < 4; i++, ++_p)
+    {
+      const char h = *_p;
+      code <<= 4;
+      if (h >= '0' && h <= '9')
+        code |= unsigned(h - '0');
+      else if (h >= 'a' && h <= 'f')
+        code |= unsigned(h - 'a' + 10);
+      else if (h >= 'A' && h <= 'F')
+        code |= unsigned(h - 'A' + 10);
+      else
+        fail("bad \\u escape");
+    }
+    return code;
+  }
+
+  // Code point of a \u escape (after the 'u') as UTF-8
+  void utf8(std::string& out)
+  {
+    unsigned code = hex4();
+    if (code >= 0xDC00 && code <= 0xDFFF)
+      fail("lone low surrogate in \\u escape");
+    if (code >= 0xD800 && code <= 0xDBFF)
+    {
+      if (_end - _p < 2 || _p[0] != '\\' || _p[1] != 'u')
+        fail("lone high surrogate in \\u escape");
+      _p += 2;
+      const unsigned low = hex4();
+      if (low < 0xDC00 || low > 0xDFFF)
+        fail("bad surrogate pair in \\u escape");
+      code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+    }
+
+    if (code < 0x80)
+      out += char(code);
+    else if (code < 0x800)
+    {
+      out += char(0xC0 | (code >> 6));
+      out += char(0x80 | (code & 0x3F));
+    }
+    else if (code < 0x10000)
+    {
+      out += char(0xE0 | (code >> 12));
+      out += char(0x80 | ((code >> 6) & 0x3F));
+      out += char(0x80 | (code & 0x3F));
+    }
+    else
+    {
+      out += char(0xF0 | (code >> 18));
+      out += char(0x80 | ((code >> 12) & 0x3F));
+      out += char(0x80 | ((code >> 6) & 0x3F));
+      out += char(0x80 | (code & 0x3F));
+    }
+  }
+
+  [[noreturn]] void fail(const char* what) const
+  {
+    std::ostringstream msg;
+    msg << "JSON: " << what << " at offset " << (_p - _begin);
+    throw std::runtime_error(msg.str());
+  }
+
+  void ws()
+  {
+    while (_p != _end && (*_p == ' ' || *_p == '\t' || *_p == '\n' || *_p == '\r'))
+      ++_p;
+  }
+
+  bool literal(const char* word)
+  {
+    const char* q = _p;
+    for (; *word; ++word, ++q)
+      if (q == _end || *q != *word)
+        return false;
+    _p = q;
+    return true;
+  }
+
+  Json value()
+  {
+    ws();
+    if (_p == _end)
+      fail("unexpected end");
+
+    Json v;
+    char c = *_p;
+
+    if (c == '{')
+    {
+      v.type = Json::Object;
+      ++_p;
+      ws();
+      if (_p != _end && *_p == '}')
+      {
+        ++_p;
+        return v;
+      }
+      for (;;)
+      {
+        ws();
+        if (_p == _end || *_p != '"')
+          fail("expected key");
+        std::string key = string();
+        ws();
+        if (_p == _end || *_p != ':')
+          fail("expected ':'");
+        ++_p;
+        v.o.emplace_back(std::move(key), value());
+        ws();
+        if (_p != _end && *_p == ',')
+        {
+          ++_p;
+          continue;
+        }
+        if (_p != _end && *_p == '}')
+        {
+          ++_p;
+          return v;
+        }
+        fail("expected ',' or '}'");
+      }
+    }
+
+    if (c == '[')
+    {
+      v.type = Json::Array;
+      ++_p;
+      ws();
+      if (_p != _end && *_p == ']')
+      {
+        ++_p;
+        return v;
+      }
+      for (;;)
+      {
+        v.a.push_back(value());
+        ws();
+        if (_p != _end && *_p == ',')
+        {
+          ++_p;
+          continue;
+        }
+        if (_p != _end && *_p == ']')
+        {
+          ++_p;
+          return v;
+        }
+        fail("expected ',' or ']'");
+      }
+    }
+
+    if (c == '"')
+    {
+      v.type = Json::String;
+      v.s = string();
+      return v;
+    }
+
+    if (literal("true"))
+    {
+      v.type = Json::Bool;
+      v.b = true;
+      return v;
+    }
+    if (literal("false"))
+    {
+      v.type = Json::Bool;
+      return v;
+    }
+    if (literal("null"))
+      return v;
+
+    // Number
+    char* stop = nullptr;
+    std::string num(_p, std::min<size_t>(64, _end - _p));
+    v.n = std::strtod(num.c_str(), &stop);
+    if (stop == num.c_str())
+      fail("unexpected character");
+    v.type = Json::Number;
+    _p += stop - num.c_str();
+    return v;
+  }
+
+  std::string string()
+  {
+    // Skip opening quote
+    ++_p;
+    std::string out;
+    while (_p != _end && *_p != '"')
+    {
+      char c = *_p++;
+      if (c != '\\')
+      {
+        out += c;
+        continue;
+      }
+      if (_p == _end)
+        break;
+      char e = *_p++;
+      switch (e)
+      {
+        case 'n': out += '\n'; break;
+        case 't': out += '\t'; break;
+        case 'r': out += '\r'; break;
+        case 'b': out += '\b'; break;
+        case 'f': out += '\f'; break;
+        case 'u': utf8(out); break;
+        default: out += e; break;
+      }
+    }
+    if (_p == _end)
+      fail("unterminated string");
+    ++_p;
+    return out;
+  }
+};
+
+// -----------------------------
+// HELPERS
+// -----------------------------
+
+inline Json parseJsonFile(const std::string& path)
+{
+  std::ifstream in(path, std::ios::binary);
+  if (!in)
+    throw std::runtime_error("cannot open " + path);
+  std::stringstream text;
+  text << in.rdbuf();
+  return JsonParser(text.str()).parse();
+}
+
+// Write a JSON string literal with escapes, every control character
+// escaped (UTF-8 passes through)
+inline std::string jsonQuote(const std::string& s)
+{
+  std::string out = "\"";
+  for (char c : s)
+  {
+    switch (c)
+    {
+      case '"':  out += "\\\""; break;
+      case '\\': out += "\\\\"; break;
+      case '\n': out += "\\n"; break;
+      case '\t': out += "\\t"; break;
+      case '\r': out += "\\r"; break;
+      case '\b': out += "\\b"; break;
+      case '\f': out += "\\f"; break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20)
+        {
+          char escape[8];
+          std::snprintf(escape, sizeof(escape), "\\u%04x", unsigned(static_cast<unsigned char>(c)));
+          out += escape;
+        }
+        else
+          out += c;
+    }
+  }
+  return out + "\"";
+}
+
+} // namespace GradeAOV
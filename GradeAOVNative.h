@@ -0,0 +1,712 @@
+// ============================================================================
+// GradeAOVNative — native C++ port of the GradeAOVOpt BlinkScript kernel
+// Same maths as GradeAOV.cpp, running on CPU image rows outside of Nuke,
+// used by the command line tools (GradeAOVRegrade, ...).
+// ============================================================================
+
+// MAJOR NOTES :
+// GradeAOV.cpp is the reference, keep this port in sync with it.
+// Pixels are RGBA float, premultiplied and interleaved (Nuke row layout).
+// Every row kernel reads a whole pixel before writing it, and a result
+// only depends on the same pixel of the inputs : dst may be src and
+// gradedAov may be aov (in-place grading).
+// Build with -DGRADEAOV_STATS to count the paths taken (GradeAOVStats.h).
+
+#pragma once
+
+#include "GradeAOVStats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define GRADEAOV_SSE 1
+#endif
+
+namespace GradeAOV
+{
+
+// -----------------------------
+// ROW MEMORY HINTS
+// At 8K the grade is memory bound (3 streams read, 1 written per pixel).
+// Distances are in pixels ahead of the current one, 0 = no prefetch.
+// -----------------------------
+struct RowHints
+{
+  // Non-temporal dst stores : skip the read-for-ownership and keep dst out
+  // of the caches. Only pays off when dst is not read again soon.
+  bool stream = false;
+
+  int prefetchSrc  = 0;
+  int prefetchAov  = 0;
+  int prefetchMask = 0;
+};
+
+// Prefetch the cache line holding p into all cache levels
+inline void prefetchLine(const void* p)
+{
+#if defined(GRADEAOV_SSE)
+  _mm_prefetch(static_cast<const char*>(p), _MM_HINT_T0);
+#elif defined(__GNUC__)
+  __builtin_prefetch(p, 0, 3);
+#else
+  (void)p;
+#endif
+}
+
+struct GradeAOVOpt
+{
+  // -----------------------------
+  // USER PARAMETERS (KNOBS)
+  // Defaults match define() in the Blink kernel
+  // -----------------------------
+
+  // Blackpoint for grading (RGBA)
+  float blackpoint[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+
+  // Whitepoint for grading (RGBA)
+  float whitepoint[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+
+  // Lift (RGBA)
+  float lift[4]       = {0.0f, 0.0f, 0.0f, 0.0f};
+
+  // Gain (RGBA)
+  float gain[4]       = {1.0f, 1.0f, 1.0f, 1.0f};
+
+  // Multiply (RGBA)
+  float multiply[4]   = {1.0f, 1.0f, 1.0f, 1.0f};
+
+  // Offset (RGBA)
+  float offset[4]     = {0.0f, 0.0f, 0.0f, 0.0f};
+
+  // Gamma (RGBA)
+  float gamma[4]      = {1.0f, 1.0f, 1.0f, 1.0f};
+
+  // Clamp toggles
+  bool black_clamp = false;
+  bool white_clamp = false;
+
+  // View the graded AOV alone
+  bool viewaov     = false;
+
+  // Reverse grading
+  bool reverse     = false;
+
+  // Enable unpremultiply before grading
+  bool unpremult   = false;
+
+  // Mix between original and graded result
+  float mix        = 1.0f;
+
+  // Whether to apply mask alpha
+  bool useMask     = false;
+
+  // -----------------------------
+  // LOCAL (CACHED) VARIABLES
+  // -----------------------------
+
+  // Precomputed slope / offset for linear stage
+  float A[4];
+  float B[4];
+
+  // Precomputed inverse gamma (1/gamma)
+  float invGamma[4];
+
+  // Precomputed safe 1/A and -B/A for the reverse linear stage
+  // (the Blink kernel computes these per pixel, results are identical)
+  float Ainv[3];
+  float Brev[3];
+
+  // -----------------------------
+  // SET A KNOB BY NAME
+  // Accepts the variable name or the Blink knob label ("black clamp").
+  // Colour knobs take 1 (all channels), 3 (RGB) or 4 (RGBA) values.
+  // Returns false for unknown knobs or a bad value count.
+  // -----------------------------
+  bool setParam(const std::string& name, const float* v, int n)
+  {
+    // Colour knobs
+    float* c = nullptr;
+    if      (name == "blackpoint") c = blackpoint;
+    else if (name == "whitepoint") c = whitepoint;
+    else if (name == "lift")       c = lift;
+    else if (name == "gain")       c = gain;
+    else if (name == "multiply")   c = multiply;
+    else if (name == "offset")     c = offset;
+    else if (name == "gamma")      c = gamma;
+
+    if (c)
+    {
+      if (n == 1)
+        c[0] = c[1] = c[2] = c[3] = v[0];
+      else if (n == 3 || n == 4)
+        for (int i = 0; i < n; i++)
+          c[i] = v[i];
+      else
+        return false;
+      return true;
+    }
+
+    // Scalar knobs
+    if (n != 1)
+      return false;
+
+    if (name == "mix")
+    {
+      mix = v[0];
+      return true;
+    }
+
+    // Boolean knobs
+    bool* b = nullptr;
+    if      (name == "black_clamp" || name == "black clamp") b = &black_clamp;
+    else if (name == "white_clamp" || name == "white clamp") b = &white_clamp;
+    else if (name == "viewaov"     || name == "view AOV")    b = &viewaov;
+    else if (name == "reverse")                              b = &reverse;
+    else if (name == "unpremult"   || name == "(un)premult") b = &unpremult;
+    else if (name == "useMask"     || name == "use mask")    b = &useMask;
+
+    if (!b)
+      return false;
+
+    *b = (v[0] != 0.0f);
+    return true;
+  }
+
+  // -----------------------------
+  // INITIALISATION
+  // Call after changing any knob
+  // -----------------------------
+  void init()
+  {
+    for (int i = 0; i < 4; i++)
+    {
+      // Slope for linear stage: multiply*(gain-lift)/(whitepoint-blackpoint)
+      A[i] = multiply[i] * (gain[i] - lift[i]) / (whitepoint[i] - blackpoint[i]);
+
+      // Offset for linear stage: offset + lift - A*blackpoint
+      B[i] = offset[i] + lift[i] - (A[i] * blackpoint[i]);
+
+      // 1/gamma
+      invGamma[i] = 1.0f / gamma[i];
+    }
+
+    for (int i = 0; i < 3; i++)
+    {
+      Ainv[i] = (std::fabs(A[i]) > 1e-6f) ? (1.0f / A[i]) : 1.0f;
+      Brev[i] = -B[i] * Ainv[i];
+    }
+  }
+
+  // -----------------------------
+  // FORWARD GAMMA FUNCTION
+  // Nuke's piecewise behaviour, see GradeAOV.cpp
+  // -----------------------------
+  void forward_gamma(const float x[3], float o[3]) const
+  {
+    for (int i = 0; i < 3; i++)
+    {
+      float xi = x[i];
+      float Gi = gamma[i];
+
+      // gamma <= 0 : black / unchanged / "infinite" white
+      if (Gi <= 0.0f)
+      {
+        GRADEAOV_COUNT(kFwdGammaZero);
+        o[i] = (xi < 0.0f) ? 0.0f : ((xi > 1.0f) ? 1e30f : xi);
+      }
+      // gamma != 1 : negative unchanged, pow curve, linear tail
+      else if (Gi != 1.0f)
+      {
+        float ig = invGamma[i];
+        if (xi < 0.0f)
+        {
+          GRADEAOV_COUNT(kFwdNegative);
+          o[i] = xi;
+        }
+        else if (xi < 1.0f)
+        {
+          GRADEAOV_COUNT(kFwdPow);
+          o[i] = std::pow(xi, ig);
+        }
+        else
+        {
+          GRADEAOV_COUNT(kFwdLinear);
+          o[i] = 1.0f + (xi - 1.0f) * ig;
+        }
+      }
+      // gamma == 1 : no change
+      else
+      {
+        GRADEAOV_COUNT(kFwdIdentity);
+        o[i] = xi;
+      }
+    }
+  }
+
+  // -----------------------------
+  // REVERSE GAMMA FUNCTION
+  // Inverse of forward_gamma
+  // -----------------------------
+  void reverse_gamma(const float x[3], float o[3]) const
+  {
+    for (int i = 0; i < 3; i++)
+    {
+      float xi = x[i];
+      float Gi = gamma[i];
+
+      // gamma <= 0 : above 0 white, else black
+      if (Gi <= 0.0f)
+      {
+        GRADEAOV_COUNT(kRevGammaZero);
+        o[i] = (xi > 0.0f) ? 1.0f : 0.0f;
+      }
+      // gamma != 1 : <= 0 unchanged, pow curve, linear tail
+      else if (Gi != 1.0f)
+      {
+        if (xi <= 0.0f)
+        {
+          GRADEAOV_COUNT(kRevNegative);
+          o[i] = xi;
+        }
+        else if (xi < 1.0f)
+        {
+          GRADEAOV_COUNT(kRevPow);
+          o[i] = std::pow(xi, Gi);
+        }
+        else
+        {
+          GRADEAOV_COUNT(kRevLinear);
+          o[i] = 1.0f + (xi - 1.0f) * Gi;
+        }
+      }
+      // gamma == 1 : no change
+      else
+      {
+        GRADEAOV_COUNT(kRevIdentity);
+        o[i] = xi;
+      }
+    }
+  }
+
+  // -----------------------------
+  // LINEAR STAGE FUNCTION
+  // Slope / offset then the clamps, on RGB
+  // -----------------------------
+  void linear_stage(const float x[3], float o[3]) const
+  {
+    for (int i = 0; i < 3; i++)
+      o[i] = A[i] * x[i] + B[i];
+
+    // Clamp if enabled
+    if (white_clamp || black_clamp)
+    {
+      for (int i = 0; i < 3; i++)
+      {
+        const float before = o[i];
+        if (!white_clamp)
+          o[i] = std::max(o[i], 0.0f);
+        else if (!black_clamp)
+          o[i] = std::min(o[i], 1.0f);
+        else
+          o[i] = std::min(std::max(o[i], 0.0f), 1.0f);
+
+        if (o[i] > before)
+          GRADEAOV_COUNT(kClampBlack);
+        else if (o[i] < before)
+          GRADEAOV_COUNT(kClampWhite);
+      }
+    }
+  }
+
+  // -----------------------------
+  // REVERSE LINEAR STAGE FUNCTION
+  // Inverse of linear_stage, then the clamps (black clamp wins, as in the
+  // Blink kernel)
+  // -----------------------------
+  void reverse_linear_stage(const float x[3], float o[3]) const
+  {
+    for (int i = 0; i < 3; i++)
+      o[i] = x[i] * Ainv[i] + Brev[i];
+
+    if (white_clamp || black_clamp)
+    {
+      for (int i = 0; i < 3; i++)
+      {
+        const float before = o[i];
+        if (black_clamp)
+          o[i] = std::max(o[i], 0.0f);
+        else if (white_clamp)
+          o[i] = std::min(o[i], 1.0f);
+
+        if (o[i] > before)
+          GRADEAOV_COUNT(kClampBlack);
+        else if (o[i] < before)
+          GRADEAOV_COUNT(kClampWhite);
+      }
+    }
+  }
+
+  // -----------------------------
+  // GRADE RGB
+  // Linear stage + clamp + gamma (or the reverse), on RGB only
+  // -----------------------------
+  void grade_rgb(const float x[3], float y[3]) const
+  {
+    // Forward grading : linear stage, then forward gamma
+    if (!reverse)
+    {
+      GRADEAOV_COUNT(kForward);
+
+      float lin[3];
+      linear_stage(x, lin);
+      forward_gamma(lin, y);
+    }
+    // Reverse grading : reverse gamma, then reverse linear stage
+    else
+    {
+      GRADEAOV_COUNT(kReverse);
+
+      float rev[3];
+      reverse_gamma(x, rev);
+      reverse_linear_stage(rev, y);
+    }
+  }
+
+  // -----------------------------
+  // GRADE ONE AOV PIXEL
+  // Writes the masked, premultiplied graded AOV (masked_pm in the kernel).
+  // Returns false when the early-out kept the AOV unchanged.
+  // -----------------------------
+  bool grade(const float srcPx[4], const float aovPx[4], float mAlpha,
+             float out[4]) const
+  {
+    GRADEAOV_COUNT(kPixels);
+    GRADEAOV_COUNT_N(kDenormalIn, statsDenormals(aovPx, 3));
+
+    // Early-out if nothing will be applied
+    if (mix <= 0.0f || mAlpha <= 0.0f)
+    {
+      if (mix <= 0.0f)
+        GRADEAOV_COUNT(kEarlyOutMix);
+      else
+        GRADEAOV_COUNT(kEarlyOutMask);
+
+      for (int i = 0; i < 4; i++)
+        out[i] = aovPx[i];
+      return false;
+    }
+
+    // Premultiplied before/after grading values
+    float original_pm[4];
+    float graded_pm[4];
+
+    if (unpremult)
+    {
+      GRADEAOV_COUNT(kUnpremult);
+
+      // Safe inverse alpha
+      float invA = 1.0f / std::max(srcPx[3], 1e-8f);
+
+      // Unpremult the AOV
+      float x[3] = {aovPx[0] * invA, aovPx[1] * invA, aovPx[2] * invA};
+      float linW = aovPx[3] * invA;
+
+      float y[3];
+      grade_rgb(x, y);
+
+      // Premult before and after grading
+      for (int i = 0; i < 3; i++)
+      {
+        original_pm[i] = x[i] * srcPx[3];
+        graded_pm[i]   = y[i] * srcPx[3];
+      }
+      original_pm[3] = graded_pm[3] = linW * srcPx[3];
+    }
+    else
+    {
+      float y[3];
+      grade_rgb(aovPx, y);
+
+      for (int i = 0; i < 4; i++)
+        original_pm[i] = aovPx[i];
+      for (int i = 0; i < 3; i++)
+        graded_pm[i] = y[i];
+      graded_pm[3] = aovPx[3];
+    }
+
+    // Blend factor from mask alpha and mix knob
+    float t = std::min(1.0f, std::max(0.0f, mAlpha * mix));
+    if (t < 1.0f)
+      GRADEAOV_COUNT(kPartialBlend);
+
+    // Fully graded, or blend between original and graded
+    for (int i = 0; i < 4; i++)
+      out[i] = (t >= 1.0f) ? graded_pm[i]
+                           : original_pm[i] + (graded_pm[i] - original_pm[i]) * t;
+    return true;
+  }
+
+  // -----------------------------
+  // PUT THE GRADED AOV BACK INTO THE BEAUTY
+  // -----------------------------
+  void composite(const float srcPx[4], const float aovPx[4],
+                 const float gradedPx[4], float dstPx[4]) const
+  {
+    // Keep alpha from src
+    float a = srcPx[3];
+
+    // viewaov replaces src with the graded AOV, else swaps the old AOV out
+    for (int i = 0; i < 3; i++)
+      dstPx[i] = viewaov ? (srcPx[i] - srcPx[i] + gradedPx[i])
+                         : (srcPx[i] - aovPx[i] + gradedPx[i]);
+    dstPx[3] = a;
+  }
+
+  // -----------------------------
+  // PROCESS PER PIXEL
+  // mAlpha is the mask alpha, ignored when useMask is off
+  // -----------------------------
+  void process(const float srcPx[4], const float aovPx[4], float mAlpha,
+               float dstPx[4]) const
+  {
+    float graded[4];
+    grade(srcPx, aovPx, useMask ? mAlpha : 1.0f, graded);
+    composite(srcPx, aovPx, graded, dstPx);
+  }
+
+  // -----------------------------
+  // PROCESS A ROW OF RGBA PIXELS
+  // mask is RGBA too (only alpha is read), may be null when unused.
+  // gradedAov optionally receives the graded AOV pixels.
+  // dst may be src, gradedAov may be aov.
+  // -----------------------------
+  void processRow(const float* src, const float* aov, const float* mask,
+                  float* dst, int width, float* gradedAov = nullptr) const
+  {
+    for (int x = 0; x < width; x++)
+    {
+      const float* s = src + 4 * x;
+      const float* a = aov + 4 * x;
+
+      // Mask alpha (or 1.0 if no mask)
+      float mAlpha = (useMask && mask) ? mask[4 * x + 3] : 1.0f;
+
+      float graded[4];
+      grade(s, a, mAlpha, graded);
+      composite(s, a, graded, dst + 4 * x);
+
+      if (gradedAov)
+        for (int i = 0; i < 4; i++)
+          gradedAov[4 * x + i] = graded[i];
+    }
+  }
+
+  // -----------------------------
+  // PROCESS A ROW OF RGBA PIXELS WITH MEMORY HINTS
+  // Same result as processRow(). Prefetches are issued once per 64 byte
+  // line (4 pixels). Streaming stores need a 16 byte aligned dst and SSE,
+  // otherwise plain stores are used.
+  // -----------------------------
+  void processRowHinted(const float* src, const float* aov, const float* mask,
+                        float* dst, int width, const RowHints& hints) const
+  {
+    const bool useMaskRow = useMask && mask;
+
+#if defined(GRADEAOV_SSE)
+    const bool stream = hints.stream && (reinterpret_cast<uintptr_t>(dst) & 15) == 0;
+#else
+    const bool stream = false;
+#endif
+
+    for (int x = 0; x < width; x++)
+    {
+      const float* s = src + 4 * x;
+      const float* a = aov + 4 * x;
+
+      if ((x & 3) == 0)
+      {
+        if (hints.prefetchSrc && x + hints.prefetchSrc < width)
+          prefetchLine(s + 4 * hints.prefetchSrc);
+        if (hints.prefetchAov && x + hints.prefetchAov < width)
+          prefetchLine(a + 4 * hints.prefetchAov);
+        if (useMaskRow && hints.prefetchMask && x + hints.prefetchMask < width)
+          prefetchLine(mask + 4 * (x + hints.prefetchMask));
+      }
+
+      // Mask alpha (or 1.0 if no mask)
+      float mAlpha = useMaskRow ? mask[4 * x + 3] : 1.0f;
+
+      float graded[4], out[4];
+      grade(s, a, mAlpha, graded);
+      composite(s, a, graded, out);
+
+#if defined(GRADEAOV_SSE)
+      if (stream)
+      {
+        _mm_stream_ps(dst + 4 * x, _mm_loadu_ps(out));
+        continue;
+      }
+#endif
+      for (int i = 0; i < 4; i++)
+        dst[4 * x + i] = out[i];
+    }
+
+#if defined(GRADEAOV_SSE)
+    // Streaming stores are weakly ordered, publish them before returning
+    if (stream)
+      _mm_sfence();
+#endif
+  }
+
+  // -----------------------------
+  // PROCESS A ROW OF PLANAR PIXELS
+  // One pointer per channel (R, G, B, A), as EXRChannelReader hands them out.
+  // mask is a single plane, may be null when unused.
+  // gradedAov optionally receives the graded AOV RGB planes.
+  // dst may be src, gradedAov may be aov.
+  // -----------------------------
+  void processRowPlanar(const float* const src[4], const float* const aov[4],
+                        const float* mask, float* const dst[4], int width,
+                        float* const gradedAov[3] = nullptr) const
+  {
+    for (int x = 0; x < width; x++)
+    {
+      float s[4] = {src[0][x], src[1][x], src[2][x], src[3][x]};
+      float a[4] = {aov[0][x], aov[1][x], aov[2][x], aov[3][x]};
+
+      // Mask alpha (or 1.0 if no mask)
+      float mAlpha = (useMask && mask) ? mask[x] : 1.0f;
+
+      float graded[4], out[4];
+      grade(s, a, mAlpha, graded);
+      composite(s, a, graded, out);
+
+      for (int i = 0; i < 4; i++)
+        dst[i][x] = out[i];
+
+      if (gradedAov)
+        for (int i = 0; i < 3; i++)
+          gradedAov[i][x] = graded[i];
+    }
+  }
+
+  // -----------------------------
+  // PROCESS A ROW OF STRIDED PIXELS
+  // Any layout : one pointer per channel, strides in floats between pixels.
+  // A null src / aov channel reads as 0, mask points at the mask channel.
+  // dst may be src.
+  // -----------------------------
+  void processRowStrided(const float* const src[4], ptrdiff_t srcStride,
+                         const float* const aov[4], ptrdiff_t aovStride,
+                         const float* mask, ptrdiff_t maskStride,
+                         float* const dst[4], ptrdiff_t dstStride, int width) const
+  {
+    for (int x = 0; x < width; x++)
+    {
+      float s[4], a[4];
+      for (int i = 0; i < 4; i++)
+      {
+        s[i] = src[i] ? src[i][x * srcStride] : 0.0f;
+        a[i] = aov[i] ? aov[i][x * aovStride] : 0.0f;
+      }
+
+      // Mask alpha (or 1.0 if no mask)
+      float mAlpha = (useMask && mask) ? mask[x * maskStride] : 1.0f;
+
+      float graded[4], out[4];
+      grade(s, a, mAlpha, graded);
+      composite(s, a, graded, out);
+
+      for (int i = 0; i < 4; i++)
+        if (dst[i])
+          dst[i][x * dstStride] = out[i];
+    }
+  }
+
+#if defined(GRADEAOV_STATS)
+  // -----------------------------
+  // STAGE CYCLES OF A ROW (GRADEAOV_STATS builds)
+  // Times each stage alone over the row's pixels, 64 at a time : a grade()
+  // pass, a composite() pass, then the linear and gamma passes over the
+  // pixels grade() does not early-out, in grade_rgb()'s order. Nothing is
+  // written, the path counters are left alone. Same arguments as
+  // processRowStrided().
+  // -----------------------------
+  void statsStageCycles(const float* const src[4], ptrdiff_t srcStride,
+                        const float* const aov[4], ptrdiff_t aovStride,
+                        const float* mask, ptrdiff_t maskStride, int width) const
+  {
+    GradeStats* stats = statsSink();
+    if (!stats)
+      return;
+    statsSink() = nullptr;
+
+    const int kChunk = 64;
+    float s[kChunk][4], a[kChunk][4], mAlpha[kChunk];
+    float graded[kChunk][4], out[kChunk][4];
+    float x[kChunk][3], mid[kChunk][3], y[kChunk][3];
+    float keep = 0.0f;
+
+    for (int x0 = 0; x0 < width; x0 += kChunk)
+    {
+      const int n = std::min(kChunk, width - x0);
+      for (int p = 0; p < n; p++)
+      {
+        for (int i = 0; i < 4; i++)
+        {
+          s[p][i] = src[i] ? src[i][(x0 + p) * srcStride] : 0.0f;
+          a[p][i] = aov[i] ? aov[i][(x0 + p) * aovStride] : 0.0f;
+        }
+        mAlpha[p] = (useMask && mask) ? mask[(x0 + p) * maskStride] : 1.0f;
+      }
+
+      uint64_t t0 = statsClock();
+      for (int p = 0; p < n; p++)
+        grade(s[p], a[p], mAlpha[p], graded[p]);
+      uint64_t t1 = statsClock();
+      for (int p = 0; p < n; p++)
+        composite(s[p], a[p], graded[p], out[p]);
+      uint64_t t2 = statsClock();
+      stats->cycles[GradeStats::kStageGrade]     += t1 - t0;
+      stats->cycles[GradeStats::kStageComposite] += t2 - t1;
+
+      // grade_rgb()'s input of the graded pixels
+      int g = 0;
+      for (int p = 0; p < n; p++)
+        if (mix > 0.0f && mAlpha[p] > 0.0f)
+        {
+          const float invA = unpremult ? 1.0f / std::max(s[p][3], 1e-8f) : 1.0f;
+          for (int i = 0; i < 3; i++)
+            x[g][i] = unpremult ? a[p][i] * invA : a[p][i];
+          g++;
+        }
+
+      t0 = statsClock();
+      for (int p = 0; p < g; p++)
+        reverse ? reverse_gamma(x[p], mid[p]) : linear_stage(x[p], mid[p]);
+      t1 = statsClock();
+      for (int p = 0; p < g; p++)
+        reverse ? reverse_linear_stage(mid[p], y[p]) : forward_gamma(mid[p], y[p]);
+      t2 = statsClock();
+      stats->cycles[reverse ? GradeStats::kStageGamma : GradeStats::kStageLinear] += t1 - t0;
+      stats->cycles[reverse ? GradeStats::kStageLinear : GradeStats::kStageGamma] += t2 - t1;
+
+      // Every result is used : no pass is optimized away
+      for (int p = 0; p < n; p++)
+        keep += out[p][0] + out[p][1] + out[p][2];
+      for (int p = 0; p < g; p++)
+        keep += y[p][0] + y[p][1] + y[p][2];
+    }
+
+    statsKept() = keep;
+    statsSink() = stats;
+  }
+#endif
+};
+
+} // namespace GradeAOV
@@ -0,0 +1,151 @@
+// ============================================================================
+// GradeAOVNuma — NUMA topology and thread pinning for the native executor
+// Finds which CPUs belong to which memory node and pins threads to a node,
+// so the pages a thread first touches stay local to it.
+// ============================================================================
+
+// MAJOR NOTES :
+// Linux only (sysfs + pthread affinity), elsewhere the machine is reported
+// as a single node and pinning does nothing.
+// Only CPUs this process may run on are kept (taskset, cgroups), nodes
+// left without a CPU are dropped.
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <fstream>
+#endif
+
+namespace GradeAOV
+{
+
+struct NumaTopology
+{
+  // CPUs of each node, in node order
+  std::vector<std::vector<int>> nodeCpus;
+
+  int nodes() const { return int(nodeCpus.size()); }
+
+  // -----------------------------
+  // DETECT
+  // Never fails : falls back to one node holding every allowed CPU.
+  // -----------------------------
+  static NumaTopology detect()
+  {
+    NumaTopology topo;
+
+#if defined(__linux__)
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+      return topo;
+
+    for (int node = 0; ; node++)
+    {
+      std::ifstream in("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+      if (!in)
+        break;
+
+      std::string list;
+      std::getline(in, list);
+
+      std::vector<int> cpus;
+      for (int cpu : parseCpuList(list))
+        if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed))
+          cpus.push_back(cpu);
+
+      if (!cpus.empty())
+        topo.nodeCpus.push_back(cpus);
+    }
+
+    // No sysfs node information (containers, old kernels) : one node
+    if (topo.nodeCpus.empty())
+    {
+      std::vector<int> cpus;
+      for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+        if (CPU_ISSET(cpu, &allowed))
+          cpus.push_back(cpu);
+      topo.nodeCpus.push_back(cpus);
+    }
+#else
+    topo.nodeCpus.push_back({});
+#endif
+
+    return topo;
+  }
+
+  // "0-3,8,10-11" -> 0 1 2 3 8 10 11
+  static std::vector<int> parseCpuList(const std::string& list)
+  {
+    std::vector<int> cpus;
+    size_t i = 0;
+    while (i < list.size())
+    {
+      size_t end = list.find(',', i);
+      if (end == std::string::npos)
+        end = list.size();
+
+      const std::string range = list.substr(i, end - i);
+      const size_t dash = range.find('-');
+      try
+      {
+        const int first = std::stoi(range.substr(0, dash));
+        const int last  = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+        for (int cpu = first; cpu <= last; cpu++)
+          cpus.push_back(cpu);
+      }
+      catch (...)
+      {
+        // Blank or malformed entry, skip it
+      }
+
+      i = end + 1;
+    }
+    return cpus;
+  }
+};
+
+// -----------------------------
+// THREAD PINNING
+// -----------------------------
+
+// CPUs the calling thread may currently run on (empty if unknown)
+inline std::vector<int> currentAffinity()
+{
+  std::vector<int> cpus;
+#if defined(__linux__)
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (pthread_getaffinity_np(pthread_self(), sizeof(set), &set) == 0)
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+      if (CPU_ISSET(cpu, &set))
+        cpus.push_back(cpu);
+#endif
+  return cpus;
+}
+
+// Restrict the calling thread to cpus, returns false if it could not be done
+inline bool pinCurrentThread(const std::vector<int>& cpus)
+{
+#if defined(__linux__)
+  if (cpus.empty())
+    return false;
+
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (int cpu : cpus)
+    if (cpu >= 0 && cpu < CPU_SETSIZE)
+      CPU_SET(cpu, &set);
+  return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+  (void)cpus;
+  return false;
+#endif
+}
+
+} // namespace GradeAOV
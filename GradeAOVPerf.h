@@ -0,0 +1,159 @@
+// ============================================================================
+// GradeAOVPerf — Linux hardware performance counters for the benchmarks
+// Cycles, instructions, last level cache misses and branch misses of the
+// calling thread, read as one perf_event group.
+// ============================================================================
+
+// MAJOR NOTES :
+// perf_event counters follow a thread, so every thread that runs tiles
+// opens its own PerfCounters (on itself) and the harness sums them. Any
+// thread may read an open group.
+// User space only (exclude_kernel), which works with perf_event_paranoid
+// up to 2. In containers or VMs without a PMU open() fails and says why;
+// callers then report without counters.
+// When the PMU is shared the kernel multiplexes the group, values are
+// scaled by time enabled / time running.
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+namespace GradeAOV
+{
+
+struct PerfSample
+{
+  uint64_t cycles = 0;
+  uint64_t instructions = 0;
+  uint64_t llcMisses = 0;
+  uint64_t branchMisses = 0;
+
+  PerfSample& operator+=(const PerfSample& o)
+  {
+    cycles += o.cycles;
+    instructions += o.instructions;
+    llcMisses += o.llcMisses;
+    branchMisses += o.branchMisses;
+    return *this;
+  }
+
+  PerfSample operator-(const PerfSample& o) const
+  {
+    PerfSample d;
+    d.cycles       = cycles - o.cycles;
+    d.instructions = instructions - o.instructions;
+    d.llcMisses    = llcMisses - o.llcMisses;
+    d.branchMisses = branchMisses - o.branchMisses;
+    return d;
+  }
+
+  double ipc() const { return cycles ? double(instructions) / cycles : 0.0; }
+};
+
+class PerfCounters
+{
+public:
+  PerfCounters() = default;
+  ~PerfCounters() { close(); }
+
+  PerfCounters(const PerfCounters&) = delete;
+  PerfCounters& operator=(const PerfCounters&) = delete;
+
+  // -----------------------------
+  // OPEN ON THE CALLING THREAD
+  // Returns false (see error()) when counters are not available.
+  // -----------------------------
+  bool open()
+  {
+    close();
+
+#if defined(__linux__)
+    const uint64_t configs[kEvents] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                       PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+
+    for (int i = 0; i < kEvents; i++)
+    {
+      perf_event_attr attr;
+      std::memset(&attr, 0, sizeof(attr));
+      attr.size           = sizeof(attr);
+      attr.type           = PERF_TYPE_HARDWARE;
+      attr.config         = configs[i];
+      attr.exclude_kernel = 1;
+      attr.exclude_hv     = 1;
+      attr.read_format    = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                            PERF_FORMAT_TOTAL_TIME_RUNNING;
+      // The leader starts the whole group
+      attr.disabled       = (i == 0);
+
+      _fd[i] = int(syscall(SYS_perf_event_open, &attr, 0, -1, i ? _fd[0] : -1, 0));
+      if (_fd[i] < 0)
+      {
+        _error = std::string("perf_event_open: ") + std::strerror(errno);
+        close();
+        return false;
+      }
+    }
+
+    ioctl(_fd[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(_fd[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    return true;
+#else
+    _error = "hardware counters need Linux perf_event";
+    return false;
+#endif
+  }
+
+  bool isOpen() const { return _fd[0] >= 0; }
+  const std::string& error() const { return _error; }
+
+  // Counts since open(), zeros if not open
+  PerfSample read() const
+  {
+    PerfSample s;
+#if defined(__linux__)
+    if (!isOpen())
+      return s;
+
+    // nr, time enabled, time running, then one value per event
+    uint64_t data[3 + kEvents] = {};
+    if (::read(_fd[0], data, sizeof(data)) != ssize_t(sizeof(data)) || data[0] != kEvents)
+      return s;
+
+    const double scale = (data[2] && data[2] < data[1]) ? double(data[1]) / data[2] : 1.0;
+    s.cycles       = uint64_t(data[3] * scale);
+    s.instructions = uint64_t(data[4] * scale);
+    s.llcMisses    = uint64_t(data[5] * scale);
+    s.branchMisses = uint64_t(data[6] * scale);
+#endif
+    return s;
+  }
+
+  void close()
+  {
+#if defined(__linux__)
+    for (int i = kEvents - 1; i >= 0; i--)
+      if (_fd[i] >= 0)
+        ::close(_fd[i]);
+#endif
+    for (int& fd : _fd)
+      fd = -1;
+  }
+
+private:
+  static constexpr int kEvents = 4;
+
+  int _fd[kEvents] = {-1, -1, -1, -1};
+  std::string _error;
+};
+
+} // namespace GradeAOV
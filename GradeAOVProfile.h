@@ -0,0 +1,209 @@
+// ============================================================================
+// GradeAOVProfile — per-machine tuning profile for the native grade
+// Thread count, tile shape and row kernel variant picked by
+// GradeAOVBench --tune, saved per host and loaded by the engine at startup.
+// ============================================================================
+
+// MAJOR NOTES :
+// The profile lives in $GRADEAOV_PROFILE if set, else in
+// ~/.gradeaov/<hostname>.json. A missing profile means the built-in
+// defaults, a malformed one throws std::runtime_error from loadProfile().
+// Engines load it with loadHostProfileOrDefaults() : a broken or stale
+// tuning file costs speed, not the ability to grade.
+//
+// PROFILE :
+//   {
+//     "host": "farm-a12", "threads": 32, "numa": true,
+//     "tile_width": 0, "tile_height": 64,
+//     "stream": true, "prefetch": 64,
+//     "frame": [7680, 4320], "ms": 41.7
+//   }
+//
+//   tile_width 0 means full-width bands. prefetch is the prefetch
+//   distance in pixels for src, aov and mask (0 = off).
+
+#pragma once
+
+#include "GradeAOVJson.h"
+#include "GradeAOVNative.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace GradeAOV
+{
+
+struct TuneProfile
+{
+  std::string host;
+
+  // Executor settings (threads 0 = one per hardware thread)
+  int threads = 0;
+  bool numa = false;
+  int tileW = 0;
+  int tileH = 64;
+
+  // Row kernel variant
+  RowHints hints;
+
+  // Frame it was tuned on and its best time, for reference only
+  int frameW = 0, frameH = 0;
+  double ms = 0.0;
+
+  // True when read from a file
+  bool loaded = false;
+};
+
+// This machine's host name, "localhost" if unknown
+inline std::string hostName()
+{
+#if defined(__unix__) || defined(__APPLE__)
+  char name[256] = {};
+  if (gethostname(name, sizeof(name) - 1) == 0 && name[0])
+    return name;
+#endif
+  return "localhost";
+}
+
+// Where this host's profile is read from and written to
+inline std::string hostProfilePath()
+{
+  if (const char* path = std::getenv("GRADEAOV_PROFILE"))
+    if (*path)
+      return path;
+
+  const char* home = std::getenv("HOME");
+  return std::string(home ? home : ".") + "/.gradeaov/" + hostName() + ".json";
+}
+
+// -----------------------------
+// LOAD
+// -----------------------------
+inline TuneProfile loadProfile(const std::string& path)
+{
+  TuneProfile p;
+
+  if (!std::ifstream(path))
+    return p;
+
+  Json j;
+  try
+  {
+    j = parseJsonFile(path);
+  }
+  catch (const std::runtime_error& e)
+  {
+    throw std::runtime_error(path + ": " + e.what());
+  }
+  if (j.type != Json::Object)
+    throw std::runtime_error(path + ": profile must be a JSON object");
+
+  auto number = [&](const char* key, double fallback)
+  {
+    const Json* v = j.find(key);
+    if (!v)
+      return fallback;
+    if (v->type != Json::Number)
+      throw std::runtime_error(path + ": '" + key + "' must be a number");
+    return v->n;
+  };
+  auto flag = [&](const char* key, bool fallback)
+  {
+    const Json* v = j.find(key);
+    if (!v)
+      return fallback;
+    if (v->type != Json::Bool)
+      throw std::runtime_error(path + ": '" + key + "' must be true or false");
+    return v->b;
+  };
+
+  if (const Json* host = j.find("host"))
+    p.host = host->s;
+
+  p.threads = std::max(0, int(number("threads", p.threads)));
+  p.numa    = flag("numa", p.numa);
+  p.tileW   = std::max(0, int(number("tile_width", p.tileW)));
+  p.tileH   = std::max(0, int(number("tile_height", p.tileH)));
+
+  p.hints.stream = flag("stream", false);
+  p.hints.prefetchSrc = p.hints.prefetchAov = p.hints.prefetchMask =
+    std::max(0, int(number("prefetch", 0)));
+
+  if (const Json* frame = j.find("frame"))
+    if (frame->type == Json::Array && frame->a.size() == 2)
+    {
+      p.frameW = int(frame->a[0].n);
+      p.frameH = int(frame->a[1].n);
+    }
+  p.ms = number("ms", 0.0);
+
+  p.loaded = true;
+  return p;
+}
+
+// This host's profile, defaults if it was never tuned
+inline TuneProfile loadHostProfile()
+{
+  return loadProfile(hostProfilePath());
+}
+
+// Same, but the defaults when the profile cannot be read, *error says why
+// (empty when loaded or missing)
+inline TuneProfile loadHostProfileOrDefaults(std::string* error)
+{
+  error->clear();
+  try
+  {
+    return loadHostProfile();
+  }
+  catch (const std::exception& e)
+  {
+    *error = e.what();
+    return TuneProfile();
+  }
+}
+
+// -----------------------------
+// SAVE
+// Creates the profile directory if needed, throws std::runtime_error.
+// -----------------------------
+inline void saveProfile(const TuneProfile& p, const std::string& path)
+{
+#if defined(__unix__) || defined(__APPLE__)
+  const size_t slash = path.rfind('/');
+  if (slash != std::string::npos && slash > 0)
+    mkdir(path.substr(0, slash).c_str(), 0755);
+#endif
+
+  std::ofstream out(path);
+  if (!out)
+    throw std::runtime_error("cannot write " + path);
+
+  char numbers[64];
+  std::snprintf(numbers, sizeof(numbers), "%.3f", p.ms);
+
+  out << "{\n"
+      << "  \"host\": " << jsonQuote(p.host) << ",\n"
+      << "  \"threads\": " << p.threads << ",\n"
+      << "  \"numa\": " << (p.numa ? "true" : "false") << ",\n"
+      << "  \"tile_width\": " << p.tileW << ",\n"
+      << "  \"tile_height\": " << p.tileH << ",\n"
+      << "  \"stream\": " << (p.hints.stream ? "true" : "false") << ",\n"
+      << "  \"prefetch\": " << p.hints.prefetchSrc << ",\n"
+      << "  \"frame\": [" << p.frameW << ", " << p.frameH << "],\n"
+      << "  \"ms\": " << numbers << "\n"
+      << "}\n";
+
+  if (!out)
+    throw std::runtime_error("cannot write " + path);
+}
+
+} // namespace GradeAOV
@@ -0,0 +1,408 @@
+// ============================================================================
+// GradeAOVPy — Python bindings for the native GradeAOVOpt (pybind11)
+// Grades NumPy arrays where they are (buffer protocol, no copy), with the
+// GIL released while the thread pool runs.
+// ============================================================================
+
+// USAGE :
+//   import gradeaov
+//   out = gradeaov.grade(beauty, aov, mask=None, out=None, threads=None,
+//                        gain=(1.2, 1.1, 1.0), gamma=0.9, unpremult=True)
+//
+//   beauty, aov : (H, W, C) arrays, C >= 3, a missing alpha reads as 0
+//   mask        : (H, W) or (H, W, C) array, its last channel is used,
+//                 passing a mask turns "use mask" on
+//   out         : optional preallocated (H, W, C) array written in place,
+//                 else a new (H, W, 4) array is returned. out=beauty grades
+//                 in place, saving a whole frame of memory
+//   threads     : worker threads, 0 = one per hardware thread
+//   tile_rows   : rows per tile (full-width bands)
+//                 threads / tile_rows None : this host's tuned profile
+//                 (GradeAOVProfile.h, read at import), tile shape and
+//                 row kernel variant come from it too. An unreadable
+//                 profile is a RuntimeWarning at import, the defaults
+//                 are used
+//   Knobs are keyword arguments, by name (black_clamp) or knob label
+//   (**{"black clamp": True}).
+//
+//   Every array has the same dtype. float32 arrays are graded in their own
+//   memory, any strides (views, slices, channel-last or transposed planes).
+//   float16 arrays are converted to float tile by tile, never as a whole.
+//
+//   gradeaov.start_trace()
+//   ...                                   # grade() calls are recorded
+//   gradeaov.stop_trace("grade.json")     # Chrome trace, ui.perfetto.dev
+//
+//   GradeAOVPyCheck.py checks all of the above against GradeAOVOpt.
+//
+// BUILD :
+//   c++ -O3 -std=c++17 -shared -fPIC -pthread GradeAOVPy.cpp
+//       $(python3 -m pybind11 --includes)
+//       -o gradeaov$(python3-config --extension-suffix)
+
+#include "GradeAOVExecutor.h"
+#include "GradeAOVHalf.h"
+#include "GradeAOVProfile.h"
+
+#include <pybind11/numpy.h>
+#include <pybind11/pybind11.h>
+
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace py = pybind11;
+using namespace GradeAOV;
+
+namespace
+{
+
+// Tuned settings of this host, loaded at import
+TuneProfile profile;
+
+// -----------------------------
+// SHARED THREAD POOL
+// Rebuilt when the thread count changes. Calls from several Python threads
+// take turns on it (forEachTile is not reentrant).
+// -----------------------------
+std::mutex poolMutex;
+std::unique_ptr<Executor> pool;
+int poolThreads = -1;
+
+// Active trace, null when not tracing
+std::unique_ptr<TraceRecorder> tracer;
+
+Executor& executorFor(int threads)
+{
+  if (!pool || poolThreads != threads)
+  {
+    pool.reset();
+    pool.reset(new Executor(threads, profile.numa));
+    pool->setTrace(tracer.get());
+    poolThreads = threads;
+  }
+  return *pool;
+}
+
+// -----------------------------
+// TRACING
+// -----------------------------
+void startTrace()
+{
+  std::lock_guard<std::mutex> lock(poolMutex);
+  tracer.reset(new TraceRecorder());
+  if (pool)
+    pool->setTrace(tracer.get());
+}
+
+size_t stopTrace(const std::string& path)
+{
+  std::lock_guard<std::mutex> lock(poolMutex);
+  if (!tracer)
+    throw py::value_error("no trace running, call start_trace() first");
+
+  if (pool)
+    pool->setTrace(nullptr);
+  std::unique_ptr<TraceRecorder> done = std::move(tracer);
+
+  done->write(path);
+  return done->events();
+}
+
+// -----------------------------
+// ARRAY LAYOUT
+// -----------------------------
+struct Layout
+{
+  char* data = nullptr;
+  int height = 0, width = 0, channels = 0;
+
+  // Byte strides
+  ptrdiff_t rowStride = 0, pixelStride = 0, channelStride = 0;
+};
+
+Layout layoutOf(const py::array& a, const char* name, bool image)
+{
+  Layout l;
+  l.data = static_cast<char*>(const_cast<void*>(a.data()));
+
+  if (a.ndim() == 3)
+  {
+    l.channels      = int(a.shape(2));
+    l.channelStride = a.strides(2);
+  }
+  else if (a.ndim() == 2 && !image)
+  {
+    l.channels      = 1;
+    l.channelStride = 0;
+  }
+  else
+    throw py::value_error(std::string(name) + (image ? " must be (H, W, C)"
+                                                     : " must be (H, W) or (H, W, C)"));
+
+  l.height      = int(a.shape(0));
+  l.width       = int(a.shape(1));
+  l.rowStride   = a.strides(0);
+  l.pixelStride = a.strides(1);
+
+  if (image && l.channels < 3)
+    throw py::value_error(std::string(name) + " needs at least 3 channels");
+  if (l.channels < 1)
+    throw py::value_error(std::string(name) + " has no channels");
+
+  return l;
+}
+
+// Float view over an image layout (RGB(A) = channels 0..3)
+ImageView imageView(const Layout& l)
+{
+  ImageView v;
+  for (int c = 0; c < 4 && c < l.channels; c++)
+    v.chan[c] = reinterpret_cast<float*>(l.data + c * l.channelStride);
+  v.width       = l.width;
+  v.height      = l.height;
+  v.pixelStride = l.pixelStride;
+  v.rowStride   = l.rowStride;
+  return v;
+}
+
+// Float view over a mask layout, last channel as alpha
+ImageView maskView(const Layout& l)
+{
+  ImageView v;
+  v.chan[3]     = reinterpret_cast<float*>(l.data + (l.channels - 1) * l.channelStride);
+  v.width       = l.width;
+  v.height      = l.height;
+  v.pixelStride = l.pixelStride;
+  v.rowStride   = l.rowStride;
+  return v;
+}
+
+// -----------------------------
+// FLOAT16 TILE CONVERSION
+// -----------------------------
+
+// Read channel c of pixel (x, y), 0 if missing
+inline float readHalf(const Layout& l, int c, int x, int y)
+{
+  if (c >= l.channels)
+    return 0.0f;
+  uint16_t h;
+  std::memcpy(&h, l.data + y * l.rowStride + x * l.pixelStride + c * l.channelStride, 2);
+  return halfToFloat(h);
+}
+
+inline void writeHalf(const Layout& l, int c, int x, int y, float v)
+{
+  uint16_t h = floatToHalf(v);
+  std::memcpy(l.data + y * l.rowStride + x * l.pixelStride + c * l.channelStride, &h, 2);
+}
+
+// Grade one tile of float16 arrays through RGBA float rows
+void gradeHalfTile(const GradeAOVOpt& op, const Layout& src, const Layout& aov,
+                   const Layout* mask, const Layout& out, const Tile& t,
+                   std::vector<float>& scratch)
+{
+  const int w = t.x1 - t.x0;
+  scratch.resize(size_t(w) * 16);
+
+  float* s = scratch.data();
+  float* a = s + 4 * w;
+  float* m = a + 4 * w;
+  float* d = m + 4 * w;
+
+  for (int y = t.y0; y < t.y1; y++)
+  {
+    for (int x = 0; x < w; x++)
+      for (int c = 0; c < 4; c++)
+      {
+        s[4 * x + c] = readHalf(src, c, t.x0 + x, y);
+        a[4 * x + c] = readHalf(aov, c, t.x0 + x, y);
+      }
+
+    if (mask)
+      for (int x = 0; x < w; x++)
+        m[4 * x + 3] = readHalf(*mask, mask->channels - 1, t.x0 + x, y);
+
+    op.processRow(s, a, mask ? m : nullptr, d, w);
+
+    for (int x = 0; x < w; x++)
+      for (int c = 0; c < 4 && c < out.channels; c++)
+        writeHalf(out, c, t.x0 + x, y, d[4 * x + c]);
+  }
+}
+
+// -----------------------------
+// KNOBS FROM KEYWORD ARGUMENTS
+// -----------------------------
+void setKnobs(GradeAOVOpt& op, const py::kwargs& knobs)
+{
+  for (auto item : knobs)
+  {
+    const std::string name = py::str(item.first);
+    py::handle value = item.second;
+
+    float v[4];
+    int n = 0;
+
+    if (py::isinstance<py::bool_>(value))
+      v[n++] = value.cast<bool>() ? 1.0f : 0.0f;
+    else if (py::isinstance<py::float_>(value) || py::isinstance<py::int_>(value))
+      v[n++] = value.cast<float>();
+    else if (py::isinstance<py::sequence>(value) && !py::isinstance<py::str>(value))
+    {
+      py::sequence seq = py::reinterpret_borrow<py::sequence>(value);
+      if (seq.size() > 4)
+        throw py::value_error("knob '" + name + "' takes 1, 3 or 4 values");
+      for (auto e : seq)
+        v[n++] = e.cast<float>();
+    }
+
+    if (!op.setParam(name, v, n))
+      throw py::value_error("unknown knob or bad value for '" + name + "'");
+  }
+}
+
+// -----------------------------
+// grade()
+// -----------------------------
+py::array grade(py::array src, py::array aov, py::object mask, py::object out,
+                py::object threadsArg, py::object tileRowsArg, py::kwargs knobs)
+{
+  // Explicit arguments win over the profile, explicit rows mean full-width bands
+  const int threads  = threadsArg.is_none() ? profile.threads : threadsArg.cast<int>();
+  const int tileW    = tileRowsArg.is_none() ? profile.tileW : 0;
+  const int tileRows = tileRowsArg.is_none() ? profile.tileH : tileRowsArg.cast<int>();
+
+  const py::dtype f32 = py::dtype::of<float>();
+  const py::dtype f16("float16");
+
+  // Native byte order float32 or float16 (dtype == compares byte order too)
+  const bool half = src.dtype().equal(f16);
+  if (!half && !src.dtype().equal(f32))
+    throw py::type_error("arrays must be float32 or float16");
+
+  const py::dtype& dt = half ? f16 : f32;
+
+  const bool hasMask = !mask.is_none();
+  py::array maskArr;
+  if (hasMask)
+    maskArr = mask.cast<py::array>();
+
+  // Output : caller's array, or a new (H, W, 4) one
+  py::array outArr;
+  if (out.is_none())
+    outArr = py::array(dt, std::vector<py::ssize_t>{src.shape(0), src.shape(1), 4});
+  else
+  {
+    outArr = out.cast<py::array>();
+    if (!outArr.writeable())
+      throw py::value_error("out is read-only");
+  }
+
+  // Same dtype everywhere, nothing is converted behind the caller's back
+  if (!aov.dtype().equal(dt) || !outArr.dtype().equal(dt) ||
+      (hasMask && !maskArr.dtype().equal(dt)))
+    throw py::type_error("src, aov, mask and out must share one dtype");
+
+  const Layout srcL = layoutOf(src, "src", true);
+  const Layout aovL = layoutOf(aov, "aov", true);
+  const Layout outL = layoutOf(outArr, "out", true);
+  Layout maskL;
+  if (hasMask)
+    maskL = layoutOf(maskArr, "mask", false);
+
+  // Knobs : mask on when given, then the keyword arguments
+  GradeAOVOpt op;
+  op.useMask = hasMask;
+  setKnobs(op, knobs);
+  op.init();
+
+  const ImageView srcV = imageView(srcL);
+  const ImageView aovV = imageView(aovL);
+  const ImageView outV = imageView(outL);
+  const ImageView maskV = hasMask ? maskView(maskL) : ImageView();
+
+  if (!half)
+    checkViews(srcV, aovV, hasMask ? &maskV : nullptr, outV);
+  else if (aovL.width != srcL.width || aovL.height != srcL.height ||
+           outL.width != srcL.width || outL.height != srcL.height ||
+           (hasMask && (maskL.width != srcL.width || maskL.height != srcL.height)))
+    throw py::value_error("src, aov, mask and out must have the same size");
+
+  // -----------------------------
+  // RUN WITHOUT THE GIL
+  // The arrays stay referenced by this frame until we return.
+  // -----------------------------
+  {
+    py::gil_scoped_release release;
+    std::lock_guard<std::mutex> lock(poolMutex);
+    Executor& executor = executorFor(threads);
+    const double callBegin = tracer ? tracer->now() : 0.0;
+
+    if (!half)
+      processImage(executor, op, srcV, aovV, hasMask ? &maskV : nullptr, outV,
+                   tileW, tileRows, profile.hints);
+    else
+    {
+      std::vector<std::vector<float>> scratch(executor.threads());
+      executor.forEachTile(srcL.width, srcL.height, tileW, tileRows,
+        [&](const Tile& t, int thread)
+        {
+          gradeHalfTile(op, srcL, aovL, hasMask ? &maskL : nullptr, outL, t, scratch[thread]);
+        });
+    }
+
+    if (tracer)
+      tracer->complete(0, "grade()", "python", callBegin, tracer->now(),
+                       "\"width\": " + std::to_string(srcL.width) +
+                       ", \"height\": " + std::to_string(srcL.height) +
+                       (half ? ", \"float16\": true" : ""));
+  }
+
+  return outArr;
+}
+
+} // namespace
+
+// -----------------------------
+// MODULE
+// -----------------------------
+PYBIND11_MODULE(gradeaov, m)
+{
+  m.doc() = "Native GradeAOVOpt: grade an AOV and put it back into the beauty";
+
+  // A broken profile must not make the module unimportable
+  std::string profileError;
+  profile = loadHostProfileOrDefaults(&profileError);
+  if (!profileError.empty())
+  {
+    const std::string warning = "gradeaov: ignoring the tuning profile, " + profileError +
+                                ", using the default threads and tiles";
+    if (PyErr_WarnEx(PyExc_RuntimeWarning, warning.c_str(), 1) < 0)
+      throw py::error_already_set();
+  }
+  if (profile.loaded)
+    m.attr("profile") = hostProfilePath();
+  else
+    m.attr("profile") = py::none();
+
+  m.def("grade", &grade,
+        py::arg("src"), py::arg("aov"),
+        py::arg("mask") = py::none(), py::arg("out") = py::none(),
+        py::arg("threads") = py::none(), py::arg("tile_rows") = py::none(),
+        "grade(src, aov, mask=None, out=None, threads=None, tile_rows=None, **knobs)\n\n"
+        "Grade aov like GradeAOVOpt and put it back into src, returns out.\n"
+        "out=src grades in place.\n"
+        "threads / tile_rows default to the host profile (gradeaov.profile).\n"
+        "Knobs (blackpoint, whitepoint, lift, gain, multiply, offset, gamma,\n"
+        "black_clamp, white_clamp, viewaov, reverse, unpremult, mix, useMask)\n"
+        "are keyword arguments.");
+
+  m.def("start_trace", &startTrace,
+        "Start recording grade() calls (tiles per thread, stalls) into a trace.");
+  m.def("stop_trace", &stopTrace, py::arg("path"),
+        "Stop recording and write the Chrome trace JSON to path, returns the event count.");
+}
@@ -0,0 +1,383 @@
+#!/usr/bin/env python3
+# ============================================================================
+# GradeAOVPyCheck — checks the gradeaov Python module against GradeAOVOpt
+# Grades random NumPy frames through gradeaov.grade() in every layout the
+# module takes (views, in place, float16, masks, threads) and compares each
+# output value with a NumPy transcription of the native GradeAOVOpt.
+# ============================================================================
+
+# USAGE :
+#   python3 GradeAOVPyCheck.py [-w width] [-h height] [--seed n]
+#                              [--configs n] [--tolerance t]
+#
+#   -w / -h    : frame size (default 320 x 180)
+#   --seed     : seed of the frames and knob sets (default 1)
+#   --configs  : random knob sets graded on contiguous float32 frames
+#                (default 64)
+#   --tolerance: largest difference allowed, relative to max(1, |value|)
+#                (default 1e-5)
+#
+# Exits 1 when a check fails.
+#
+# MAJOR NOTES :
+# reference() is GradeAOVOpt::init() and process() from GradeAOVNative.h
+# in float32, operation for operation. It is not bit exact : NumPy's
+# float32 power is not always libm's powf (SIMD builds), pow segment
+# outputs differ by a few ulps, hence the tolerance. float16 outputs may
+# also round to the next half, one float16 ulp is allowed there. Results
+# that do not depend on pow (threads, tile rows, knob labels) must match
+# bit for bit.
+# The GIL check counts the steps a Python thread makes while grade() runs
+# on another one, none means the GIL was held.
+#
+# BUILD :
+#   c++ -O3 -std=c++17 -shared -fPIC -pthread GradeAOVPy.cpp
+#       $(python3 -m pybind11 --includes)
+#       -o gradeaov$(python3-config --extension-suffix)
+#   python3 GradeAOVPyCheck.py    (next to the built module)
+
+import argparse
+import json
+import os
+import sys
+import tempfile
+import threading
+
+import numpy as np
+
+import gradeaov
+
+F32 = np.float32
+
+COLOUR_KNOBS = ("blackpoint", "whitepoint", "lift", "gain", "multiply", "offset", "gamma")
+BOOL_KNOBS = ("black_clamp", "white_clamp", "viewaov", "reverse", "unpremult")
+
+
+# -----------------------------
+# KNOBS
+# GradeAOVOpt's defaults, colour knobs as 4 float32 values
+# -----------------------------
+def knobs_of(kw, masked):
+    k = {"blackpoint": 0.0, "whitepoint": 1.0, "lift": 0.0, "gain": 1.0,
+         "multiply": 1.0, "offset": 0.0, "gamma": 1.0, "mix": 1.0,
+         "useMask": masked}
+    for name in BOOL_KNOBS:
+        k[name] = False
+    k.update(kw)
+
+    for name in COLOUR_KNOBS:
+        v = np.atleast_1d(np.asarray(k[name], dtype=F32))
+        k[name] = np.resize(v, 4) if v.size == 1 else np.concatenate([v, np.ones(4 - v.size, F32)])
+    k["mix"] = F32(k["mix"])
+    return k
+
+
+def random_knobs(rng):
+    def colour(lo, hi):
+        return [float(v) for v in rng.uniform(lo, hi, 3)]
+
+    def gamma():
+        # pow curve, identity and gamma <= 0 channels
+        return [float(rng.choice([rng.uniform(0.4, 2.5), 1.0, 0.0], p=[0.7, 0.2, 0.1]))
+                for _ in range(3)]
+
+    kw = {"blackpoint": colour(-0.1, 0.1), "whitepoint": colour(0.8, 1.2),
+          "lift": colour(-0.1, 0.1), "gain": colour(0.5, 2.0),
+          "multiply": colour(0.5, 1.5), "offset": colour(-0.1, 0.1),
+          "gamma": gamma(),
+          "mix": float(rng.choice([1.0, rng.uniform(0.0, 1.0), 0.0], p=[0.6, 0.3, 0.1]))}
+    for name in BOOL_KNOBS:
+        kw[name] = bool(rng.integers(2))
+    return kw
+
+
+# -----------------------------
+# NUMPY GradeAOVOpt
+# src, aov : (H, W, 4) float32, mask : (H, W) float32 alpha or None
+# -----------------------------
+def reference(src, aov, mask, **kw):
+    k = knobs_of(kw, mask is not None)
+
+    # init(), alpha included as in the native port
+    with np.errstate(all="ignore"):
+        A = k["multiply"] * (k["gain"] - k["lift"]) / (k["whitepoint"] - k["blackpoint"])
+        B = k["offset"] + k["lift"] - A * k["blackpoint"]
+        G = k["gamma"]
+        invG = F32(1) / G
+    Ainv = np.where(np.abs(A) > F32(1e-6), F32(1) / np.where(A == 0, F32(1), A), F32(1)).astype(F32)
+    Brev = -B * Ainv
+
+    mix = k["mix"]
+    m = mask if (k["useMask"] and mask is not None) else np.ones(src.shape[:2], F32)
+    sA, aA = src[..., 3], aov[..., 3]
+
+    with np.errstate(all="ignore"):
+        # Unpremult
+        if k["unpremult"]:
+            invA = F32(1) / np.maximum(sA, F32(1e-8))
+            x = aov[..., :3] * invA[..., None]
+            linW = aA * invA
+        else:
+            x = aov[..., :3]
+
+        y = np.empty_like(x)
+        for i in range(3):
+            xi = x[..., i]
+            if not k["reverse"]:
+                # linear_stage() then forward_gamma()
+                lin = A[i] * xi + B[i]
+                if k["white_clamp"] or k["black_clamp"]:
+                    if not k["white_clamp"]:
+                        lin = np.maximum(lin, F32(0))
+                    elif not k["black_clamp"]:
+                        lin = np.minimum(lin, F32(1))
+                    else:
+                        lin = np.minimum(np.maximum(lin, F32(0)), F32(1))
+                if G[i] <= 0:
+                    yi = np.where(lin < 0, F32(0), np.where(lin > 1, F32(1e30), lin))
+                elif G[i] != 1:
+                    yi = np.where(lin < 0, lin,
+                                  np.where(lin < 1, np.power(lin, invG[i]),
+                                           F32(1) + (lin - F32(1)) * invG[i]))
+                else:
+                    yi = lin
+            else:
+                # reverse_gamma() then reverse_linear_stage()
+                if G[i] <= 0:
+                    rev = np.where(xi > 0, F32(1), F32(0))
+                elif G[i] != 1:
+                    rev = np.where(xi <= 0, xi,
+                                   np.where(xi < 1, np.power(xi, G[i]),
+                                            F32(1) + (xi - F32(1)) * G[i]))
+                else:
+                    rev = xi
+                yi = rev * Ainv[i] + Brev[i]
+                if k["black_clamp"]:
+                    yi = np.maximum(yi, F32(0))
+                elif k["white_clamp"]:
+                    yi = np.minimum(yi, F32(1))
+            y[..., i] = yi
+
+        # Premultiplied before / after grading
+        original = np.empty_like(aov)
+        graded = np.empty_like(aov)
+        if k["unpremult"]:
+            original[..., :3] = x * sA[..., None]
+            graded[..., :3] = y * sA[..., None]
+            original[..., 3] = graded[..., 3] = linW * sA
+        else:
+            original[:] = aov
+            graded[..., :3] = y
+            graded[..., 3] = aA
+
+        # Blend, early-out
+        t = np.minimum(F32(1), np.maximum(F32(0), m * mix))[..., None]
+        g = np.where(t >= 1, graded, original + (graded - original) * t)
+        g = np.where(((mix <= 0) | (m <= 0))[..., None], aov, g)
+
+        # composite()
+        out = np.empty_like(src)
+        if k["viewaov"]:
+            out[..., :3] = src[..., :3] - src[..., :3] + g[..., :3]
+        else:
+            out[..., :3] = src[..., :3] - aov[..., :3] + g[..., :3]
+        out[..., 3] = sA
+    return out
+
+
+# -----------------------------
+# COMPARE
+# Returns the number of values beyond the tolerance, NaN equals NaN
+# -----------------------------
+def differs(out, ref, tolerance, half=False):
+    o = np.asarray(out, dtype=np.float64)
+    r = np.asarray(ref, dtype=np.float64)
+    with np.errstate(all="ignore"):
+        allowed = tolerance * np.maximum(1.0, np.abs(r))
+        if half:
+            allowed = np.maximum(allowed, np.spacing(np.abs(r).astype(np.float16)).astype(np.float64))
+        bad = ~((o == r) | (np.isnan(o) & np.isnan(r)) | (np.abs(o - r) <= allowed))
+    return int(np.count_nonzero(bad))
+
+
+def rgba(a):
+    """(H, W, C) array as (H, W, 4) float32, a missing alpha reads as 0"""
+    out = np.zeros(a.shape[:2] + (4,), F32)
+    out[..., :min(4, a.shape[2])] = a[..., :4]
+    return out
+
+
+def frame(rng, h, w, c=4, dtype=F32):
+    # Mostly in [0, 1], with negatives, > 1 and zero alphas
+    a = rng.uniform(-0.2, 1.6, (h, w, c)).astype(F32)
+    a[rng.random((h, w)) < 0.05, min(3, c - 1)] = 0
+    return a.astype(dtype)
+
+
+class Checks:
+    def __init__(self):
+        self.failed = 0
+
+    def report(self, name, bad, detail=""):
+        if bad:
+            self.failed += 1
+        print("%-34s %s%s" % (name, "FAILED" if bad else "ok", detail))
+
+    def raises(self, name, error, fn):
+        try:
+            fn()
+        except error:
+            self.report(name, False)
+            return
+        except Exception as e:
+            self.report(name, True, " : %s instead of %s" % (type(e).__name__, error.__name__))
+            return
+        self.report(name, True, " : no %s" % error.__name__)
+
+
+def main():
+    parser = argparse.ArgumentParser(add_help=False)
+    parser.add_argument("--help", action="help")
+    parser.add_argument("-w", type=int, default=320)
+    parser.add_argument("-h", type=int, default=180)
+    parser.add_argument("--seed", type=int, default=1)
+    parser.add_argument("--configs", type=int, default=64)
+    parser.add_argument("--tolerance", type=float, default=1e-5)
+    args = parser.parse_args()
+
+    w, h, tol = args.w, args.h, args.tolerance
+    rng = np.random.default_rng(args.seed)
+    checks = Checks()
+
+    print("GradeAOVPyCheck: %d x %d, seed %d, profile %s" % (w, h, args.seed, gradeaov.profile))
+
+    # Random knob sets, contiguous RGBA with a 2D mask
+    src, aov, mask = frame(rng, h, w), frame(rng, h, w), frame(rng, h, w, 1)[..., 0]
+    bad = 0
+    for _ in range(args.configs):
+        kw = random_knobs(rng)
+        bad += differs(gradeaov.grade(src, aov, mask, **kw), reference(src, aov, mask, **kw), tol) > 0
+    checks.report("knob sets (float32, 2D mask)", bad, " : %d of %d differ" % (bad, args.configs))
+
+    kw = {"gain": (1.3, 1.1, 0.9), "gamma": (0.8, 1.0, 1.7), "mix": 0.75, "unpremult": True}
+
+    # No mask
+    checks.report("no mask", differs(gradeaov.grade(src, aov, **kw), reference(src, aov, None, **kw), tol))
+
+    # Views : strided src, RGB aov (alpha reads 0), RGBA mask, planar out
+    big = frame(rng, 2 * h, 3 * w, 5)
+    vsrc = big[1::2, ::3, :4]
+    vaov = frame(rng, h, w, 3)
+    vmask = frame(rng, h, w, 4)
+    vout = np.empty((4, h, w), F32).transpose(1, 2, 0)
+    ret = gradeaov.grade(vsrc, vaov, vmask, out=vout, **kw)
+    ref = reference(rgba(vsrc), rgba(vaov), vmask[..., 3], **kw)
+    checks.report("views (strided, RGB, planar out)",
+                  differs(vout, ref, tol) or not np.shares_memory(ret, vout))
+
+    # Bottom-up and transposed inputs
+    fsrc, taov = src[::-1], np.ascontiguousarray(aov.transpose(1, 0, 2)).transpose(1, 0, 2)
+    checks.report("negative / transposed strides",
+                  differs(gradeaov.grade(fsrc, taov, mask, **kw), reference(fsrc, taov, mask, **kw), tol))
+
+    # In place, out=src
+    inplace = src.copy()
+    gradeaov.grade(inplace, aov, mask, out=inplace, **kw)
+    checks.report("in place (out=src)", differs(inplace, reference(src, aov, mask, **kw), tol))
+
+    # float16, converted tile by tile
+    hsrc, haov, hmask = src.astype(np.float16), aov.astype(np.float16), mask.astype(np.float16)
+    hout = gradeaov.grade(hsrc, haov, hmask, **kw)
+    with np.errstate(over="ignore"):
+        href = reference(hsrc.astype(F32), haov.astype(F32), hmask.astype(F32),
+                         **kw).astype(np.float16)
+    checks.report("float16", hout.dtype != np.float16 or differs(hout, href, tol, half=True))
+
+    # Knob labels, useMask off ignores the mask : bit exact
+    named = gradeaov.grade(src, aov, mask, black_clamp=True, unpremult=True, viewaov=True)
+    labelled = gradeaov.grade(src, aov, mask, **{"black clamp": True, "(un)premult": True,
+                                                 "view AOV": True})
+    unmasked = gradeaov.grade(src, aov, mask, **{"use mask": False, "gain": 1.2})
+    checks.report("knob labels", differs(named, labelled, 0.0) or
+                  differs(unmasked, gradeaov.grade(src, aov, gain=1.2), 0.0))
+
+    # Threads and tile rows : the same pixels, bit exact
+    one = gradeaov.grade(src, aov, mask, threads=1, tile_rows=h, **kw)
+    many = gradeaov.grade(src, aov, mask, threads=4, tile_rows=7, **kw)
+    auto = gradeaov.grade(src, aov, mask, threads=0, **kw)
+    checks.report("threads / tile rows", differs(one, many, 0.0) or differs(one, auto, 0.0))
+
+    # Concurrent calls from Python threads, each its own frames and knobs
+    jobs = [(frame(rng, h, w), frame(rng, h, w), frame(rng, h, w, 1)[..., 0], random_knobs(rng))
+            for _ in range(4)]
+    results = [None] * len(jobs)
+
+    def run(i):
+        s, a, m, k = jobs[i]
+        results[i] = gradeaov.grade(s, a, m, threads=2, **k)
+
+    workers = [threading.Thread(target=run, args=(i,)) for i in range(len(jobs))]
+    for t in workers:
+        t.start()
+    for t in workers:
+        t.join()
+    checks.report("concurrent calls", sum(r is None or differs(r, reference(*j[:3], **j[3]), tol) > 0
+                                          for r, j in zip(results, jobs)))
+
+    # GIL released : a Python thread keeps running during a long grade()
+    gs, ga = frame(rng, 2048, 2048), frame(rng, 2048, 2048)
+    state = {"inside": False, "steps": 0, "stop": False}
+
+    def spin():
+        while not state["stop"]:
+            if state["inside"]:
+                state["steps"] += 1
+
+    spinner = threading.Thread(target=spin)
+    spinner.start()
+    for _ in range(4):
+        state["inside"] = True
+        gradeaov.grade(gs, ga, out=gs, threads=1, gamma=0.8)
+        state["inside"] = False
+    state["stop"] = True
+    spinner.join()
+    checks.report("GIL released", state["steps"] == 0, " : %d Python steps during grade()"
+                  % state["steps"])
+
+    # Trace : Chrome JSON with the grade() calls
+    gradeaov.start_trace()
+    gradeaov.grade(src, aov, mask, **kw)
+    fd, path = tempfile.mkstemp(suffix=".json")
+    os.close(fd)
+    try:
+        events = gradeaov.stop_trace(path)
+        with open(path) as f:
+            trace = json.load(f)
+        checks.report("trace", events <= 0 or not trace.get("traceEvents"),
+                      " : %d event(s)" % events)
+    finally:
+        os.remove(path)
+
+    # Errors
+    checks.raises("float64 rejected", TypeError,
+                  lambda: gradeaov.grade(src.astype(np.float64), aov.astype(np.float64)))
+    checks.raises("mixed dtypes rejected", TypeError, lambda: gradeaov.grade(src, haov))
+    checks.raises("size mismatch rejected", ValueError, lambda: gradeaov.grade(src, aov[1:]))
+    checks.raises("unknown knob rejected", ValueError, lambda: gradeaov.grade(src, aov, sharpen=1.0))
+    checks.raises("2 value colour knob rejected", ValueError,
+                  lambda: gradeaov.grade(src, aov, gain=(1.0, 2.0)))
+    readonly = src.copy()
+    readonly.flags.writeable = False
+    checks.raises("read-only out rejected", ValueError,
+                  lambda: gradeaov.grade(src, aov, out=readonly))
+    checks.raises("stop_trace() without a trace", ValueError, lambda: gradeaov.stop_trace(path))
+
+    if checks.failed:
+        print("%d check(s) failed" % checks.failed)
+        return 1
+    print("all checks passed")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
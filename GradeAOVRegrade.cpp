@@ -0,0 +1,726 @@
+// ============================================================================
+// GradeAOVRegrade — recipe-driven AOV regrade of a multi-layer EXR
+// Reads only the layers a recipe references, applies every GradeAOVOpt
+// grade and rebuilds the beauty in one streaming pass per scanline block
+// (or per tile with --tiled, for images larger than memory).
+// ============================================================================
+
+// USAGE :
+//   GradeAOVRegrade <recipe.json> <in.exr> <out.exr> [-t threads] [--patch]
+//                   [--tiled] [--cache MB] [--trace trace.json]
+//                   [--heatmap cost.exr|cost.png] [--ftz]
+//
+//   -t threads : OpenEXR decode / encode threads
+//   --patch    : write every part of the input, parts without a graded
+//                channel are copied chunk for chunk without decoding
+//   --tiled    : tiled inputs only, grade tile by tile on the beauty's tile
+//                grid and write a tiled output, memory stays bounded
+//   --cache MB : decoded tile cache budget for --tiled (default 256)
+//   --trace    : Chrome trace JSON of the pass (read / grade / write spans
+//                per block or tile, bytes read, tile cache hits)
+//   --heatmap  : grade time per pixel of every tile (--tiled) or every
+//                64 pixels x block of lines, as a float Y channel in ns
+//                over the output's data window (.exr), or a colour PNG
+//                (GradeAOVHeatmap.h)
+//   --ftz      : grade with denormals flushed to zero, much faster on
+//                denoised AOVs full of tiny values. Changes results where
+//                denormals feed pow() or a divide : gamma > 1 or unpremult
+//                turn them into normal values that FTZ makes 0 (see
+//                GradeAOVDenormals.h)
+//
+// RECIPE :
+//   {
+//     "beauty": "",
+//     "grades": [
+//       { "layer": "diffuse", "gain": [1.2, 1.1, 1.0], "gamma": 0.9,
+//         "mask": "matte", "mix": 0.8, "unpremult": true },
+//       { "layer": "specular", "multiply": 0.7 }
+//     ]
+//   }
+//
+//   "beauty" is the beauty layer name, "" (default) means R,G,B,A.
+//   Every GradeAOVOpt knob can be set by its name or knob label.
+//   "mask" is a channel name, or a layer name whose alpha is used,
+//   and turns "use mask" on.
+//   Grades run in order like a chain of GradeAOVOpt nodes: each one sees
+//   the beauty and its layer as left by the grades before it.
+//
+// BUILD :
+//   g++ -O3 -std=c++17 GradeAOVRegrade.cpp -o GradeAOVRegrade
+//       $(pkg-config --cflags --libs OpenEXR)
+//   add -DGRADEAOV_STATS to print hot path counters (GradeAOVStats.h)
+
+// MAJOR NOTES :
+// All parts holding referenced layers must share the same data window.
+// Only the referenced channels are decoded (see GradeAOVEXR.h), the bytes
+// actually read from the input are reported at the end.
+// Output is a scanline EXR holding the beauty and the graded layers only,
+// unless --patch is given. Patching works per part: a part holding a graded
+// channel is re-encoded whole (as scanlines, or tiles with --tiled), so the
+// saving comes from renders written with layers in separate parts.
+// With --tiled, peak memory is the tile cache plus one tile per channel and
+// OpenEXR's own buffers, the peak RSS is reported at the end.
+// GradeAOVTileCacheBench measures peak RSS against the cache budget.
+// Grades run in place on the decoded planes, there is no second copy.
+// UINT channels (IDs) of re-encoded parts are copied bit for bit, graded
+// layers, the beauty and masks must be HALF or FLOAT.
+// GradeAOVRegradeCheck checks a --patch round trip, part by part.
+
+#include "GradeAOVDenormals.h"
+#include "GradeAOVEXR.h"
+#include "GradeAOVHeatmap.h"
+#include "GradeAOVJson.h"
+#include "GradeAOVTrace.h"
+#include "GradeAOVNative.h"
+
+#include <OpenEXR/ImfChannelList.h>
+#include <OpenEXR/ImfFrameBuffer.h>
+#include <OpenEXR/ImfHeader.h>
+#include <OpenEXR/ImfMultiPartOutputFile.h>
+#include <OpenEXR/ImfOutputFile.h>
+#include <OpenEXR/ImfOutputPart.h>
+#include <OpenEXR/ImfPartType.h>
+#include <OpenEXR/ImfThreading.h>
+#include <OpenEXR/ImfTiledOutputPart.h>
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace GradeAOV;
+
+namespace
+{
+
+// -----------------------------
+// LAYER : up to four channels, as planes of the reader
+// -----------------------------
+struct Layer
+{
+  // Layer name ("" = beauty R,G,B,A)
+  std::string name;
+
+  // Reader plane per RGBA slot, -1 when the channel is not in the file
+  int plane[4] = {-1, -1, -1, -1};
+
+  // Written back to the output
+  bool graded = false;
+};
+
+// One re-encoded output part and the reader planes it writes
+struct OutPart
+{
+  int index = 0;
+  std::vector<int> planes;
+  std::unique_ptr<Imf::OutputPart> part;
+  std::unique_ptr<Imf::TiledOutputPart> tiled;
+};
+
+// Stand-in planes for the grade chain
+// Heatmap cells of the scanline pass : kHeatmapCell pixels x a block
+constexpr int kHeatmapCell = 64;
+
+struct Scratch
+{
+  // Missing channels read as zero, like Nuke
+  std::vector<float> zero;
+
+  // Written to when the beauty has no plane for a channel
+  std::vector<float> discard;
+
+  void resize(size_t pixels)
+  {
+    zero.assign(pixels, 0.0f);
+    discard.resize(pixels);
+  }
+};
+
+// One recipe entry
+struct Grade
+{
+  GradeAOVOpt op;
+  int layer = -1;
+
+  // Reader plane of the mask channel
+  int mask  = -1;
+};
+
+// -----------------------------
+// CHANNEL LOOKUP
+// -----------------------------
+
+// Request one RGBA slot of a layer, tries "layer.R" then "layer.r"
+int requestSlot(EXRChannelReader& reader, const std::string& layer, int slot)
+{
+  static const char upper[] = "RGBA";
+  static const char lower[] = "rgba";
+
+  for (const char* letters : {upper, lower})
+  {
+    std::string name = layer.empty()
+                         ? std::string(1, letters[slot])
+                         : layer + "." + letters[slot];
+
+    if (reader.findChannel(name) >= 0)
+      return reader.request(name);
+  }
+  return -1;
+}
+
+// Add (or reuse) a colour layer, throws if it has no RGB
+int addLayer(EXRChannelReader& reader, std::vector<Layer>& layers,
+             const std::string& name)
+{
+  for (size_t i = 0; i < layers.size(); i++)
+    if (layers[i].name == name)
+      return int(i);
+
+  Layer layer;
+  layer.name = name;
+  for (int slot = 0; slot < 4; slot++)
+    layer.plane[slot] = requestSlot(reader, name, slot);
+
+  if (layer.plane[0] < 0 || layer.plane[1] < 0 || layer.plane[2] < 0)
+    throw std::runtime_error("layer '" + (name.empty() ? "rgba" : name) + "' not found");
+
+  for (int slot = 0; slot < 4; slot++)
+    if (layer.plane[slot] >= 0 && reader.planeType(layer.plane[slot]) == Imf::UINT)
+      throw std::runtime_error("channel '" + reader.planeName(layer.plane[slot]) +
+                               "' is UINT, only HALF and FLOAT layers can be graded");
+
+  layers.push_back(layer);
+  return int(layers.size() - 1);
+}
+
+// Mask : exact channel name first, else the layer alpha
+int addMask(EXRChannelReader& reader, const std::string& name)
+{
+  int plane = (reader.findChannel(name) >= 0) ? reader.request(name)
+                                              : requestSlot(reader, name, 3);
+  if (plane < 0)
+    throw std::runtime_error("mask '" + name + "' not found");
+  if (reader.planeType(plane) == Imf::UINT)
+    throw std::runtime_error("mask '" + reader.planeName(plane) + "' is UINT, not a matte");
+  return plane;
+}
+
+// -----------------------------
+// RECIPE
+// -----------------------------
+std::vector<Grade> loadRecipe(const Json& recipe, EXRChannelReader& reader,
+                              std::vector<Layer>& layers)
+{
+  // Beauty is always layer 0
+  const Json* beauty = recipe.find("beauty");
+  addLayer(reader, layers, beauty ? beauty->s : std::string());
+
+  const Json* grades = recipe.find("grades");
+  if (!grades || grades->type != Json::Array)
+    throw std::runtime_error("recipe has no \"grades\" array");
+
+  std::vector<Grade> out;
+  for (const Json& entry : grades->a)
+  {
+    const Json* layer = entry.find("layer");
+    if (!layer || layer->type != Json::String)
+      throw std::runtime_error("grade without \"layer\"");
+
+    Grade g;
+    g.layer = addLayer(reader, layers, layer->s);
+    if (g.layer == 0)
+      throw std::runtime_error("the beauty can't be graded as an AOV of itself");
+    layers[g.layer].graded = true;
+
+    for (const auto& kv : entry.o)
+    {
+      const std::string& key = kv.first;
+      const Json& v = kv.second;
+
+      if (key == "layer")
+        continue;
+
+      if (key == "mask")
+      {
+        if (v.type != Json::String)
+          throw std::runtime_error("\"mask\" must be a channel or layer name");
+        g.mask = addMask(reader, v.s);
+        g.op.useMask = true;
+        continue;
+      }
+
+      // Knob values : number, bool or array of numbers
+      float values[4];
+      int n = 0;
+      if (v.type == Json::Number)
+        values[n++] = float(v.n);
+      else if (v.type == Json::Bool)
+        values[n++] = v.b ? 1.0f : 0.0f;
+      else if (v.type == Json::Array && v.a.size() <= 4)
+        for (const Json& e : v.a)
+        {
+          if (e.type != Json::Number)
+            throw std::runtime_error("knob '" + key + "' for layer '" + layer->s +
+                                     "' : array elements must be numbers");
+          values[n++] = float(e.n);
+        }
+
+      if (!g.op.setParam(key, values, n))
+        throw std::runtime_error("bad knob '" + key + "' for layer '" + layer->s + "'");
+    }
+
+    // A mask knob without a mask channel grades nothing, like Blink
+    if (g.op.useMask && g.mask < 0)
+      throw std::runtime_error("\"use mask\" without \"mask\" for layer '" + layer->s + "'");
+
+    g.op.init();
+    out.push_back(g);
+  }
+
+  // Graded layers are rewritten, the beauty too
+  layers[0].graded = true;
+  return out;
+}
+
+// -----------------------------
+// GRADE CHAIN ON THE PLANES CURRENTLY DECODED
+// Graded in place : the beauty and the layer planes are overwritten, the
+// layer keeps its alpha. No second copy of the planes is needed.
+// -----------------------------
+// Grades pixels [begin, begin + pixels) of the decoded planes.
+void gradeChain(EXRChannelReader& reader, const std::vector<Layer>& layers,
+                const std::vector<Grade>& grades, size_t begin, int pixels, Scratch& scratch)
+{
+  GRADEAOV_NO_ALLOC();
+
+  const Layer& beauty = layers[0];
+
+  for (const Grade& g : grades)
+  {
+    const Layer& aov = layers[g.layer];
+
+    const float* src[4];
+    const float* aovIn[4];
+    float* dst[4];
+    for (int c = 0; c < 4; c++)
+    {
+      src[c]   = (beauty.plane[c] >= 0 ? reader.plane(beauty.plane[c]) : scratch.zero.data())
+               + begin;
+      aovIn[c] = (aov.plane[c]    >= 0 ? reader.plane(aov.plane[c])    : scratch.zero.data())
+               + begin;
+      dst[c]   = (beauty.plane[c] >= 0 ? reader.plane(beauty.plane[c]) : scratch.discard.data())
+               + begin;
+    }
+    const float* mask = g.mask >= 0 ? reader.plane(g.mask) + begin : nullptr;
+
+    float* const graded[3] = {reader.plane(aov.plane[0]) + begin,
+                              reader.plane(aov.plane[1]) + begin,
+                              reader.plane(aov.plane[2]) + begin};
+
+    g.op.processRowPlanar(src, aovIn, mask, dst, pixels, graded);
+  }
+}
+
+// Frame buffer over reader planes holding a box starting at (x0, y0),
+// UINT planes are written back with the bits they were read with
+Imf::FrameBuffer planeFrameBuffer(EXRChannelReader& reader, const std::vector<int>& planes,
+                                  int x0, int y0, int width)
+{
+  const size_t xStride = sizeof(float);
+  const size_t yStride = xStride * width;
+
+  Imf::FrameBuffer fb;
+  for (int plane : planes)
+  {
+    char* base = reinterpret_cast<char*>(reader.plane(plane))
+               - x0 * xStride - y0 * yStride;
+    fb.insert(reader.planeName(plane).c_str(),
+              Imf::Slice(planeSliceType(reader.planeType(plane)), base, xStride, yStride));
+  }
+  return fb;
+}
+
+// Heatmap as one float channel Y (ns per pixel) over the windows of like
+void writeHeatmapEXR(const TileHeatmap& map, const Imf::Header& like, const char* path)
+{
+  Imf::Header h(like.displayWindow(), like.dataWindow());
+  h.channels().insert("Y", Imf::Channel(Imf::FLOAT));
+
+  std::vector<float> image = map.frameImage();
+  const Imath::Box2i& dw = like.dataWindow();
+  const size_t xStride = sizeof(float);
+  const size_t yStride = xStride * map.width();
+
+  Imf::FrameBuffer fb;
+  fb.insert("Y", Imf::Slice(Imf::FLOAT, reinterpret_cast<char*>(image.data())
+                                        - dw.min.x * xStride - dw.min.y * yStride,
+                            xStride, yStride));
+
+  Imf::OutputFile file(path, h);
+  file.setFrameBuffer(fb);
+  file.writePixels(map.height());
+}
+
+} // namespace
+
+// -----------------------------
+// MAIN
+// -----------------------------
+int main(int argc, char* argv[])
+{
+  if (argc < 4)
+  {
+    std::fprintf(stderr, "usage: %s <recipe.json> <in.exr> <out.exr> [-t threads] [--patch]"
+                         " [--tiled] [--cache MB] [--trace trace.json]\n"
+                         "       [--heatmap cost.exr|cost.png] [--ftz]\n", argv[0]);
+    return 2;
+  }
+
+  const char* recipePath = argv[1];
+  const char* inPath     = argv[2];
+  const char* outPath    = argv[3];
+
+  bool patch = false;
+  bool tiled = false;
+  size_t cacheMB = 256;
+  const char* tracePath = nullptr;
+  const char* heatmapPath = nullptr;
+  bool ftz = false;
+
+  for (int i = 4; i < argc; i++)
+  {
+    if (!std::strcmp(argv[i], "-t") && i + 1 < argc)
+      Imf::setGlobalThreadCount(std::atoi(argv[++i]));
+    else if (!std::strcmp(argv[i], "--patch"))
+      patch = true;
+    else if (!std::strcmp(argv[i], "--tiled"))
+      tiled = true;
+    else if (!std::strcmp(argv[i], "--cache") && i + 1 < argc)
+      cacheMB = size_t(std::atol(argv[++i]));
+    else if (!std::strcmp(argv[i], "--trace") && i + 1 < argc)
+      tracePath = argv[++i];
+    else if (!std::strcmp(argv[i], "--heatmap") && i + 1 < argc)
+      heatmapPath = argv[++i];
+    else if (!std::strcmp(argv[i], "--ftz"))
+      ftz = true;
+    else
+    {
+      std::fprintf(stderr, "unknown option %s\n", argv[i]);
+      return 2;
+    }
+  }
+
+  try
+  {
+    auto start = std::chrono::steady_clock::now();
+
+    EXRChannelReader reader(inPath);
+    reader.setTileCacheSize(cacheMB << 20);
+
+    // Resolve layers referenced by the recipe
+    std::vector<Layer> layers;
+    std::vector<Grade> grades = loadRecipe(parseJsonFile(recipePath), reader, layers);
+
+    // -----------------------------
+    // OUTPUT PARTS
+    // -----------------------------
+    std::vector<Imf::Header> headers;
+    std::vector<OutPart> encoded;
+    std::vector<int> verbatim;
+
+    // Re-encoded parts are scanlines, or tiles on the beauty's tile grid
+    const Imf::Header& beautyHeader = reader.header(reader.planePart(layers[0].plane[0]));
+    if (tiled && !beautyHeader.hasTileDescription())
+      throw std::runtime_error("--tiled needs a tiled beauty");
+
+    auto encodedHeader = [&](Imf::Header& h)
+    {
+      h.erase("tiles");
+      h.erase("chunkCount");
+      if (tiled)
+      {
+        Imf::TileDescription td = beautyHeader.tileDescription();
+        td.mode = Imf::ONE_LEVEL;
+        h.setTileDescription(td);
+        h.setType(Imf::TILEDIMAGE);
+      }
+      else
+        h.setType(Imf::SCANLINEIMAGE);
+      h.lineOrder() = Imf::INCREASING_Y;
+    };
+
+    if (!patch)
+    {
+      // Single part : beauty part header, beauty + graded layer channels
+      Imf::Header h = beautyHeader;
+      h.erase("name");
+      encodedHeader(h);
+      h.channels() = Imf::ChannelList();
+
+      OutPart out;
+      for (const Layer& layer : layers)
+        if (layer.graded)
+          for (int slot = 0; slot < 4; slot++)
+            if (layer.plane[slot] >= 0)
+            {
+              h.channels().insert(reader.planeName(layer.plane[slot]).c_str(),
+                                  Imf::Channel(reader.planeType(layer.plane[slot])));
+              out.planes.push_back(layer.plane[slot]);
+            }
+
+      headers.push_back(h);
+      encoded.push_back(std::move(out));
+    }
+    else
+    {
+      // Same parts as the input, find the ones holding a graded channel
+      std::vector<bool> modified(reader.parts(), false);
+      for (const Layer& layer : layers)
+        if (layer.graded)
+          for (int slot = 0; slot < 4; slot++)
+            if (layer.plane[slot] >= 0)
+              modified[reader.planePart(layer.plane[slot])] = true;
+
+      for (int p = 0; p < reader.parts(); p++)
+      {
+        Imf::Header h = reader.header(p);
+
+        if (!modified[p])
+        {
+          verbatim.push_back(p);
+          headers.push_back(h);
+          continue;
+        }
+
+        // Re-encoded part : decode all its channels
+        reader.requestPart(p);
+        encodedHeader(h);
+
+        OutPart out;
+        out.index = p;
+        for (int i = 0; i < reader.planes(); i++)
+          if (reader.planePart(i) == p)
+            out.planes.push_back(i);
+
+        headers.push_back(h);
+        encoded.push_back(std::move(out));
+      }
+    }
+
+    Imf::MultiPartOutputFile file(outPath, headers.data(), int(headers.size()));
+
+    // Untouched parts first, chunk for chunk
+    for (int p : verbatim)
+      copyPartVerbatim(reader.file(), p, file, p);
+
+    for (OutPart& out : encoded)
+    {
+      if (tiled)
+        out.tiled.reset(new Imf::TiledOutputPart(file, out.index));
+      else
+        out.part.reset(new Imf::OutputPart(file, out.index));
+    }
+
+    const Imath::Box2i dw = reader.dataWindow();
+    const int width = dw.max.x - dw.min.x + 1;
+    const int blockLines = reader.blockLines();
+    Scratch scratch;
+
+    // Grade cost per tile, for --heatmap
+    std::unique_ptr<TileHeatmap> heatmap;
+    auto timeGrade = [&](int x, int y, int w, int h, size_t begin)
+    {
+      const auto gradeStart = std::chrono::steady_clock::now();
+      gradeChain(reader, layers, grades, begin, w * h, scratch);
+      heatmap->add(x - dw.min.x, y - dw.min.y, w, h, std::chrono::duration<double>(
+                     std::chrono::steady_clock::now() - gradeStart).count());
+    };
+
+    // Hot path counters of every grade (built with -DGRADEAOV_STATS)
+    GradeStats stats;
+    StatsScope statsScope(stats);
+
+    // Grades run on this thread only
+    FlushDenormals flush(ftz);
+
+    // Timeline of the pass, on one lane (OpenEXR's own threads are not seen)
+    TraceRecorder trace;
+    trace.setLaneName(0, "regrade");
+    const CountingIStream& in = reader.stream();
+
+    auto traceRead = [&](double begin, uint64_t bytes, uint64_t hits, uint64_t misses)
+    {
+      const double end = trace.now();
+      trace.complete(0, "read", "io", begin, end,
+                     "\"bytes\": " + std::to_string(in.bytesRead() - bytes) +
+                     ", \"cache hits\": " + std::to_string(reader.tileHits() - hits) +
+                     ", \"cache misses\": " + std::to_string(reader.tileMisses() - misses));
+      if (tiled)
+        trace.counter(0, "tile cache", end,
+                      "\"hits\": " + std::to_string(reader.tileHits()) +
+                      ", \"misses\": " + std::to_string(reader.tileMisses()) +
+                      ", \"MB\": " + std::to_string(reader.tileCacheBytes() >> 20));
+    };
+
+    if (!tiled)
+    {
+      // -----------------------------
+      // STREAMING PASS, ONE BLOCK OF SCANLINES AT A TIME
+      // -----------------------------
+      scratch.resize(size_t(width) * blockLines);
+      if (heatmapPath)
+        heatmap.reset(new TileHeatmap(width, dw.max.y - dw.min.y + 1, kHeatmapCell, blockLines));
+
+      for (int y0 = dw.min.y; y0 <= dw.max.y; y0 += blockLines)
+      {
+        const int y1 = std::min(y0 + blockLines - 1, dw.max.y);
+
+        // Decode the referenced channels only
+        const double readBegin = tracePath ? trace.now() : 0.0;
+        const uint64_t bytes = in.bytesRead();
+        reader.readBlock(y0, y1);
+        if (tracePath)
+          traceRead(readBegin, bytes, 0, 0);
+
+        const double gradeBegin = tracePath ? trace.now() : 0.0;
+        if (heatmap)
+        {
+          // kHeatmapCell pixels of a line at a time, credited to their cell
+          for (int y = y0; y <= y1; y++)
+            for (int x = 0; x < width; x += kHeatmapCell)
+              timeGrade(dw.min.x + x, y, std::min(kHeatmapCell, width - x), 1,
+                        size_t(y - y0) * width + x);
+        }
+        else
+          gradeChain(reader, layers, grades, 0, width * (y1 - y0 + 1), scratch);
+        if (tracePath)
+          trace.complete(0, "grade", "grade", gradeBegin, trace.now(),
+                         "\"y0\": " + std::to_string(y0) + ", \"y1\": " + std::to_string(y1));
+
+        // Write the re-encoded parts
+        const double writeBegin = tracePath ? trace.now() : 0.0;
+        for (OutPart& out : encoded)
+        {
+          out.part->setFrameBuffer(planeFrameBuffer(reader, out.planes, dw.min.x, y0, width));
+          out.part->writePixels(y1 - y0 + 1);
+        }
+        if (tracePath)
+          trace.complete(0, "write", "io", writeBegin, trace.now());
+      }
+    }
+    else
+    {
+      // -----------------------------
+      // STREAMING PASS, ONE TILE AT A TIME, IN OUTPUT ORDER
+      // -----------------------------
+      Imf::TiledOutputPart& grid = *encoded[0].tiled;
+      scratch.resize(size_t(grid.tileXSize()) * grid.tileYSize());
+      if (heatmapPath)
+        heatmap.reset(new TileHeatmap(width, dw.max.y - dw.min.y + 1, int(grid.tileXSize()),
+                                      int(grid.tileYSize())));
+
+      for (int ty = 0; ty < grid.numYTiles(); ty++)
+        for (int tx = 0; tx < grid.numXTiles(); tx++)
+        {
+          const Imath::Box2i box = grid.dataWindowForTile(tx, ty);
+          const int w = box.max.x - box.min.x + 1;
+
+          // Decode the box from cached input tiles
+          const double readBegin = tracePath ? trace.now() : 0.0;
+          const uint64_t bytes  = in.bytesRead();
+          const uint64_t hits   = reader.tileHits();
+          const uint64_t misses = reader.tileMisses();
+          reader.readRegion(box);
+          if (tracePath)
+            traceRead(readBegin, bytes, hits, misses);
+
+          const double gradeBegin = tracePath ? trace.now() : 0.0;
+          if (heatmap)
+            timeGrade(box.min.x, box.min.y, w, box.max.y - box.min.y + 1, 0);
+          else
+            gradeChain(reader, layers, grades, 0, w * (box.max.y - box.min.y + 1), scratch);
+          if (tracePath)
+            trace.complete(0, "grade", "grade", gradeBegin, trace.now(),
+                           "\"tx\": " + std::to_string(tx) + ", \"ty\": " + std::to_string(ty));
+
+          const double writeBegin = tracePath ? trace.now() : 0.0;
+          for (OutPart& out : encoded)
+          {
+            out.tiled->setFrameBuffer(planeFrameBuffer(reader, out.planes, box.min.x, box.min.y, w));
+            out.tiled->writeTile(tx, ty);
+          }
+          if (tracePath)
+            trace.complete(0, "write", "io", writeBegin, trace.now());
+        }
+    }
+
+    double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start).count();
+
+    if (tiled)
+      std::printf("%s: %zu grade(s), %d x %d, tiled, %.3f s\n",
+                  outPath, grades.size(), width, dw.max.y - dw.min.y + 1, seconds);
+    else
+      std::printf("%s: %zu grade(s), %d x %d, %d lines per block, %.3f s\n",
+                  outPath, grades.size(), width, dw.max.y - dw.min.y + 1,
+                  blockLines, seconds);
+    std::printf("  read %d channel(s) from %d of %d part(s), %.2f of %.2f MB (%.1f%%), %llu seeks\n",
+                reader.planes(), reader.partsRead(), reader.parts(),
+                in.bytesRead() / 1048576.0, in.fileSize() / 1048576.0,
+                in.fileSize() ? 100.0 * in.bytesRead() / in.fileSize() : 0.0,
+                (unsigned long long)in.seeks());
+    if (patch)
+      std::printf("  patched: %zu part(s) re-encoded, %zu copied verbatim\n",
+                  encoded.size(), verbatim.size());
+    if (tiled)
+      std::printf("  tile cache: %llu hits, %llu misses, %llu evictions, peak %.1f of %zu MB\n",
+                  (unsigned long long)reader.tileHits(), (unsigned long long)reader.tileMisses(),
+                  (unsigned long long)reader.tileEvictions(),
+                  reader.tileCachePeak() / 1048576.0, cacheMB);
+
+    // Peak resident memory, ru_maxrss is in KB on Linux
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    std::printf("  peak RSS %.1f MB\n", usage.ru_maxrss / 1024.0);
+
+    if (tracePath)
+    {
+      trace.write(tracePath);
+      std::printf("  trace: %zu event(s) written to %s\n", trace.events(), tracePath);
+    }
+
+    if (heatmap)
+    {
+      const std::string path = heatmapPath;
+      if (path.size() > 4 && path.compare(path.size() - 4, 4, ".exr") == 0)
+        writeHeatmapEXR(*heatmap, beautyHeader, heatmapPath);
+      else
+        heatmap->writePNG(path);
+
+      double lo, hi;
+      heatmap->range(lo, hi);
+      std::printf("  heatmap: %d x %d cells, %.2f to %.2f ns per pixel, written to %s\n",
+                  heatmap->cols(), heatmap->rows(), lo, hi, heatmapPath);
+    }
+
+    if (kStatsEnabled)
+    {
+      std::printf("  hot path, all grades:\n");
+      stats.print(stdout, "    ");
+    }
+  }
+  catch (const std::exception& e)
+  {
+    std::fprintf(stderr, "GradeAOVRegrade: %s\n", e.what());
+    return 1;
+  }
+
+  return 0;
+}
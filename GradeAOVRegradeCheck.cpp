@@ -0,0 +1,612 @@
+// ============================================================================
+// GradeAOVRegradeCheck — round trip check of GradeAOVRegrade --patch
+// Writes a multi-part EXR (HALF, FLOAT and UINT channels), regrades it with
+// GradeAOVRegrade, scanline and tiled, and checks every part of the output
+// against the input and against the native port GradeAOVOpt.
+// ============================================================================
+
+// USAGE :
+//   GradeAOVRegradeCheck <GradeAOVRegrade> [-w width] [-h height] [--seed n]
+//                        [--dir path]
+//
+//   GradeAOVRegrade : the built tool, run with --patch on a scanline input
+//                     and with --patch --tiled on a tiled one
+//   -w / -h    : image size (default 437 x 251, no multiple of a chunk)
+//   --seed     : seed of the pixels (default 1)
+//   --dir      : where inputs, recipe and outputs are written (default .)
+//
+// Exits 1 when a check fails.
+//
+// MAJOR NOTES :
+// The input has five parts on one data window, offset from (0, 0) :
+//   rgba      R, G, B, A            HALF   beauty, graded
+//   diffuse   diffuse.R, .G, .B     FLOAT  graded by two chained grades
+//             diffuse.A             HALF   kept
+//             objectId              UINT   kept, random 32 bit IDs
+//   specular  specular.R, .G, .B, .A HALF  untouched
+//   id        id                    UINT   untouched
+//   matte     matte.A               HALF   mask of the first grade
+// Untouched parts must be copied chunk for chunk : their compressed chunks
+// are compared byte for byte. Re-encoded parts must keep every channel with
+// its type, the kept ones value for value (IDs above 2^24 don't survive a
+// float round trip, objectId catches a UINT channel read as FLOAT).
+// The beauty and diffuse.RGB must be GradeAOVOpt::processRowPlanar() run
+// on the decoded input with the recipe's knobs, rounded to the channel
+// type, bit for bit : build both tools with the same flags (no
+// -march=native, GCC contracts FMAs differently in the two).
+//
+// BUILD :
+//   g++ -O3 -std=c++17 GradeAOVRegradeCheck.cpp -o GradeAOVRegradeCheck
+//       $(pkg-config --cflags --libs OpenEXR)
+//   ./GradeAOVRegradeCheck ./GradeAOVRegrade
+
+#include "GradeAOVHalf.h"
+#include "GradeAOVNative.h"
+
+#include <OpenEXR/ImfChannelList.h>
+#include <OpenEXR/ImfCompression.h>
+#include <OpenEXR/ImfFrameBuffer.h>
+#include <OpenEXR/ImfHeader.h>
+#include <OpenEXR/ImfInputPart.h>
+#include <OpenEXR/ImfMultiPartInputFile.h>
+#include <OpenEXR/ImfMultiPartOutputFile.h>
+#include <OpenEXR/ImfOutputPart.h>
+#include <OpenEXR/ImfPartType.h>
+#include <OpenEXR/ImfTileDescription.h>
+#include <OpenEXR/ImfTiledInputPart.h>
+#include <OpenEXR/ImfTiledOutputPart.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace GradeAOV;
+
+namespace
+{
+
+// Tile size of the tiled input
+constexpr int kTile = 64;
+
+// -----------------------------
+// SYNTHETIC CHANNELS
+// -----------------------------
+
+size_t typeSize(Imf::PixelType type)
+{
+  return type == Imf::HALF ? 2 : 4;
+}
+
+// One channel, pixels packed row after row in the channel's own type
+struct Chan
+{
+  std::string name;
+  Imf::PixelType type = Imf::HALF;
+  std::vector<char> data;
+
+  // Pixel i as GradeAOVRegrade decodes it (HALF / FLOAT channels only)
+  float value(size_t i) const
+  {
+    if (type == Imf::HALF)
+    {
+      uint16_t h;
+      std::memcpy(&h, data.data() + 2 * i, 2);
+      return halfToFloat(h);
+    }
+    float f;
+    std::memcpy(&f, data.data() + 4 * i, 4);
+    return f;
+  }
+
+  // Store v in the channel's type, rounded like OpenEXR does
+  void set(size_t i, float v)
+  {
+    if (type == Imf::HALF)
+    {
+      const uint16_t h = floatToHalf(v);
+      std::memcpy(data.data() + 2 * i, &h, 2);
+    }
+    else
+      std::memcpy(data.data() + 4 * i, &v, 4);
+  }
+};
+
+struct Part
+{
+  std::string name;
+  Imf::Compression compression = Imf::ZIP_COMPRESSION;
+  std::vector<Chan> channels;
+
+  Chan& chan(const std::string& n)
+  {
+    for (Chan& c : channels)
+      if (c.name == n)
+        return c;
+    throw std::runtime_error("no channel " + n);
+  }
+};
+
+// The five parts of the input, random pixels
+std::vector<Part> makeInput(size_t pixels, uint32_t seed)
+{
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+  auto chan = [&](const std::string& name, Imf::PixelType type, float lo, float hi,
+                  float zeros = 0.0f, float ones = 0.0f)
+  {
+    Chan c;
+    c.name = name;
+    c.type = type;
+    c.data.resize(pixels * typeSize(type));
+    for (size_t i = 0; i < pixels; i++)
+    {
+      if (type == Imf::UINT)
+      {
+        const uint32_t id = uint32_t(rng());
+        std::memcpy(c.data.data() + 4 * i, &id, 4);
+        continue;
+      }
+      const float r = unit(rng);
+      c.set(i, r < zeros ? 0.0f : r < zeros + ones ? 1.0f : lo + (hi - lo) * unit(rng));
+    }
+    return c;
+  };
+
+  std::vector<Part> parts(5);
+  parts[0].name = "rgba";
+  parts[0].channels = {chan("R", Imf::HALF, 0.0f, 2.0f), chan("G", Imf::HALF, 0.0f, 2.0f),
+                       chan("B", Imf::HALF, 0.0f, 2.0f), chan("A", Imf::HALF, 0.0f, 1.0f, 0.1f)};
+
+  parts[1].name = "diffuse";
+  parts[1].compression = Imf::ZIPS_COMPRESSION;
+  parts[1].channels = {chan("diffuse.R", Imf::FLOAT, -0.05f, 1.2f),
+                       chan("diffuse.G", Imf::FLOAT, -0.05f, 1.2f),
+                       chan("diffuse.B", Imf::FLOAT, -0.05f, 1.2f),
+                       chan("diffuse.A", Imf::HALF, 0.0f, 1.0f, 0.1f),
+                       chan("objectId", Imf::UINT, 0.0f, 0.0f)};
+
+  parts[2].name = "specular";
+  parts[2].compression = Imf::PIZ_COMPRESSION;
+  parts[2].channels = {chan("specular.R", Imf::HALF, 0.0f, 4.0f),
+                       chan("specular.G", Imf::HALF, 0.0f, 4.0f),
+                       chan("specular.B", Imf::HALF, 0.0f, 4.0f),
+                       chan("specular.A", Imf::HALF, 0.0f, 1.0f)};
+
+  parts[3].name = "id";
+  parts[3].compression = Imf::RLE_COMPRESSION;
+  parts[3].channels = {chan("id", Imf::UINT, 0.0f, 0.0f)};
+
+  parts[4].name = "matte";
+  parts[4].channels = {chan("matte.A", Imf::HALF, 0.0f, 1.0f, 0.3f, 0.3f)};
+  return parts;
+}
+
+// -----------------------------
+// RECIPE
+// Grades of the diffuse layer, knobs by label. The first one is masked
+// by matte (its alpha).
+// -----------------------------
+struct Knob
+{
+  const char* name;
+  std::vector<float> values;
+};
+
+struct RecipeGrade
+{
+  const char* mask;
+  std::vector<Knob> knobs;
+};
+
+const std::vector<RecipeGrade>& recipe()
+{
+  static const std::vector<RecipeGrade> grades = {
+    {"matte", {{"gain", {1.3f, 1.1f, 0.9f}}, {"gamma", {0.8f, 1.0f, 1.25f}}, {"mix", {0.9f}},
+               {"(un)premult", {1.0f}}}},
+    {nullptr, {{"multiply", {0.7f}}, {"lift", {0.02f}}, {"black clamp", {1.0f}}}},
+  };
+  return grades;
+}
+
+void writeRecipe(const std::string& path)
+{
+  FILE* f = std::fopen(path.c_str(), "w");
+  if (!f)
+    throw std::runtime_error("cannot write " + path);
+
+  std::fprintf(f, "{\n  \"beauty\": \"\",\n  \"grades\": [\n");
+  for (size_t g = 0; g < recipe().size(); g++)
+  {
+    const RecipeGrade& grade = recipe()[g];
+    std::fprintf(f, "    { \"layer\": \"diffuse\"");
+    if (grade.mask)
+      std::fprintf(f, ", \"mask\": \"%s\"", grade.mask);
+    for (const Knob& k : grade.knobs)
+    {
+      // %.9g : the float read back is the one set here
+      std::fprintf(f, ", \"%s\": [", k.name);
+      for (size_t i = 0; i < k.values.size(); i++)
+        std::fprintf(f, "%s%.9g", i ? ", " : "", double(k.values[i]));
+      std::fprintf(f, "]");
+    }
+    std::fprintf(f, " }%s\n", g + 1 < recipe().size() ? "," : "");
+  }
+  std::fprintf(f, "  ]\n}\n");
+  std::fclose(f);
+}
+
+// -----------------------------
+// EXPECTED OUTPUT
+// The recipe run by GradeAOVOpt on the decoded input, the beauty and
+// diffuse.RGB stored back in their own types
+// -----------------------------
+std::vector<Part> expectedOutput(std::vector<Part> parts, size_t pixels)
+{
+  std::vector<std::vector<float>> beauty(4), diffuse(4);
+  std::vector<float> matte(pixels);
+  for (int c = 0; c < 4; c++)
+  {
+    beauty[c].resize(pixels);
+    diffuse[c].resize(pixels);
+    for (size_t i = 0; i < pixels; i++)
+    {
+      beauty[c][i]  = parts[0].channels[c].value(i);
+      diffuse[c][i] = parts[1].channels[c].value(i);
+    }
+  }
+  for (size_t i = 0; i < pixels; i++)
+    matte[i] = parts[4].channels[0].value(i);
+
+  for (const RecipeGrade& grade : recipe())
+  {
+    GradeAOVOpt op;
+    for (const Knob& k : grade.knobs)
+      if (!op.setParam(k.name, k.values.data(), int(k.values.size())))
+        throw std::runtime_error(std::string("bad knob ") + k.name);
+    op.useMask = grade.mask != nullptr;
+    op.init();
+
+    const float* src[4] = {beauty[0].data(), beauty[1].data(), beauty[2].data(), beauty[3].data()};
+    const float* aov[4] = {diffuse[0].data(), diffuse[1].data(), diffuse[2].data(),
+                           diffuse[3].data()};
+    float* const dst[4] = {beauty[0].data(), beauty[1].data(), beauty[2].data(), beauty[3].data()};
+    float* const graded[3] = {diffuse[0].data(), diffuse[1].data(), diffuse[2].data()};
+    op.processRowPlanar(src, aov, grade.mask ? matte.data() : nullptr, dst, int(pixels), graded);
+  }
+
+  for (size_t i = 0; i < pixels; i++)
+  {
+    for (int c = 0; c < 4; c++)
+      parts[0].channels[c].set(i, beauty[c][i]);
+    for (int c = 0; c < 3; c++)
+      parts[1].channels[c].set(i, diffuse[c][i]);
+  }
+  return parts;
+}
+
+// -----------------------------
+// EXR FILES
+// -----------------------------
+
+// Frame buffer over a part's channels, in their own types
+Imf::FrameBuffer frameBuffer(Part& part, const Imath::Box2i& dw)
+{
+  const int width = dw.max.x - dw.min.x + 1;
+
+  Imf::FrameBuffer fb;
+  for (Chan& c : part.channels)
+  {
+    const size_t xStride = typeSize(c.type);
+    const size_t yStride = xStride * width;
+    fb.insert(c.name.c_str(), Imf::Slice(c.type, c.data.data() - dw.min.x * xStride
+                                                  - dw.min.y * yStride, xStride, yStride));
+  }
+  return fb;
+}
+
+void writeInput(const std::string& path, std::vector<Part>& parts, const Imath::Box2i& display,
+                const Imath::Box2i& dw, bool tiled)
+{
+  std::vector<Imf::Header> headers;
+  for (const Part& part : parts)
+  {
+    Imf::Header h(display, dw);
+    h.setName(part.name);
+    h.compression() = part.compression;
+    for (const Chan& c : part.channels)
+      h.channels().insert(c.name.c_str(), Imf::Channel(c.type));
+    if (tiled)
+    {
+      h.setTileDescription(Imf::TileDescription(kTile, kTile, Imf::ONE_LEVEL));
+      h.setType(Imf::TILEDIMAGE);
+    }
+    else
+      h.setType(Imf::SCANLINEIMAGE);
+    headers.push_back(h);
+  }
+
+  Imf::MultiPartOutputFile file(path.c_str(), headers.data(), int(headers.size()));
+  for (size_t p = 0; p < parts.size(); p++)
+  {
+    if (tiled)
+    {
+      Imf::TiledOutputPart out(file, int(p));
+      out.setFrameBuffer(frameBuffer(parts[p], dw));
+      out.writeTiles(0, out.numXTiles() - 1, 0, out.numYTiles() - 1);
+    }
+    else
+    {
+      Imf::OutputPart out(file, int(p));
+      out.setFrameBuffer(frameBuffer(parts[p], dw));
+      out.writePixels(dw.max.y - dw.min.y + 1);
+    }
+  }
+}
+
+// Part named name, -1 if missing
+int findPart(const Imf::MultiPartInputFile& file, const std::string& name)
+{
+  for (int p = 0; p < file.parts(); p++)
+    if (file.header(p).hasName() && file.header(p).name() == name)
+      return p;
+  return -1;
+}
+
+// Every channel of part p decoded in its own type
+void readPart(Imf::MultiPartInputFile& file, int p, Part& part, const Imath::Box2i& dw)
+{
+  if (file.header(p).hasTileDescription())
+  {
+    Imf::TiledInputPart in(file, p);
+    in.setFrameBuffer(frameBuffer(part, dw));
+    in.readTiles(0, in.numXTiles() - 1, 0, in.numYTiles() - 1);
+  }
+  else
+  {
+    Imf::InputPart in(file, p);
+    in.setFrameBuffer(frameBuffer(part, dw));
+    in.readPixels(dw.min.y, dw.max.y);
+  }
+}
+
+// Compressed chunks of part pa of a and pb of b that differ, out of chunks
+long rawChunksDiffer(Imf::MultiPartInputFile& a, int pa, Imf::MultiPartInputFile& b, int pb,
+                     long& chunks)
+{
+  const Imf::Header& h = a.header(pa);
+  const Imath::Box2i& dw = h.dataWindow();
+  long differ = 0;
+  chunks = 0;
+
+  auto same = [](const char* x, int xSize, const char* y, int ySize)
+  {
+    return xSize == ySize && std::memcmp(x, y, size_t(xSize)) == 0;
+  };
+
+  if (h.hasTileDescription())
+  {
+    Imf::TiledInputPart ia(a, pa);
+    Imf::TiledInputPart ib(b, pb);
+    for (int ty = 0; ty < ia.numYTiles(); ty++)
+      for (int tx = 0; tx < ia.numXTiles(); tx++)
+      {
+        const char* x;
+        const char* y;
+        int xSize, ySize;
+        int dx = tx, dy = ty, lx = 0, ly = 0;
+        ia.rawTileData(dx, dy, lx, ly, x, xSize);
+        dx = tx, dy = ty, lx = 0, ly = 0;
+        ib.rawTileData(dx, dy, lx, ly, y, ySize);
+        differ += !same(x, xSize, y, ySize);
+        chunks++;
+      }
+  }
+  else
+  {
+    Imf::InputPart ia(a, pa);
+    Imf::InputPart ib(b, pb);
+    const int lines = Imf::getCompressionNumScanlines(h.compression());
+    for (int line = dw.min.y; line <= dw.max.y; line += lines)
+    {
+      const char* x;
+      const char* y;
+      int xSize, ySize;
+      ia.rawPixelData(line, x, xSize);
+      ib.rawPixelData(line, y, ySize);
+      differ += !same(x, xSize, y, ySize);
+      chunks++;
+    }
+  }
+  return differ;
+}
+
+// -----------------------------
+// CHECK ONE REGRADED FILE
+// Returns the number of failed parts
+// -----------------------------
+int checkOutput(const std::string& inPath, const std::string& outPath,
+                const std::vector<Part>& expected, const Imath::Box2i& dw, const char* mode)
+{
+  Imf::MultiPartInputFile in(inPath.c_str());
+  Imf::MultiPartInputFile out(outPath.c_str());
+  const size_t pixels = size_t(dw.max.x - dw.min.x + 1) * (dw.max.y - dw.min.y + 1);
+
+  int failed = 0;
+  if (out.parts() != in.parts())
+  {
+    std::printf("%-9s %d part(s) written, %d expected\n", mode, out.parts(), in.parts());
+    failed++;
+  }
+
+  for (const Part& want : expected)
+  {
+    const int pi = findPart(in, want.name);
+    const int po = findPart(out, want.name);
+    if (po < 0)
+    {
+      std::printf("%-9s %-9s missing\n", mode, want.name.c_str());
+      failed++;
+      continue;
+    }
+
+    // Same channels, same types
+    const Imf::ChannelList& channels = out.header(po).channels();
+    size_t count = 0;
+    bool sameChannels = true;
+    for (Imf::ChannelList::ConstIterator c = channels.begin(); c != channels.end(); ++c, ++count)
+    {
+      const Imf::Channel* orig = in.header(pi).channels().findChannel(c.name());
+      sameChannels = sameChannels && orig && orig->type == c.channel().type;
+    }
+    if (!sameChannels || count != want.channels.size())
+    {
+      std::printf("%-9s %-9s channels or channel types changed\n", mode, want.name.c_str());
+      failed++;
+      continue;
+    }
+
+    // Untouched parts : same compressed chunks
+    const bool regraded = want.name == "rgba" || want.name == "diffuse";
+    if (!regraded)
+    {
+      long chunks = 0;
+      const long differ = rawChunksDiffer(in, pi, out, po, chunks);
+      std::printf("%-9s %-9s copied      %ld of %ld chunk(s) differ\n", mode, want.name.c_str(),
+                  differ, chunks);
+      failed += differ != 0;
+      continue;
+    }
+
+    // Re-encoded parts : every value in the channel's own type
+    Part got = want;
+    readPart(out, po, got, dw);
+
+    long differ = 0;
+    for (size_t c = 0; c < want.channels.size(); c++)
+    {
+      const Chan& w = want.channels[c];
+      const Chan& g = got.channels[c];
+      const size_t size = typeSize(w.type);
+      for (size_t i = 0; i < pixels; i++)
+        if (std::memcmp(w.data.data() + i * size, g.data.data() + i * size, size))
+        {
+          if (!differ++)
+          {
+            if (w.type == Imf::UINT)
+            {
+              uint32_t a, b;
+              std::memcpy(&a, w.data.data() + i * size, 4);
+              std::memcpy(&b, g.data.data() + i * size, 4);
+              std::printf("%-9s %-9s %s pixel %zu : %u instead of %u\n", mode, want.name.c_str(),
+                          w.name.c_str(), i, b, a);
+            }
+            else
+              std::printf("%-9s %-9s %s pixel %zu : %.9g instead of %.9g\n", mode,
+                          want.name.c_str(), w.name.c_str(), i, double(g.value(i)),
+                          double(w.value(i)));
+          }
+        }
+    }
+    std::printf("%-9s %-9s re-encoded  %ld of %zu value(s) differ\n", mode, want.name.c_str(),
+                differ, pixels * want.channels.size());
+    failed += differ != 0;
+  }
+  return failed;
+}
+
+} // namespace
+
+// -----------------------------
+// MAIN
+// -----------------------------
+int main(int argc, char* argv[])
+{
+  if (argc < 2 || argv[1][0] == '-')
+  {
+    std::fprintf(stderr, "usage: %s <GradeAOVRegrade> [-w width] [-h height] [--seed n]"
+                         " [--dir path]\n", argv[0]);
+    return 2;
+  }
+
+  const std::string tool = argv[1];
+  int width = 437;
+  int height = 251;
+  uint32_t seed = 1;
+  std::string dir = ".";
+
+  for (int i = 2; i < argc; i++)
+  {
+    if (!std::strcmp(argv[i], "-w") && i + 1 < argc)
+      width = std::atoi(argv[++i]);
+    else if (!std::strcmp(argv[i], "-h") && i + 1 < argc)
+      height = std::atoi(argv[++i]);
+    else if (!std::strcmp(argv[i], "--seed") && i + 1 < argc)
+      seed = uint32_t(std::strtoul(argv[++i], nullptr, 10));
+    else if (!std::strcmp(argv[i], "--dir") && i + 1 < argc)
+      dir = argv[++i];
+    else
+    {
+      std::fprintf(stderr, "unknown option %s\n", argv[i]);
+      return 2;
+    }
+  }
+
+  try
+  {
+    if (width <= 0 || height <= 0)
+      throw std::runtime_error("bad image size");
+
+    // Data window off the origin, as renders with overscan have
+    const Imath::Box2i display(Imath::V2i(0, 0), Imath::V2i(width - 1, height - 1));
+    const Imath::Box2i dw(Imath::V2i(-7, 5), Imath::V2i(width - 8, height + 4));
+    const size_t pixels = size_t(width) * height;
+
+    std::vector<Part> input = makeInput(pixels, seed);
+    const std::vector<Part> expected = expectedOutput(input, pixels);
+
+    const std::string recipePath = dir + "/regrade_recipe.json";
+    writeRecipe(recipePath);
+
+    std::printf("GradeAOVRegradeCheck: %d x %d, %zu part(s), seed %u\n", width, height,
+                input.size(), unsigned(seed));
+
+    int failed = 0;
+    for (const bool tiled : {false, true})
+    {
+      const char* mode = tiled ? "tiled" : "scanline";
+      const std::string inPath  = dir + "/regrade_in_" + mode + ".exr";
+      const std::string outPath = dir + "/regrade_out_" + mode + ".exr";
+      writeInput(inPath, input, display, dw, tiled);
+
+      const std::string cmd = "\"" + tool + "\" \"" + recipePath + "\" \"" + inPath + "\" \"" +
+                              outPath + "\" --patch" + (tiled ? " --tiled" : "") + " > /dev/null";
+      if (std::system(cmd.c_str()) != 0)
+      {
+        std::printf("%-9s GradeAOVRegrade failed : %s\n", mode, cmd.c_str());
+        failed++;
+        continue;
+      }
+      failed += checkOutput(inPath, outPath, expected, dw, mode);
+    }
+
+    if (failed)
+    {
+      std::printf("%d check(s) failed\n", failed);
+      return 1;
+    }
+    std::printf("all parts match\n");
+  }
+  catch (const std::exception& e)
+  {
+    std::fprintf(stderr, "GradeAOVRegradeCheck: %s\n", e.what());
+    return 1;
+  }
+
+  return 0;
+}
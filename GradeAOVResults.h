@@ -0,0 +1,391 @@
+// ============================================================================
+// GradeAOVResults — benchmark results files and regression comparison
+// Stores every timed repetition of every kernel with the machine it ran
+// on, and compares a run against a stored baseline with Welch's t-test.
+// ============================================================================
+
+// MAJOR NOTES :
+// A kernel regresses when its mean throughput dropped by more than the
+// threshold AND the 95% confidence interval of that drop excludes 0 (the
+// drop is not noise). Throughput is bytes over mean time : a 10% drop is
+// an 11.1% longer time. Kernels that sped up, or changed within noise,
+// pass. Kernels missing from either file are listed, not failed, and so
+// are kernels with fewer than 2 samples on either side (no variance, one
+// noisy pass would decide) : "not judged", run with -r 2 or more.
+// Kernels are matched by name, which must not depend on the build or the
+// run : what does (SIMD width, the prefetch distance picked) goes in the
+// kernel's params, compared and warned about like the machine metadata.
+// Comparing runs from different machines, builds or frame sizes is allowed
+// but warned about : the numbers only mean something on the same setup.
+//
+// RESULTS :
+//   {
+//     "machine": { "host": "farm-a12", "cpu": "...", "threads": 32, ... },
+//     "kernels": [
+//       { "name": "plain", "bytes": 2123366400, "samples_ms": [41.2, 41.9, ...] },
+//       { "name": "simd", "params": { "backend": "stdx", "width": "16" }, ... }
+//     ]
+//   }
+
+#pragma once
+
+#include "GradeAOVJson.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__) || defined(__APPLE__)
+#include <sys/utsname.h>
+#endif
+
+namespace GradeAOV
+{
+
+// Build or run dependent details of a kernel, as strings
+using KernelParams = std::vector<std::pair<std::string, std::string>>;
+
+struct KernelResult
+{
+  // Same kernel, same name, whatever the build
+  std::string name;
+
+  // Bytes one repetition moves, for throughput
+  double bytes = 0.0;
+
+  // Every timed repetition, in seconds
+  std::vector<double> samples;
+
+  KernelParams params;
+};
+
+struct RunResults
+{
+  // Machine and build metadata, as strings
+  std::vector<std::pair<std::string, std::string>> machine;
+  std::vector<KernelResult> kernels;
+
+  const std::string* meta(const std::string& key) const
+  {
+    for (const auto& kv : machine)
+      if (kv.first == key)
+        return &kv.second;
+    return nullptr;
+  }
+
+  const KernelResult* kernel(const std::string& name) const
+  {
+    for (const KernelResult& k : kernels)
+      if (k.name == name)
+        return &k;
+    return nullptr;
+  }
+};
+
+// -----------------------------
+// STATISTICS
+// -----------------------------
+inline double sampleMean(const std::vector<double>& v)
+{
+  double sum = 0.0;
+  for (double x : v)
+    sum += x;
+  return v.empty() ? 0.0 : sum / v.size();
+}
+
+inline double sampleVariance(const std::vector<double>& v)
+{
+  if (v.size() < 2)
+    return 0.0;
+  const double m = sampleMean(v);
+  double sum = 0.0;
+  for (double x : v)
+    sum += (x - m) * (x - m);
+  return sum / (v.size() - 1);
+}
+
+// Two-sided 95% quantile of Student's t : the tables up to 30 degrees of
+// freedom (linear in between, on the wide side), a Cornish-Fisher
+// expansion above (within 0.01% of the tables there)
+inline double tQuantile95(double df)
+{
+  static const double table[31] = {
+    0.0,    12.7062, 4.3027, 3.1824, 2.7764, 2.5706, 2.4469, 2.3646, 2.3060, 2.2622, 2.2281,
+    2.2010, 2.1788,  2.1604, 2.1448, 2.1314, 2.1199, 2.1098, 2.1009, 2.0930, 2.0860,
+    2.0796, 2.0739,  2.0687, 2.0639, 2.0595, 2.0555, 2.0518, 2.0484, 2.0452, 2.0423};
+  if (df < 1.0)
+    df = 1.0;
+  if (df < 30.0)
+  {
+    const int i = int(df);
+    const double f = df - i;
+    return table[i] + (table[i + 1] - table[i]) * f;
+  }
+
+  const double z = 1.959964;
+  const double z3 = z * z * z, z5 = z3 * z * z, z7 = z5 * z * z;
+  return z + (z3 + z) / (4.0 * df) + (5.0 * z5 + 16.0 * z3 + 3.0 * z) / (96.0 * df * df) +
+         (3.0 * z7 + 19.0 * z5 + 17.0 * z3 - 15.0 * z) / (384.0 * df * df * df);
+}
+
+// Throughput change base / new mean time - 1 (> 0 is faster) and its 95%
+// half interval : delta method on the ratio of the means, Welch's degrees
+// of freedom on their relative variances. Both sides need 2 samples or
+// more for a meaningful interval.
+inline std::pair<double, double> throughputInterval(const std::vector<double>& base,
+                                                    const std::vector<double>& run)
+{
+  const double mb = sampleMean(base);
+  const double mr = sampleMean(run);
+  const double ratio = mb / mr;
+
+  // Squared relative standard errors of the two means
+  const double vb = sampleVariance(base) / std::max<size_t>(base.size(), 1) / (mb * mb);
+  const double vr = sampleVariance(run) / std::max<size_t>(run.size(), 1) / (mr * mr);
+
+  const double se = ratio * std::sqrt(vb + vr);
+  if (se <= 0.0)
+    return {ratio - 1.0, 0.0};
+
+  // Welch-Satterthwaite degrees of freedom
+  double df = 1.0;
+  if (base.size() > 1 && run.size() > 1)
+    df = (vb + vr) * (vb + vr) /
+         (vb * vb / (base.size() - 1) + vr * vr / (run.size() - 1));
+
+  return {ratio - 1.0, tQuantile95(df) * se};
+}
+
+// -----------------------------
+// MACHINE METADATA
+// -----------------------------
+inline std::vector<std::pair<std::string, std::string>> machineMetadata()
+{
+  std::vector<std::pair<std::string, std::string>> m;
+
+#if defined(__linux__) || defined(__APPLE__)
+  utsname u;
+  if (uname(&u) == 0)
+  {
+    m.emplace_back("host", u.nodename);
+    m.emplace_back("os", std::string(u.sysname) + " " + u.release);
+    m.emplace_back("arch", u.machine);
+  }
+#endif
+
+#if defined(__linux__)
+  std::ifstream cpuinfo("/proc/cpuinfo");
+  std::string line;
+  while (std::getline(cpuinfo, line))
+    if (line.compare(0, 10, "model name") == 0)
+    {
+      const size_t colon = line.find(':');
+      m.emplace_back("cpu", colon == std::string::npos ? line : line.substr(colon + 2));
+      break;
+    }
+#endif
+
+  m.emplace_back("hardware_threads", std::to_string(std::thread::hardware_concurrency()));
+
+#if defined(__VERSION__)
+  m.emplace_back("compiler", __VERSION__);
+#endif
+
+  std::string flags;
+#if defined(__OPTIMIZE__)
+  flags += " optimize";
+#endif
+#if defined(__AVX512F__)
+  flags += " avx512f";
+#elif defined(__AVX2__)
+  flags += " avx2";
+#elif defined(__SSE4_2__)
+  flags += " sse4.2";
+#endif
+#if defined(__FMA__)
+  flags += " fma";
+#endif
+#if defined(GRADEAOV_STATS)
+  flags += " stats";
+#endif
+  m.emplace_back("build", flags.empty() ? "default" : flags.substr(1));
+
+  char date[32];
+  const std::time_t now = std::time(nullptr);
+  std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+  m.emplace_back("date", date);
+
+  return m;
+}
+
+// -----------------------------
+// WRITE / READ
+// Throw std::runtime_error.
+// -----------------------------
+inline void writeResults(const RunResults& r, const std::string& path)
+{
+  std::ofstream out(path);
+  if (!out)
+    throw std::runtime_error("cannot write " + path);
+
+  out << "{\n  \"machine\": {";
+  for (size_t i = 0; i < r.machine.size(); i++)
+    out << (i ? ",\n    " : "\n    ") << jsonQuote(r.machine[i].first) << ": "
+        << jsonQuote(r.machine[i].second);
+  out << "\n  },\n  \"kernels\": [";
+
+  char number[64];
+  for (size_t k = 0; k < r.kernels.size(); k++)
+  {
+    const KernelResult& kr = r.kernels[k];
+    std::snprintf(number, sizeof(number), "%.0f", kr.bytes);
+    out << (k ? ",\n    " : "\n    ") << "{\"name\": " << jsonQuote(kr.name);
+    if (!kr.params.empty())
+    {
+      out << ", \"params\": {";
+      for (size_t i = 0; i < kr.params.size(); i++)
+        out << (i ? ", " : "") << jsonQuote(kr.params[i].first) << ": "
+            << jsonQuote(kr.params[i].second);
+      out << "}";
+    }
+    out << ", \"bytes\": " << number << ", \"samples_ms\": [";
+    for (size_t i = 0; i < kr.samples.size(); i++)
+    {
+      std::snprintf(number, sizeof(number), "%.4f", kr.samples[i] * 1e3);
+      out << (i ? ", " : "") << number;
+    }
+    out << "]}";
+  }
+  out << "\n  ]\n}\n";
+
+  if (!out)
+    throw std::runtime_error("cannot write " + path);
+}
+
+inline RunResults readResults(const std::string& path)
+{
+  const Json j = parseJsonFile(path);
+  const Json* machine = j.find("machine");
+  const Json* kernels = j.find("kernels");
+  if (!kernels || kernels->type != Json::Array)
+    throw std::runtime_error(path + ": not a GradeAOVBench results file");
+
+  RunResults r;
+  if (machine)
+    for (const auto& kv : machine->o)
+      r.machine.emplace_back(kv.first, kv.second.type == Json::String ? kv.second.s
+                                                                      : std::to_string(kv.second.n));
+
+  for (const Json& k : kernels->a)
+  {
+    const Json* name    = k.find("name");
+    const Json* bytes   = k.find("bytes");
+    const Json* samples = k.find("samples_ms");
+    if (!name || !bytes || !samples || samples->type != Json::Array)
+      throw std::runtime_error(path + ": malformed kernel entry");
+
+    KernelResult kr;
+    kr.name  = name->s;
+    kr.bytes = bytes->n;
+    for (const Json& s : samples->a)
+      kr.samples.push_back(s.n * 1e-3);
+    if (const Json* params = k.find("params"))
+      for (const auto& kv : params->o)
+        kr.params.emplace_back(kv.first, kv.second.type == Json::String
+                                           ? kv.second.s : std::to_string(kv.second.n));
+    r.kernels.push_back(kr);
+  }
+  return r;
+}
+
+// -----------------------------
+// COMPARE A RUN AGAINST A BASELINE
+// Prints one line per kernel, returns false if any kernel regressed by
+// more than thresholdPercent (see MAJOR NOTES).
+// -----------------------------
+inline bool compareResults(const RunResults& base, const RunResults& run,
+                           double thresholdPercent, FILE* out)
+{
+  for (const char* key : {"host", "cpu", "build", "threads", "frame", "seed"})
+  {
+    const std::string* a = base.meta(key);
+    const std::string* b = run.meta(key);
+    if (a && b && *a != *b)
+      std::fprintf(out, "warning: %s differs (%s vs %s)\n", key, a->c_str(), b->c_str());
+  }
+
+  std::fprintf(out, "%-26s %10s %10s %9s %17s  %s\n", "kernel", "base GB/s", "new GB/s",
+               "speed", "95% CI", "verdict");
+
+  bool pass = true;
+  for (const KernelResult& k : run.kernels)
+  {
+    const KernelResult* b = base.kernel(k.name);
+    if (!b || b->samples.empty() || k.samples.empty())
+    {
+      std::fprintf(out, "%-26s %10s %10s %9s %17s  new kernel\n", k.name.c_str(), "-", "-",
+                   "-", "-");
+      continue;
+    }
+
+    // Same kernel, built or tuned differently
+    for (const auto& kv : k.params)
+    {
+      const std::string* was = nullptr;
+      for (const auto& bkv : b->params)
+        if (bkv.first == kv.first)
+          was = &bkv.second;
+      if (was && *was != kv.second)
+        std::fprintf(out, "warning: %s %s differs (%s vs %s)\n", k.name.c_str(),
+                     kv.first.c_str(), was->c_str(), kv.second.c_str());
+    }
+
+    const double baseMean = sampleMean(b->samples);
+    const double runMean  = sampleMean(k.samples);
+    if (b->samples.size() < 2 || k.samples.size() < 2)
+    {
+      std::fprintf(out, "%-26s %10.2f %10.2f %+8.1f%% %17s  not judged (< 2 samples)\n",
+                   k.name.c_str(), b->bytes / baseMean * 1e-9, k.bytes / runMean * 1e-9,
+                   100.0 * (baseMean / runMean - 1.0), "-");
+      continue;
+    }
+
+    const std::pair<double, double> ci = throughputInterval(b->samples, k.samples);
+
+    // Throughput change in %, > 0 is faster
+    const double change   = 100.0 * ci.first;
+    const double changeLo = 100.0 * (ci.first - ci.second);
+    const double changeHi = 100.0 * (ci.first + ci.second);
+
+    const char* verdict = "ok";
+    if (changeHi < 0.0 && change < -thresholdPercent)
+    {
+      verdict = "REGRESSION";
+      pass = false;
+    }
+    else if (changeHi < 0.0)
+      verdict = "slower (within threshold)";
+    else if (changeLo > 0.0)
+      verdict = "faster";
+
+    char interval[64];
+    std::snprintf(interval, sizeof(interval), "[%+.1f, %+.1f]%%", changeLo, changeHi);
+    std::fprintf(out, "%-26s %10.2f %10.2f %+8.1f%% %17s  %s\n", k.name.c_str(),
+                 b->bytes / baseMean * 1e-9, k.bytes / runMean * 1e-9, change, interval, verdict);
+  }
+
+  for (const KernelResult& b : base.kernels)
+    if (!run.kernel(b.name))
+      std::fprintf(out, "%-26s missing from the new run\n", b.name.c_str());
+
+  return pass;
+}
+
+} // namespace GradeAOV
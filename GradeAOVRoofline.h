@@ -0,0 +1,215 @@
+// ============================================================================
+// GradeAOVRoofline — roofline model of the native grade
+// Peak FLOP/s of the machine, FLOPs and bytes per pixel of a grade setup,
+// and where the measured grade sits under min(peak, intensity x bandwidth).
+// ============================================================================
+
+// MAJOR NOTES :
+// FLOPs are counted from the grade's code paths, per pixel of the actual
+// frame (early-outs, pow segments, partial blends are data dependent) :
+// add, sub, mul and div count 1, a fused multiply-add 2, compares and
+// min / max 0, and one powf kPowFlops (a libm powf is some 20-40
+// instructions, 20 is the usual convention).
+// Bytes are the RGBA float streams the kernel asks for (16 bytes each for
+// src, aov, dst, and mask when it is read), counted like STREAM.
+// The peak is a register-only FMA loop on every thread, vectorized for
+// the build's ISA (-march=native) : a build without FMA / AVX measures a
+// lower roof than the silicon has, on purpose, it is the roof this build
+// can reach.
+// Left of the ridge (intensity < peak / bandwidth) a variant is memory
+// bound : half floats or fewer channels pay, cheaper maths does not.
+
+#pragma once
+
+#include "GradeAOVImage.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+namespace GradeAOV
+{
+
+constexpr double kPowFlops = 20.0;
+
+// -----------------------------
+// FLOPS PER PIXEL
+// Mirrors GradeAOVOpt::grade() and composite(), keep in sync.
+// Every rowStep-th row is counted (the frame statistics are smooth).
+// -----------------------------
+inline double gammaFlops(const GradeAOVOpt& op, const float x[3], bool reverse)
+{
+  double flops = 0.0;
+  for (int i = 0; i < 3; i++)
+  {
+    const float g = op.gamma[i];
+    if (g <= 0.0f || g == 1.0f)
+      continue;
+    if (reverse ? x[i] <= 0.0f : x[i] < 0.0f)
+      continue;
+    // pow, or the 1 + (x - 1) * g tail
+    flops += (x[i] < 1.0f) ? kPowFlops : 3.0;
+  }
+  return flops;
+}
+
+inline double pixelFlops(const GradeAOVOpt& op, const float s[4], const float a[4], float mAlpha)
+{
+  // Composite : 3 sub + 3 add
+  double flops = 6.0;
+
+  if (op.mix <= 0.0f || mAlpha <= 0.0f)
+    return flops;
+
+  float x[3] = {a[0], a[1], a[2]};
+  if (op.unpremult)
+  {
+    // 1 div, 4 unpremult mul, 7 premult mul
+    const float invA = 1.0f / std::max(s[3], 1e-8f);
+    for (int i = 0; i < 3; i++)
+      x[i] *= invA;
+    flops += 12.0;
+  }
+
+  float lin[3];
+  if (!op.reverse)
+  {
+    // 3 FMA, clamps are min / max
+    for (int i = 0; i < 3; i++)
+    {
+      lin[i] = op.A[i] * x[i] + op.B[i];
+      if (op.black_clamp)
+        lin[i] = std::max(lin[i], 0.0f);
+      if (op.white_clamp)
+        lin[i] = std::min(lin[i], 1.0f);
+    }
+    flops += 6.0 + gammaFlops(op, lin, false);
+  }
+  else
+    flops += gammaFlops(op, x, true) + 6.0;
+
+  // mAlpha * mix, then 4 x (sub, mul, add) when partially blended
+  flops += 1.0;
+  if (mAlpha * op.mix < 1.0f)
+    flops += 12.0;
+
+  return flops;
+}
+
+// Mean FLOPs per pixel of op on these images (mask may be null)
+inline double countFlops(const GradeAOVOpt& op, const ImageView& src, const ImageView& aov,
+                         const ImageView* mask, int rowStep = 4)
+{
+  double flops = 0.0;
+  long pixels = 0;
+
+  auto at = [](const ImageView& v, int c, int y, int x)
+  {
+    const float* row = v.row(c, y);
+    return row ? *reinterpret_cast<const float*>(reinterpret_cast<const char*>(row) +
+                                                 x * v.pixelStride)
+               : 0.0f;
+  };
+
+  for (int y = 0; y < src.height; y += std::max(1, rowStep))
+    for (int x = 0; x < src.width; x++)
+    {
+      float s[4], a[4];
+      for (int c = 0; c < 4; c++)
+      {
+        s[c] = at(src, c, y, x);
+        a[c] = at(aov, c, y, x);
+      }
+      const float mAlpha = (op.useMask && mask) ? at(*mask, 3, y, x) : 1.0f;
+      flops += pixelFlops(op, s, a, mAlpha);
+      pixels++;
+    }
+
+  return pixels ? flops / pixels : 0.0;
+}
+
+// Bytes per pixel asked for by processRows() with op
+inline double pixelBytes(const GradeAOVOpt& op, bool maskGiven)
+{
+  return 16.0 * ((op.useMask && maskGiven) ? 4 : 3);
+}
+
+// -----------------------------
+// PEAK FLOP/S
+// -----------------------------
+namespace Roofline
+{
+
+// Independent FMA chains x vector width : enough chains to cover the FMA
+// latency on both ports, few enough to stay in registers
+#if defined(__AVX512F__)
+constexpr int kLanes = 8 * 16;
+#elif defined(__AVX__)
+constexpr int kLanes = 8 * 8;
+#else
+constexpr int kLanes = 8 * 4;
+#endif
+
+// FLOPs of iterations x kLanes multiply-adds, result kept alive in sink
+inline double fmaLoop(long iterations, float& sink)
+{
+  alignas(64) float acc[kLanes];
+  for (int i = 0; i < kLanes; i++)
+    acc[i] = float(i) * 1e-3f;
+
+  const float a = 0.999999f, b = 1e-7f;
+  for (long it = 0; it < iterations; it++)
+    for (int i = 0; i < kLanes; i++)
+      acc[i] = acc[i] * a + b;
+
+  float sum = 0.0f;
+  for (int i = 0; i < kLanes; i++)
+    sum += acc[i];
+  sink = sum;
+  return 2.0 * kLanes * double(iterations);
+}
+
+} // namespace Roofline
+
+// FLOP/s of threads threads running the FMA loop for about seconds
+inline double measurePeakFlops(int threads, double seconds = 0.25)
+{
+  threads = std::max(1, threads);
+  std::vector<double> flops(threads, 0.0);
+  std::vector<float> sinks(threads, 0.0f);
+
+  auto start = std::chrono::steady_clock::now();
+  auto elapsed = [&]
+  {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  };
+
+  auto work = [&](int t)
+  {
+    // Short chunks keep the stop check cheap and the end aligned
+    while (elapsed() < seconds)
+      flops[t] += Roofline::fmaLoop(1 << 16, sinks[t]);
+  };
+
+  std::vector<std::thread> pool;
+  for (int t = 1; t < threads; t++)
+    pool.emplace_back(work, t);
+  work(0);
+  for (std::thread& t : pool)
+    t.join();
+
+  const double wall = elapsed();
+  double total = 0.0;
+  for (int t = 0; t < threads; t++)
+    total += flops[t] + (sinks[t] == 12345.0f ? 1.0 : 0.0);
+  return total / wall;
+}
+
+// Attainable FLOP/s at an intensity (FLOPs per byte)
+inline double rooflineBound(double peakFlops, double bandwidth, double intensity)
+{
+  return std::min(peakFlops, intensity * bandwidth);
+}
+
+} // namespace GradeAOV
@@ -0,0 +1,465 @@
+// ============================================================================
+// GradeAOVSimd — the grade written once against a portable SIMD type
+// GradeAOVOpt's maths on native_simd<float> (std::experimental::simd : SSE,
+// AVX, AVX-512, NEON, whatever the compiler targets), or on a one lane
+// scalar type where that header is missing or GRADEAOV_SIMD_SCALAR is set.
+// ============================================================================
+
+// USAGE :
+//   GradeAOVOpt op; ... op.init();
+//   processRowsSimd(op, src, aov, &mask, dst, y0, y1);
+//
+// MAJOR NOTES :
+// Same results as GradeAOVNative.h, bit for bit, with either backend
+// (build with -ffp-contract=off, the compiler may otherwise fuse mul + add
+// differently in the scalar and the vector code) :
+//  - min / max are written as std::min / std::max are (NaN handling),
+//  - pow() is libm's, lane by lane, and only when a lane needs it,
+//  - knob branches (reverse, clamps, unpremult, gamma <= 0 / == 1) stay
+//    scalar branches, data branches become selects.
+// Stages only use the few operations of the SIMD SUBSET section : a new
+// stage written with them builds on both backends.
+// Row tails shorter than a vector go through GradeAOVOpt's own loops.
+//
+// BUILD :
+//   header only, g++ -std=c++17 (libstdc++ 11 or later for the simd backend)
+//   add -DGRADEAOV_SIMD_SCALAR for the scalar backend
+
+#pragma once
+
+#include "GradeAOVAlloc.h"
+#include "GradeAOVImage.h"
+#include "GradeAOVNative.h"
+
+#include <cmath>
+#include <cstddef>
+
+#if !defined(GRADEAOV_SIMD_SCALAR) && defined(__has_include)
+#if __has_include(<experimental/simd>)
+#include <experimental/simd>
+#define GRADEAOV_SIMD_STDX 1
+#endif
+#endif
+
+namespace GradeAOV
+{
+namespace Simd
+{
+
+// -----------------------------
+// BACKENDS
+// Float : lanes of float, Mask : lanes of bool, both with size() and
+// per lane operator[], arithmetic, comparisons and mask logic
+// -----------------------------
+#if defined(GRADEAOV_SIMD_STDX)
+
+namespace stdx = std::experimental;
+
+using Float = stdx::native_simd<float>;
+using Mask  = Float::mask_type;
+
+inline const char* backend() { return "stdx"; }
+
+inline Float load(const float* p) { return Float(p, stdx::element_aligned); }
+inline void store(const Float& v, float* p) { v.copy_to(p, stdx::element_aligned); }
+
+// Lane i is f(i)
+template <class F>
+inline Float generate(F f)
+{
+  return Float([&](auto i) { return f(int(i)); });
+}
+
+inline Float select(const Mask& m, const Float& a, const Float& b)
+{
+  Float r = b;
+  stdx::where(m, r) = a;
+  return r;
+}
+
+inline bool anyOf(const Mask& m) { return stdx::any_of(m); }
+inline bool allOf(const Mask& m) { return stdx::all_of(m); }
+
+#else
+
+// One lane, plain float maths
+struct Mask
+{
+  bool v = false;
+
+  Mask() = default;
+  Mask(bool b) : v(b) {}
+
+  static constexpr size_t size() { return 1; }
+  bool operator[](size_t) const { return v; }
+
+  friend Mask operator&&(Mask a, Mask b) { return a.v && b.v; }
+  friend Mask operator||(Mask a, Mask b) { return a.v || b.v; }
+  friend Mask operator!(Mask a) { return !a.v; }
+};
+
+struct Float
+{
+  float v = 0.0f;
+
+  Float() = default;
+  Float(float f) : v(f) {}
+
+  static constexpr size_t size() { return 1; }
+  float& operator[](size_t) { return v; }
+  float operator[](size_t) const { return v; }
+
+  friend Float operator+(Float a, Float b) { return a.v + b.v; }
+  friend Float operator-(Float a, Float b) { return a.v - b.v; }
+  friend Float operator*(Float a, Float b) { return a.v * b.v; }
+  friend Float operator/(Float a, Float b) { return a.v / b.v; }
+  friend Float operator-(Float a) { return -a.v; }
+
+  friend Mask operator<(Float a, Float b)  { return a.v < b.v; }
+  friend Mask operator<=(Float a, Float b) { return a.v <= b.v; }
+  friend Mask operator>(Float a, Float b)  { return a.v > b.v; }
+  friend Mask operator>=(Float a, Float b) { return a.v >= b.v; }
+};
+
+inline const char* backend() { return "scalar"; }
+
+inline Float load(const float* p) { return *p; }
+inline void store(const Float& v, float* p) { *p = v.v; }
+
+template <class F>
+inline Float generate(F f)
+{
+  return f(0);
+}
+
+inline Float select(const Mask& m, const Float& a, const Float& b) { return m.v ? a : b; }
+
+inline bool anyOf(const Mask& m) { return m.v; }
+inline bool allOf(const Mask& m) { return m.v; }
+
+#endif
+
+// Lanes per vector
+constexpr int kWidth = int(Float::size());
+
+// -----------------------------
+// SIMD SUBSET
+// Shared by both backends, what the stages below are written with
+// -----------------------------
+
+// std::min / std::max lane by lane (NaN a stays a, NaN b gives a)
+inline Float min(const Float& a, const Float& b) { return select(b < a, b, a); }
+inline Float max(const Float& a, const Float& b) { return select(a < b, b, a); }
+
+// std::pow(x, y) on the lanes of m, other lanes keep o
+inline Float powWhere(const Mask& m, const Float& x, float y, Float o)
+{
+  if (anyOf(m))
+    for (size_t i = 0; i < Float::size(); i++)
+      if (m[i])
+        o[i] = std::pow(float(x[i]), y);
+  return o;
+}
+
+// -----------------------------
+// GRADE
+// GradeAOVOpt::grade_rgb(), grade() and composite() on kWidth pixels,
+// channels in separate vectors
+// -----------------------------
+class Grade
+{
+public:
+  // op must have been init()ed and outlive the Grade
+  explicit Grade(const GradeAOVOpt& op) : _op(op) {}
+
+  // -----------------------------
+  // FORWARD GAMMA FUNCTION
+  // Nuke's piecewise behaviour, see GradeAOV.cpp
+  // -----------------------------
+  Float forwardGamma(const Float& x, int i) const
+  {
+    const float G = _op.gamma[i];
+
+    // gamma <= 0 : black / unchanged / "infinite" white
+    if (G <= 0.0f)
+      return select(x < 0.0f, Float(0.0f), select(x > 1.0f, Float(1e30f), x));
+
+    // gamma == 1 : no change
+    if (G == 1.0f)
+      return x;
+
+    // gamma != 1 : negative unchanged, pow curve, linear tail
+    const float ig = _op.invGamma[i];
+    const Float o = select(x < 1.0f, x, 1.0f + (x - 1.0f) * ig);
+    return powWhere(!(x < 0.0f) && x < 1.0f, x, ig, o);
+  }
+
+  // -----------------------------
+  // REVERSE GAMMA FUNCTION
+  // Inverse of forwardGamma
+  // -----------------------------
+  Float reverseGamma(const Float& x, int i) const
+  {
+    const float G = _op.gamma[i];
+
+    // gamma <= 0 : above 0 white, else black
+    if (G <= 0.0f)
+      return select(x > 0.0f, Float(1.0f), Float(0.0f));
+
+    // gamma == 1 : no change
+    if (G == 1.0f)
+      return x;
+
+    // gamma != 1 : <= 0 unchanged, pow curve, linear tail
+    const Float o = select(x < 1.0f, x, 1.0f + (x - 1.0f) * G);
+    return powWhere(!(x <= 0.0f) && x < 1.0f, x, G, o);
+  }
+
+  // -----------------------------
+  // GRADE RGB
+  // Linear stage + clamp + gamma (or the reverse), on RGB only
+  // -----------------------------
+  void gradeRGB(const Float x[3], Float y[3]) const
+  {
+    for (int i = 0; i < 3; i++)
+    {
+      // Forward : linear stage, clamps, forward gamma
+      if (!_op.reverse)
+      {
+        Float lin = _op.A[i] * x[i] + _op.B[i];
+        if (!_op.white_clamp && _op.black_clamp)
+          lin = max(lin, 0.0f);
+        else if (_op.white_clamp && !_op.black_clamp)
+          lin = min(lin, 1.0f);
+        else if (_op.white_clamp && _op.black_clamp)
+          lin = min(max(lin, 0.0f), 1.0f);
+        y[i] = forwardGamma(lin, i);
+      }
+      // Reverse : reverse gamma, reverse linear stage, clamps (black clamp wins)
+      else
+      {
+        Float rev = reverseGamma(x[i], i) * _op.Ainv[i] + _op.Brev[i];
+        if (_op.black_clamp)
+          rev = max(rev, 0.0f);
+        else if (_op.white_clamp)
+          rev = min(rev, 1.0f);
+        y[i] = rev;
+      }
+    }
+  }
+
+  // -----------------------------
+  // GRADE kWidth AOV PIXELS
+  // Writes the masked, premultiplied graded AOV
+  // -----------------------------
+  void grade(const Float s[4], const Float a[4], const Float& mAlpha, Float out[4]) const
+  {
+    // Early-out if nothing will be applied, for all lanes or some
+    const Mask keep = mAlpha <= 0.0f;
+    if (_op.mix <= 0.0f || allOf(keep))
+    {
+      for (int i = 0; i < 4; i++)
+        out[i] = a[i];
+      return;
+    }
+
+    // Premultiplied before/after grading values
+    Float original_pm[4], graded_pm[4];
+
+    if (_op.unpremult)
+    {
+      // Safe inverse alpha, unpremult the AOV
+      const Float invA = 1.0f / max(s[3], 1e-8f);
+      const Float x[3] = {a[0] * invA, a[1] * invA, a[2] * invA};
+      const Float linW = a[3] * invA;
+
+      Float y[3];
+      gradeRGB(x, y);
+
+      // Premult before and after grading
+      for (int i = 0; i < 3; i++)
+      {
+        original_pm[i] = x[i] * s[3];
+        graded_pm[i]   = y[i] * s[3];
+      }
+      original_pm[3] = graded_pm[3] = linW * s[3];
+    }
+    else
+    {
+      Float y[3];
+      gradeRGB(a, y);
+
+      for (int i = 0; i < 4; i++)
+        original_pm[i] = a[i];
+      for (int i = 0; i < 3; i++)
+        graded_pm[i] = y[i];
+      graded_pm[3] = a[3];
+    }
+
+    // Blend factor from mask alpha and mix knob
+    const Float t = min(1.0f, max(0.0f, mAlpha * _op.mix));
+    const Mask full = t >= 1.0f;
+
+    // Fully graded, or blend between original and graded, early-out lanes
+    // keep the AOV
+    for (int i = 0; i < 4; i++)
+      out[i] = select(keep, a[i],
+                      select(full, graded_pm[i],
+                             original_pm[i] + (graded_pm[i] - original_pm[i]) * t));
+  }
+
+  // -----------------------------
+  // PUT THE GRADED AOV BACK INTO THE BEAUTY
+  // -----------------------------
+  void composite(const Float s[4], const Float a[4], const Float g[4], Float d[4]) const
+  {
+    // viewaov replaces src with the graded AOV, else swaps the old AOV out
+    for (int i = 0; i < 3; i++)
+      d[i] = _op.viewaov ? (s[i] - s[i] + g[i]) : (s[i] - a[i] + g[i]);
+    d[3] = s[3];
+  }
+
+private:
+  const GradeAOVOpt& _op;
+};
+
+} // namespace Simd
+
+// -----------------------------
+// PROCESS A ROW OF PLANAR PIXELS
+// GradeAOVOpt::processRowPlanar() on kWidth pixels at a time
+// -----------------------------
+inline void processRowPlanarSimd(const GradeAOVOpt& op, const float* const src[4],
+                                 const float* const aov[4], const float* mask,
+                                 float* const dst[4], int width,
+                                 float* const gradedAov[3] = nullptr)
+{
+  using Simd::Float;
+
+  const Simd::Grade grade(op);
+  const bool useMaskRow = op.useMask && mask;
+
+  int x = 0;
+  for (; x + Simd::kWidth <= width; x += Simd::kWidth)
+  {
+    Float s[4], a[4], g[4], d[4];
+    for (int i = 0; i < 4; i++)
+    {
+      s[i] = Simd::load(src[i] + x);
+      a[i] = Simd::load(aov[i] + x);
+    }
+
+    // Mask alpha (or 1.0 if no mask)
+    const Float mAlpha = useMaskRow ? Simd::load(mask + x) : Float(1.0f);
+
+    grade.grade(s, a, mAlpha, g);
+    grade.composite(s, a, g, d);
+
+    for (int i = 0; i < 4; i++)
+      Simd::store(d[i], dst[i] + x);
+    if (gradedAov)
+      for (int i = 0; i < 3; i++)
+        Simd::store(g[i], gradedAov[i] + x);
+  }
+
+  // Tail
+  if (x < width)
+  {
+    const float* s[4] = {src[0] + x, src[1] + x, src[2] + x, src[3] + x};
+    const float* a[4] = {aov[0] + x, aov[1] + x, aov[2] + x, aov[3] + x};
+    float* const d[4] = {dst[0] + x, dst[1] + x, dst[2] + x, dst[3] + x};
+    float* g[3] = {nullptr, nullptr, nullptr};
+    if (gradedAov)
+      for (int i = 0; i < 3; i++)
+        g[i] = gradedAov[i] + x;
+    op.processRowPlanar(s, a, mask ? mask + x : nullptr, d, width - x,
+                        gradedAov ? g : nullptr);
+  }
+}
+
+// -----------------------------
+// PROCESS A ROW OF RGBA PIXELS
+// GradeAOVOpt::processRow(), channels gathered into vectors
+// -----------------------------
+inline void processRowSimd(const GradeAOVOpt& op, const float* src, const float* aov,
+                           const float* mask, float* dst, int width)
+{
+  using Simd::Float;
+
+  const Simd::Grade grade(op);
+  const bool useMaskRow = op.useMask && mask;
+
+  int x = 0;
+  for (; x + Simd::kWidth <= width; x += Simd::kWidth)
+  {
+    const float* sp = src + 4 * x;
+    const float* ap = aov + 4 * x;
+
+    Float s[4], a[4], g[4], d[4];
+    for (int i = 0; i < 4; i++)
+    {
+      s[i] = Simd::generate([&](int l) { return sp[4 * l + i]; });
+      a[i] = Simd::generate([&](int l) { return ap[4 * l + i]; });
+    }
+
+    // Mask alpha (or 1.0 if no mask)
+    const float* mp = useMaskRow ? mask + 4 * x + 3 : nullptr;
+    const Float mAlpha = mp ? Simd::generate([&](int l) { return mp[4 * l]; }) : Float(1.0f);
+
+    grade.grade(s, a, mAlpha, g);
+    grade.composite(s, a, g, d);
+
+    float* dp = dst + 4 * x;
+    for (size_t l = 0; l < Float::size(); l++)
+      for (int i = 0; i < 4; i++)
+        dp[4 * l + i] = d[i][l];
+  }
+
+  // Tail
+  if (x < width)
+    op.processRow(src + 4 * x, aov + 4 * x, mask ? mask + 4 * x : nullptr, dst + 4 * x,
+                  width - x);
+}
+
+// -----------------------------
+// PROCESS ROWS y0..y1-1 OF A VIEW
+// processRows() with the SIMD row kernels, mask may be null
+// -----------------------------
+inline void processRowsSimd(const GradeAOVOpt& op, const ImageView& src, const ImageView& aov,
+                            const ImageView* mask, const ImageView& dst, int y0, int y1)
+{
+  // Debug builds (-DGRADEAOV_ALLOC_CHECK) abort on any allocation in here
+  GRADEAOV_NO_ALLOC();
+
+  const bool useMaskView = op.useMask && mask;
+
+  const bool interleaved = src.isRGBA() && aov.isRGBA() && dst.isRGBA() &&
+                           (!useMaskView || mask->isRGBA());
+  const bool planar = !interleaved && src.isPlanar() && aov.isPlanar() && dst.isPlanar() &&
+                      (!useMaskView || mask->pixelStride == ptrdiff_t(sizeof(float)));
+
+  // Anything else takes the native strided loop
+  if (!interleaved && !planar)
+  {
+    processRows(op, src, aov, mask, dst, y0, y1);
+    return;
+  }
+
+  for (int y = y0; y < y1; y++)
+  {
+    if (interleaved)
+    {
+      processRowSimd(op, src.row(0, y), aov.row(0, y),
+                     useMaskView ? mask->row(0, y) : nullptr, dst.row(0, y), src.width);
+    }
+    else
+    {
+      const float* s[4] = {src.row(0, y), src.row(1, y), src.row(2, y), src.row(3, y)};
+      const float* a[4] = {aov.row(0, y), aov.row(1, y), aov.row(2, y), aov.row(3, y)};
+      float* const d[4] = {dst.row(0, y), dst.row(1, y), dst.row(2, y), dst.row(3, y)};
+      processRowPlanarSimd(op, s, a, useMaskView ? mask->row(3, y) : nullptr, d, src.width);
+    }
+  }
+}
+
+} // namespace GradeAOV
@@ -0,0 +1,210 @@
+// ============================================================================
+// GradeAOVStats — compile-time hot path instrumentation of the native grade
+// Counts which path every pixel takes through GradeAOVOpt::grade() and how
+// many cycles each stage costs, per tile and per frame.
+// ============================================================================
+
+// MAJOR NOTES :
+// Off unless compiled with -DGRADEAOV_STATS : the macros below expand to
+// nothing and GradeAOVOpt is exactly the plain port.
+// When on, counters go to the GradeStats installed on the calling thread by
+// a StatsScope (one per tile, merged per frame), no atomics, no locks.
+// Without a scope the counters are skipped.
+// Gamma branch counters are per channel (3 per graded pixel), clamp hits
+// count channels a clamp actually changed, denormals count AOV RGB
+// channels (3 per pixel, early-outs included).
+// Cycles come from the TSC on x86 (reference cycles), nanoseconds elsewhere.
+// Reading the clock costs more than a stage does per pixel, so it is never
+// read per pixel : "row" is every row of processRows() timed whole, and
+// each other stage is timed alone, in a pass over the row's pixels run
+// before the row itself (GradeAOVOpt::statsStageCycles(), which does not
+// count paths). "grade" holds "linear" and "gamma", "row" is about
+// "grade" + "composite" plus the loads and stores. The stage passes run on
+// cached pixels and roughly double the grade's time in these builds.
+
+#pragma once
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+
+#if defined(GRADEAOV_STATS) && (defined(__x86_64__) || defined(__i386__) || defined(_M_X64))
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#define GRADEAOV_STATS_TSC 1
+#endif
+
+namespace GradeAOV
+{
+
+#if defined(GRADEAOV_STATS)
+constexpr bool kStatsEnabled = true;
+#else
+constexpr bool kStatsEnabled = false;
+#endif
+
+struct GradeStats
+{
+  // -----------------------------
+  // PATH COUNTERS
+  // -----------------------------
+  enum Counter
+  {
+    kPixels,          // pixels entering grade()
+    kEarlyOutMix,     // mix <= 0
+    kEarlyOutMask,    // mask alpha <= 0
+    kUnpremult,       // graded unpremultiplied
+    kForward,
+    kReverse,
+    kPartialBlend,    // 0 < mask * mix < 1
+
+    kFwdGammaZero,    // forward_gamma, gamma <= 0
+    kFwdNegative,     //   x < 0 kept
+    kFwdPow,          //   pow segment
+    kFwdLinear,       //   linear tail (x >= 1)
+    kFwdIdentity,     //   gamma == 1
+
+    kRevGammaZero,    // reverse_gamma, gamma <= 0
+    kRevNegative,     //   x <= 0 kept
+    kRevPow,
+    kRevLinear,
+    kRevIdentity,
+
+    kClampBlack,      // channels raised to 0
+    kClampWhite,      // channels lowered to 1
+
+    kDenormalIn,      // denormal AOV channels entering the grade
+
+    kCounters
+  };
+
+  // -----------------------------
+  // STAGES
+  // -----------------------------
+  enum Stage
+  {
+    kStageRow,        // processRows(), per row : grade, composite, loads, stores
+    kStageGrade,      // whole grade(), early-outs included
+    kStageLinear,     // linear stage + clamp
+    kStageGamma,      // forward or reverse gamma
+    kStageComposite,
+
+    kStages
+  };
+
+  uint64_t counts[kCounters] = {};
+  uint64_t cycles[kStages] = {};
+
+  void merge(const GradeStats& other)
+  {
+    for (int i = 0; i < kCounters; i++)
+      counts[i] += other.counts[i];
+    for (int i = 0; i < kStages; i++)
+      cycles[i] += other.cycles[i];
+  }
+
+  static const char* counterName(int i)
+  {
+    static const char* names[kCounters] = {
+      "pixels", "early-out mix", "early-out mask", "unpremult", "forward", "reverse",
+      "partial blend",
+      "fwd gamma<=0", "fwd negative", "fwd pow", "fwd linear tail", "fwd gamma=1",
+      "rev gamma<=0", "rev negative", "rev pow", "rev linear tail", "rev gamma=1",
+      "clamp black", "clamp white", "denormal in"};
+    return names[i];
+  }
+
+  static const char* stageName(int i)
+  {
+    static const char* names[kStages] = {"row", "grade", "linear", "gamma", "composite"};
+    return names[i];
+  }
+
+  // Counters as % of pixels (gamma branches, clamps, denormals : % of channels)
+  void print(FILE* out, const char* indent = "  ") const
+  {
+    const double pixels = double(counts[kPixels]);
+    for (int i = 0; i < kCounters; i++)
+    {
+      const double base = (i >= kFwdGammaZero) ? 3.0 * pixels : pixels;
+      std::fprintf(out, "%s%-16s %14llu %7.2f%%\n", indent, counterName(i),
+                   (unsigned long long)counts[i], base > 0.0 ? 100.0 * counts[i] / base : 0.0);
+    }
+    for (int i = 0; i < kStages; i++)
+      std::fprintf(out, "%s%-16s %14llu cycles %8.1f per pixel\n", indent, stageName(i),
+                   (unsigned long long)cycles[i], pixels > 0.0 ? cycles[i] / pixels : 0.0);
+  }
+};
+
+// -----------------------------
+// PER-THREAD SINK
+// -----------------------------
+inline GradeStats*& statsSink()
+{
+  static thread_local GradeStats* sink = nullptr;
+  return sink;
+}
+
+// Sends this thread's counters to stats while alive (scopes nest)
+class StatsScope
+{
+public:
+  explicit StatsScope(GradeStats& stats) : _previous(statsSink()) { statsSink() = &stats; }
+  ~StatsScope() { statsSink() = _previous; }
+
+  StatsScope(const StatsScope&) = delete;
+  StatsScope& operator=(const StatsScope&) = delete;
+
+private:
+  GradeStats* _previous;
+};
+
+inline uint64_t statsClock()
+{
+#if defined(GRADEAOV_STATS_TSC)
+  return __rdtsc();
+#else
+  return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+// Denormal values among the first n of v
+inline uint64_t statsDenormals(const float* v, int n)
+{
+  uint64_t d = 0;
+  for (int i = 0; i < n; i++)
+    d += std::fpclassify(v[i]) == FP_SUBNORMAL;
+  return d;
+}
+
+inline void statsCount(GradeStats::Counter c, uint64_t n = 1)
+{
+  if (GradeStats* s = statsSink())
+    s->counts[c] += n;
+}
+
+// Where the stage passes leave a sum of their results, so that none of
+// them is optimized away
+inline volatile float& statsKept()
+{
+  static thread_local volatile float kept = 0.0f;
+  return kept;
+}
+
+} // namespace GradeAOV
+
+// -----------------------------
+// HOT PATH MACROS
+// -----------------------------
+#if defined(GRADEAOV_STATS)
+#define GRADEAOV_COUNT(c)      ::GradeAOV::statsCount(::GradeAOV::GradeStats::c)
+#define GRADEAOV_COUNT_N(c, n) ::GradeAOV::statsCount(::GradeAOV::GradeStats::c, (n))
+#else
+#define GRADEAOV_COUNT(c)      ((void)0)
+#define GRADEAOV_COUNT_N(c, n) ((void)0)
+#endif
@@ -0,0 +1,245 @@
+// ============================================================================
+// GradeAOVSynth — reproducible synthetic beauty / AOV / mask frames
+// Generates render-like inputs for the benchmarks, so the grade sees the
+// branch mix of production frames instead of constant or uniform noise.
+// ============================================================================
+
+// MAJOR NOTES :
+// What a frame holds :
+//   beauty : soft-edged foreground objects (alpha falls off over a few
+//            pixels), a low-frequency diffuse shade, premultiplied, plus
+//            the AOV. Background pixels are empty (alpha 0).
+//   aov    : an emission / specular pass, zero almost everywhere. Sparse
+//            emitters with a Pareto (heavy) tail well above 1, and scattered
+//            small negative values left by a denoiser. Optionally denormal
+//            residue (2^-127 .. 2^-147) in a fraction of the covered pixels
+//            (alpha > 0) that neither emit nor went negative, like some
+//            denoisers leave (denormalDensity, off by default).
+//   mask   : a few soft-edged mattes covering a small part of the frame,
+//            0 everywhere else (the mask early-out). RGBA all equal.
+// Every pixel is a pure function of (seed, x, y) : any tiling, thread
+// count or row order gives the same frame, and a seed gives the same frame
+// on every machine.
+// Objects and mattes are discs placed from the seed, a row only tests the
+// discs crossing it.
+
+#pragma once
+
+#include "GradeAOVImage.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace GradeAOV
+{
+
+struct SynthParams
+{
+  uint32_t seed = 1;
+
+  // Fraction of the frame covered by foreground objects / mask mattes
+  float objectCoverage = 0.45f;
+  float maskCoverage   = 0.12f;
+
+  // Width of the soft alpha edges, in pixels
+  float edgeWidth = 3.0f;
+
+  // Fraction of covered pixels that emit, and the Pareto shape of their
+  // values (smaller = heavier tail, values start at emissionFloor)
+  float emissionDensity = 0.02f;
+  float emissionShape   = 1.6f;
+  float emissionFloor   = 0.25f;
+
+  // Fraction of covered pixels a denoiser pushed slightly below zero
+  float negativeDensity = 0.01f;
+  float negativeDepth   = 0.02f;
+
+  // Fraction of the other covered pixels holding denormal residue
+  float denormalDensity = 0.0f;
+};
+
+namespace Synth
+{
+
+// -----------------------------
+// HASHING
+// -----------------------------
+inline uint32_t hash(uint32_t a, uint32_t b, uint32_t c, uint32_t d)
+{
+  uint32_t h = a * 0x9E3779B1u ^ b * 0x85EBCA77u ^ c * 0xC2B2AE3Du ^ d * 0x27D4EB2Fu;
+  h ^= h >> 16;
+  h *= 0x7FEB352Du;
+  h ^= h >> 15;
+  h *= 0x846CA68Bu;
+  h ^= h >> 16;
+  return h;
+}
+
+// [0, 1)
+inline float unit(uint32_t h) { return float(h >> 8) * (1.0f / 16777216.0f); }
+
+// Salts keeping the random streams apart
+enum Salt : uint32_t
+{
+  kObjects = 1, kMattes, kShade, kEmission, kEmissionValue, kNegative, kNegativeValue,
+  kDenormal, kDenormalValue
+};
+
+struct Disc
+{
+  float cx, cy, r;
+};
+
+// count discs covering about coverage of a width x height frame
+inline std::vector<Disc> discs(uint32_t seed, uint32_t salt, int count, float coverage,
+                               int width, int height)
+{
+  std::vector<Disc> out;
+  const float mean = std::sqrt(std::max(0.0f, coverage) * width * height /
+                               (3.14159265f * count));
+  for (int i = 0; i < count; i++)
+  {
+    Disc d;
+    d.cx = unit(hash(seed, salt, uint32_t(i), 0)) * width;
+    d.cy = unit(hash(seed, salt, uint32_t(i), 1)) * height;
+    // 0.5x to 1.5x the mean radius, same total area on average
+    d.r  = mean * (0.5f + unit(hash(seed, salt, uint32_t(i), 2)));
+    out.push_back(d);
+  }
+  return out;
+}
+
+// Discs whose soft edge reaches row y
+inline void discsOnRow(const std::vector<Disc>& all, float y, float edge, std::vector<Disc>& row)
+{
+  row.clear();
+  for (const Disc& d : all)
+    if (std::fabs(d.cy - y) < d.r + edge)
+      row.push_back(d);
+}
+
+// Union of soft discs at (x, y), 1 inside, 0 outside, smooth over edge
+inline float coverage(const std::vector<Disc>& row, float x, float y, float edge)
+{
+  float a = 0.0f;
+  for (const Disc& d : row)
+  {
+    const float dx = x - d.cx, dy = y - d.cy;
+    const float t = (d.r + 0.5f * edge - std::sqrt(dx * dx + dy * dy)) / edge;
+    if (t > 0.0f)
+      a = std::max(a, t >= 1.0f ? 1.0f : t * t * (3.0f - 2.0f * t));
+  }
+  return a;
+}
+
+// Value noise in [0, 1) with cells of cell pixels
+inline float shade(uint32_t seed, float x, float y, float cell)
+{
+  const float fx = x / cell, fy = y / cell;
+  const int ix = int(std::floor(fx)), iy = int(std::floor(fy));
+  float tx = fx - ix, ty = fy - iy;
+  tx = tx * tx * (3.0f - 2.0f * tx);
+  ty = ty * ty * (3.0f - 2.0f * ty);
+
+  auto corner = [&](int cx, int cy) { return unit(hash(seed, kShade, uint32_t(cx), uint32_t(cy))); };
+  const float top    = corner(ix, iy)     + (corner(ix + 1, iy)     - corner(ix, iy))     * tx;
+  const float bottom = corner(ix, iy + 1) + (corner(ix + 1, iy + 1) - corner(ix, iy + 1)) * tx;
+  return top + (bottom - top) * ty;
+}
+
+inline void put(const ImageView& v, int c, int y, int x, float value)
+{
+  if (float* row = v.row(c, y))
+    *reinterpret_cast<float*>(reinterpret_cast<char*>(row) + x * v.pixelStride) = value;
+}
+
+} // namespace Synth
+
+// -----------------------------
+// GENERATE ROWS y0..y1-1
+// All three views are width x height of the full frame. Call once per band
+// from the threads that will grade it, to place the pages near them.
+// -----------------------------
+inline void synthesizeRows(const SynthParams& p, const ImageView& beauty, const ImageView& aov,
+                           const ImageView& mask, int y0, int y1)
+{
+  using namespace Synth;
+
+  const int width = beauty.width, height = beauty.height;
+  const float edge = std::max(p.edgeWidth, 1e-3f);
+
+  // Placement only depends on the seed and frame size, cheap to redo per band
+  const std::vector<Disc> objects = discs(p.seed, kObjects, 24, p.objectCoverage, width, height);
+  const std::vector<Disc> mattes  = discs(p.seed, kMattes, 5, p.maskCoverage, width, height);
+  std::vector<Disc> objectRow, matteRow;
+
+  for (int y = y0; y < y1; y++)
+  {
+    const float fy = y + 0.5f;
+    discsOnRow(objects, fy, edge, objectRow);
+    discsOnRow(mattes, fy, edge, matteRow);
+
+    for (int x = 0; x < width; x++)
+    {
+      const float fx = x + 0.5f;
+      const float alpha = coverage(objectRow, fx, fy, edge);
+
+      // Emission pass, premultiplied like the beauty
+      float e[3] = {0.0f, 0.0f, 0.0f};
+      if (alpha > 0.0f)
+      {
+        if (unit(hash(p.seed, kEmission, uint32_t(x), uint32_t(y))) < p.emissionDensity)
+        {
+          // Pareto : floor / u^(1/shape), tinted per channel
+          const float u = std::max(unit(hash(p.seed, kEmissionValue, uint32_t(x), uint32_t(y))),
+                                   1e-6f);
+          const float v = p.emissionFloor / std::pow(u, 1.0f / p.emissionShape);
+          for (int c = 0; c < 3; c++)
+            e[c] = alpha * v * (0.6f + 0.4f * unit(hash(p.seed, kEmissionValue + 16u * (c + 1),
+                                                         uint32_t(x), uint32_t(y))));
+        }
+        else if (unit(hash(p.seed, kNegative, uint32_t(x), uint32_t(y))) < p.negativeDensity)
+        {
+          for (int c = 0; c < 3; c++)
+            e[c] = -alpha * p.negativeDepth *
+                   unit(hash(p.seed, kNegativeValue + 16u * c, uint32_t(x), uint32_t(y)));
+        }
+        else if (p.denormalDensity > 0.0f &&
+                 unit(hash(p.seed, kDenormal, uint32_t(x), uint32_t(y))) < p.denormalDensity)
+        {
+          for (int c = 0; c < 3; c++)
+          {
+            const uint32_t h = hash(p.seed, kDenormalValue + 16u * c, uint32_t(x), uint32_t(y));
+            e[c] = std::ldexp(1.0f + unit(h), -127 - int(h % 21));
+          }
+        }
+      }
+
+      // Diffuse shade under the emission
+      const float base = alpha * (0.05f + 0.55f * shade(p.seed, fx, fy, 96.0f));
+      put(beauty, 0, y, x, base + e[0]);
+      put(beauty, 1, y, x, base * 0.9f + e[1]);
+      put(beauty, 2, y, x, base * 0.8f + e[2]);
+      put(beauty, 3, y, x, alpha);
+
+      for (int c = 0; c < 3; c++)
+        put(aov, c, y, x, e[c]);
+      put(aov, 3, y, x, alpha);
+
+      const float m = matteRow.empty() ? 0.0f : coverage(matteRow, fx, fy, edge);
+      for (int c = 0; c < 4; c++)
+        put(mask, c, y, x, m);
+    }
+  }
+}
+
+// Whole frame on the calling thread
+inline void synthesize(const SynthParams& p, const ImageView& beauty, const ImageView& aov,
+                       const ImageView& mask)
+{
+  synthesizeRows(p, beauty, aov, mask, 0, beauty.height);
+}
+
+} // namespace GradeAOV
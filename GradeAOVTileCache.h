@@ -0,0 +1,113 @@
+// ============================================================================
+// GradeAOVTileCache — bounded LRU cache of decoded tiles
+// Keeps decoded tiles (float planes) by part and tile position under a
+// byte budget, evicting the least recently used ones and recycling their
+// memory for the next decode. EXRChannelReader::readRegion() decodes
+// through it, GradeAOVBench --tile-cache measures it without OpenEXR.
+// ============================================================================
+
+// USAGE :
+//   TileCache cache;
+//   cache.setBudget(256 << 20);
+//   const std::vector<float>& t = cache.fetch(part, tx, ty, floats,
+//     [&](float* data) { ... decode floats values into data ... });
+//
+// MAJOR NOTES :
+// The budget bounds what is kept, not a single decode : a tile larger than
+// the whole budget is still decoded and is then the only one held.
+// A reference returned by fetch() stays valid until the next fetch().
+// Not thread safe, one cache per reader.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace GradeAOV
+{
+
+class TileCache
+{
+public:
+  // Decoded bytes kept at most
+  void setBudget(size_t bytes) { _budget = bytes; }
+  size_t budget() const { return _budget; }
+
+  // Tile (part, tx, ty). On a miss decode(float* data) fills floats values,
+  // the oldest tiles are evicted first to make room.
+  template <class Decode>
+  const std::vector<float>& fetch(int part, int tx, int ty, size_t floats, Decode&& decode)
+  {
+    const std::tuple<int, int, int> key(part, tx, ty);
+    auto found = _index.find(key);
+    if (found != _index.end())
+    {
+      // Most recently used goes to the front
+      _lru.splice(_lru.begin(), _lru, found->second);
+      _hits++;
+      return found->second->data;
+    }
+    _misses++;
+
+    const size_t bytes = floats * sizeof(float);
+
+    // Make room, recycling the oldest tile's memory
+    std::vector<float> data;
+    while (!_lru.empty() && _bytes + bytes > _budget)
+    {
+      Tile& old = _lru.back();
+      _bytes -= old.data.size() * sizeof(float);
+      if (data.capacity() < old.data.capacity())
+        data.swap(old.data);
+      _index.erase(std::make_tuple(old.part, old.tx, old.ty));
+      _lru.pop_back();
+      _evictions++;
+    }
+    data.resize(floats);
+    decode(data.data());
+
+    _lru.push_front(Tile{part, tx, ty, std::move(data)});
+    _index[key] = _lru.begin();
+    _bytes += bytes;
+    _peak = std::max(_peak, _bytes);
+    return _lru.front().data;
+  }
+
+  // -----------------------------
+  // STATISTICS
+  // -----------------------------
+  uint64_t hits() const { return _hits; }
+  uint64_t misses() const { return _misses; }
+  uint64_t evictions() const { return _evictions; }
+
+  // Decoded bytes held now, and at most so far
+  size_t bytes() const { return _bytes; }
+  size_t peak() const { return _peak; }
+
+private:
+  struct Tile
+  {
+    int part, tx, ty;
+    std::vector<float> data;
+  };
+
+  typedef std::list<Tile>::iterator TileRef;
+
+  // Front is the most recently used
+  std::list<Tile> _lru;
+  std::map<std::tuple<int, int, int>, TileRef> _index;
+  size_t _budget      = size_t(256) << 20;
+  size_t _bytes       = 0;
+  size_t _peak        = 0;
+  uint64_t _hits      = 0;
+  uint64_t _misses    = 0;
+  uint64_t _evictions = 0;
+};
+
+} // namespace GradeAOV
@@ -0,0 +1,230 @@
+// ============================================================================
+// GradeAOVTileCacheBench — peak memory of the tiled regrade's tile cache
+// Replays GradeAOVRegrade --tiled's reads through the LRU tile cache
+// (GradeAOVTileCache.h) at several budgets, and reports the tiles decoded,
+// the cache's peak and the peak RSS growth against each budget. No OpenEXR.
+// ============================================================================
+
+// USAGE :
+//   GradeAOVTileCacheBench [-w width] [-h height] [--tile n] [--box n]
+//
+//   -w / -h : image size (default 1920 x 1080)
+//   --tile  : input tile size (default 64)
+//   --box   : output box size, on another grid (default 96 : boxes
+//             straddle tiles)
+//
+// MAJOR NOTES :
+// The parts of a regrade are a beauty (RGBA), an AOV (RGBA) and a mask
+// (alpha), planar tiles like the reader's. Decoding a tile copies it out of
+// the synthetic frame : the times are the cache's overhead, not OpenEXR's.
+// Budgets are one tile, then 0.5, 1, 2 and 4 rows of input tiles : the
+// next row of boxes reuses the bottom tiles of this one, they are decoded
+// again when the budget has already evicted them.
+// The RSS growth is VmHWM, restarted through /proc/self/clear_refs (Linux
+// 4.0+), minus VmRSS before the run ("-" where that is not available).
+//
+// BUILD :
+//   g++ -O3 -std=c++17 GradeAOVTileCacheBench.cpp -o GradeAOVTileCacheBench
+
+#include "GradeAOVTileCache.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+using namespace GradeAOV;
+
+namespace
+{
+
+// Line of /proc/self/status in bytes (VmRSS, VmHWM), 0 if unknown
+size_t residentBytes(const char* field)
+{
+  size_t kb = 0;
+#if defined(__linux__)
+  if (std::FILE* f = std::fopen("/proc/self/status", "r"))
+  {
+    char line[256];
+    const size_t n = std::strlen(field);
+    while (std::fgets(line, sizeof(line), f))
+      if (!std::strncmp(line, field, n) && line[n] == ':')
+        kb = size_t(std::strtoull(line + n + 1, nullptr, 10));
+    std::fclose(f);
+  }
+#endif
+  return kb << 10;
+}
+
+// Restart VmHWM from the current RSS (Linux 4.0+), false if not possible
+bool resetResidentPeak()
+{
+#if defined(__linux__)
+  if (std::FILE* f = std::fopen("/proc/self/clear_refs", "w"))
+  {
+    const bool written = std::fputs("5", f) >= 0;
+    return std::fclose(f) == 0 && written;
+  }
+#endif
+  return false;
+}
+
+// One input part : planes of width x height floats
+struct Part
+{
+  int planes;
+  std::vector<float> data;
+};
+
+void run(int width, int height, int tile, int box)
+{
+  Part parts[] = {{4, {}}, {4, {}}, {1, {}}};
+  for (int p = 0; p < 3; p++)
+  {
+    Part& part = parts[p];
+    part.data.resize(size_t(part.planes) * width * height);
+    for (size_t i = 0; i < part.data.size(); i++)
+      part.data[i] = float((i * 2654435761u + p) % 1000) * 0.001f;
+  }
+
+  const int tilesX = (width + tile - 1) / tile;
+  const int tilesY = (height + tile - 1) / tile;
+  size_t tileRowBytes = 0;
+  for (const Part& part : parts)
+    tileRowBytes += size_t(part.planes) * tilesX * tile * tile * sizeof(float);
+
+  std::printf("tile cache (%d x %d, %d x %d input tiles, %d x %d boxes, a row of tiles is %.1f MB)\n",
+              width, height, tile, tile, box, box, tileRowBytes / 1048576.0);
+  std::printf("  %-14s %10s %10s %9s %9s %13s %13s\n", "budget", "MB", "ms", "decoded",
+              "evicted", "cache peak MB", "RSS peak +MB");
+
+  // The box planes readRegion() fills
+  std::vector<float> boxPlanes(size_t(9) * box * box);
+
+  for (double rows : {0.0, 0.5, 1.0, 2.0, 4.0})
+  {
+    TileCache cache;
+    cache.setBudget(size_t(rows * tileRowBytes));
+
+    // Memory the previous budget freed goes back first
+#if defined(__GLIBC__)
+    malloc_trim(0);
+#endif
+    const size_t before = residentBytes("VmRSS");
+    const bool peakKnown = resetResidentPeak();
+    const auto start = std::chrono::steady_clock::now();
+
+    for (int by = 0; by < height; by += box)
+      for (int bx = 0; bx < width; bx += box)
+      {
+        const int bw = std::min(box, width - bx);
+        const int bh = std::min(box, height - by);
+
+        int plane0 = 0;
+        for (int p = 0; p < 3; p++)
+        {
+          const Part& part = parts[p];
+
+          for (int ty = by / tile; ty <= (by + bh - 1) / tile; ty++)
+            for (int tx = bx / tile; tx <= (bx + bw - 1) / tile; tx++)
+            {
+              const int x0 = tx * tile, y0 = ty * tile;
+              const int tw = std::min(tile, width - x0);
+              const int th = std::min(tile, height - y0);
+              const size_t tilePx = size_t(tw) * th;
+
+              const std::vector<float>& t = cache.fetch(p, tx, ty, part.planes * tilePx,
+                [&](float* data)
+                {
+                  for (int c = 0; c < part.planes; c++)
+                    for (int y = 0; y < th; y++)
+                    {
+                      const float* from = part.data.data() +
+                                          (size_t(c) * height + y0 + y) * width + x0;
+                      std::copy(from, from + tw, data + c * tilePx + size_t(y) * tw);
+                    }
+                });
+
+              // Overlap of tile and box into the box planes
+              const int ox0 = std::max(x0, bx), ox1 = std::min(x0 + tw, bx + bw);
+              const int oy0 = std::max(y0, by), oy1 = std::min(y0 + th, by + bh);
+              for (int c = 0; c < part.planes; c++)
+                for (int y = oy0; y < oy1; y++)
+                  std::copy(t.data() + c * tilePx + size_t(y - y0) * tw + (ox0 - x0),
+                            t.data() + c * tilePx + size_t(y - y0) * tw + (ox1 - x0),
+                            boxPlanes.data() + size_t(plane0 + c) * box * box +
+                              size_t(y - by) * box + (ox0 - bx));
+            }
+          plane0 += part.planes;
+        }
+      }
+
+    const double ms = std::chrono::duration<double, std::milli>(
+                        std::chrono::steady_clock::now() - start).count();
+    const size_t peak = residentBytes("VmHWM");
+
+    char label[32], growth[32];
+    if (rows > 0.0)
+      std::snprintf(label, sizeof(label), "%.1f tile rows", rows);
+    else
+      std::snprintf(label, sizeof(label), "one tile");
+    if (peakKnown && peak >= before)
+      std::snprintf(growth, sizeof(growth), "%.1f", (peak - before) / 1048576.0);
+    else
+      std::snprintf(growth, sizeof(growth), "-");
+    std::printf("  %-14s %10.1f %10.2f %9llu %9llu %13.1f %13s\n", label,
+                cache.budget() / 1048576.0, ms, (unsigned long long)cache.misses(),
+                (unsigned long long)cache.evictions(), cache.peak() / 1048576.0, growth);
+  }
+
+  std::printf("  every tile decoded once : %d, RSS peak + is what the process grew by"
+              " (\"-\" : no VmHWM reset here)\n", 3 * tilesX * tilesY);
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+  int width = 1920, height = 1080;
+  int tile = 64, box = 96;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (!std::strcmp(argv[i], "-w") && i + 1 < argc)
+      width = std::atoi(argv[++i]);
+    else if (!std::strcmp(argv[i], "-h") && i + 1 < argc)
+      height = std::atoi(argv[++i]);
+    else if (!std::strcmp(argv[i], "--tile") && i + 1 < argc)
+      tile = std::atoi(argv[++i]);
+    else if (!std::strcmp(argv[i], "--box") && i + 1 < argc)
+      box = std::atoi(argv[++i]);
+    else
+    {
+      std::fprintf(stderr, "usage: %s [-w width] [-h height] [--tile n] [--box n]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  try
+  {
+    if (width <= 0 || height <= 0)
+      throw std::runtime_error("bad image size");
+    if (tile <= 0 || box <= 0)
+      throw std::runtime_error("bad tile or box size");
+    run(width, height, tile, box);
+  }
+  catch (const std::exception& e)
+  {
+    std::fprintf(stderr, "error: %s\n", e.what());
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,167 @@
+// ============================================================================
+// GradeAOVTrace — Chrome trace (Perfetto) timeline recorder for grade jobs
+// Collects per-thread events (tiles, queue stalls, I/O, cache counters) and
+// writes them as Chrome trace JSON, to open in ui.perfetto.dev or
+// chrome://tracing.
+// ============================================================================
+
+// MAJOR NOTES :
+// One lane (trace thread id) per executor thread, lane 0 is the thread that
+// calls forEachTile. A lane is only ever written by its own thread, so
+// recording takes no lock. Add lanes before the threads start recording.
+// Times are microseconds since the recorder was created.
+// Event names and categories must be string literals (kept as pointers),
+// args are a ready-made JSON object body ("\"x\": 1, \"y\": 2").
+
+#pragma once
+
+#include "GradeAOVJson.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace GradeAOV
+{
+
+class TraceRecorder
+{
+public:
+  explicit TraceRecorder(int lanes = 1)
+    : _origin(std::chrono::steady_clock::now())
+  {
+    addLanes(lanes);
+  }
+
+  // Make sure lanes 0..lanes-1 exist, never while they are recording
+  void addLanes(int lanes)
+  {
+    if (lanes > int(_lanes.size()))
+      _lanes.resize(lanes);
+  }
+
+  int lanes() const { return int(_lanes.size()); }
+
+  // Label shown for a lane in the viewer
+  void setLaneName(int lane, const std::string& name) { _lanes[lane].name = name; }
+
+  // Microseconds since creation
+  double now() const
+  {
+    return std::chrono::duration<double, std::micro>(
+             std::chrono::steady_clock::now() - _origin).count();
+  }
+
+  // -----------------------------
+  // EVENTS
+  // -----------------------------
+
+  // Span [begin, end) on a lane
+  void complete(int lane, const char* name, const char* category, double begin, double end,
+                std::string args = std::string())
+  {
+    _lanes[lane].events.push_back({'X', name, category, begin, end - begin, std::move(args)});
+  }
+
+  // Point in time on a lane
+  void instant(int lane, const char* name, const char* category, double ts,
+               std::string args = std::string())
+  {
+    _lanes[lane].events.push_back({'i', name, category, ts, 0.0, std::move(args)});
+  }
+
+  // Counter track (args hold the series : "\"hits\": 10, \"misses\": 2")
+  void counter(int lane, const char* name, double ts, std::string args)
+  {
+    _lanes[lane].events.push_back({'C', name, "counter", ts, 0.0, std::move(args)});
+  }
+
+  size_t events() const
+  {
+    size_t n = 0;
+    for (const Lane& lane : _lanes)
+      n += lane.events.size();
+    return n;
+  }
+
+  // -----------------------------
+  // WRITE CHROME TRACE JSON
+  // Throws std::runtime_error.
+  // -----------------------------
+  void write(const std::string& path) const
+  {
+    std::ofstream out(path);
+    if (!out)
+      throw std::runtime_error("cannot write " + path);
+
+    out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+
+    bool first = true;
+    auto separator = [&]
+    {
+      if (!first)
+        out << ",\n";
+      first = false;
+    };
+
+    char number[64];
+    for (int l = 0; l < int(_lanes.size()); l++)
+    {
+      const Lane& lane = _lanes[l];
+
+      separator();
+      out << "{\"ph\": \"M\", \"name\": \"thread_name\", \"pid\": 1, \"tid\": " << l
+          << ", \"args\": {\"name\": "
+          << jsonQuote(lane.name.empty() ? "thread " + std::to_string(l) : lane.name) << "}}";
+
+      for (const Event& e : lane.events)
+      {
+        separator();
+        out << "{\"ph\": \"" << e.phase << "\", \"name\": " << jsonQuote(e.name)
+            << ", \"cat\": " << jsonQuote(e.category) << ", \"pid\": 1, \"tid\": " << l;
+
+        std::snprintf(number, sizeof(number), "%.3f", e.ts);
+        out << ", \"ts\": " << number;
+        if (e.phase == 'X')
+        {
+          std::snprintf(number, sizeof(number), "%.3f", e.dur);
+          out << ", \"dur\": " << number;
+        }
+        if (e.phase == 'i')
+          out << ", \"s\": \"t\"";
+        if (!e.args.empty())
+          out << ", \"args\": {" << e.args << "}";
+        out << "}";
+      }
+    }
+
+    out << "\n]}\n";
+    if (!out)
+      throw std::runtime_error("cannot write " + path);
+  }
+
+private:
+  struct Event
+  {
+    char phase;
+    const char* name;
+    const char* category;
+    double ts;
+    double dur;
+    std::string args;
+  };
+
+  struct Lane
+  {
+    std::string name;
+    std::vector<Event> events;
+  };
+
+  std::chrono::steady_clock::time_point _origin;
+  std::vector<Lane> _lanes;
+};
+
+} // namespace GradeAOV